@@ -0,0 +1,380 @@
+#include <benchmark/benchmark.h>
+
+#include <list>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <streambuf>
+#include <utility>
+
+#include "factory.hxx"
+#include "factory_parser.hxx"
+#include "helpers.hxx"
+#include "package.hxx"
+#include "reports.hxx"
+#include "simulation_image.hxx"
+#include "storage_types.hxx"
+#include "sweep.hxx"
+#include "topology_generators.hxx"
+
+// Benchmarki netsim_bench.
+//
+// Network-level benchmarks take (topology, node count) arguments; topology
+// is a GeneratedTopology value and node counts go from 10 to 10^6. Results
+// in machine-readable form: --benchmark_format=json, or
+// --benchmark_out=<file> --benchmark_out_format=json (see the
+// netsim_bench_json target).
+
+namespace {
+
+constexpr GeneratedTopology topologies[] = {
+    GeneratedTopology::CHAIN, GeneratedTopology::FAN_OUT,
+    GeneratedTopology::LAYERED, GeneratedTopology::RANDOM
+};
+
+void network_args(benchmark::internal::Benchmark* b) {
+    for (int topology = 0; topology < 4; ++topology) {
+        for (int nodes = 10; nodes <= 1'000'000; nodes *= 10) {
+            b->Args({topology, nodes});
+        }
+    }
+    b->ArgNames({"topology", "nodes"});
+}
+
+// Struktury generowane raz na (topologia, rozmiar).
+const std::string& structure(const benchmark::State& state) {
+    static std::map<std::pair<std::int64_t, std::int64_t>, std::string> cache;
+    auto key = std::make_pair(state.range(0), state.range(1));
+    auto it = cache.find(key);
+    if (it == cache.end()) {
+        it = cache.emplace(key, generate_factory_structure(topologies[key.first],
+                                                           static_cast<std::size_t>(key.second))).first;
+    }
+    return it->second;
+}
+
+Factory make_factory(const benchmark::State& state) {
+    std::istringstream is(structure(state));
+    return load_factory_structure(is);
+}
+
+void label(benchmark::State& state) {
+    state.SetLabel(to_string(topologies[state.range(0)]));
+}
+
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return c; }
+    std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+};
+
+void BM_LoadFactoryStructure(benchmark::State& state) {
+    const std::string& text = structure(state);
+    for (auto _ : state) {
+        std::istringstream is(text);
+        Factory factory = load_factory_structure(is);
+        benchmark::DoNotOptimize(factory.get_workers().size());
+    }
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * text.size()));
+    label(state);
+}
+
+// Budowa i likwidacja fabryki: parse (default heap or a FactoryArena reused
+// across iterations) plus destruction. Third argument: 1 = arena.
+void BM_BuildFactory(benchmark::State& state) {
+    const std::string& text = structure(state);
+    FactoryArena arena;
+    for (auto _ : state) {
+        if (state.range(2) != 0) {
+            {
+                Factory factory = parse_factory_structure(text, arena.resources());
+                benchmark::DoNotOptimize(factory.get_workers().size());
+            }
+            arena.release();
+        } else {
+            Factory factory = parse_factory_structure(text);
+            benchmark::DoNotOptimize(factory.get_workers().size());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(1));
+    label(state);
+}
+
+void build_factory_args(benchmark::internal::Benchmark* b) {
+    for (int topology = 0; topology < 4; ++topology) {
+        for (int nodes = 100; nodes <= 100'000; nodes *= 10) {
+            b->Args({topology, nodes, 0});
+            b->Args({topology, nodes, 1});
+        }
+    }
+    b->ArgNames({"topology", "nodes", "arena"});
+}
+
+// Przegląd 16 punktów (processing time x delivery interval, 50 turns) on
+// one thread: run_sweep() vs. parsing the structure again for every point.
+// Arguments: node count, 1 = run_sweep().
+void BM_Sweep(benchmark::State& state) {
+    const std::string text = generate_factory_structure(GeneratedTopology::LAYERED,
+                                                        static_cast<std::size_t>(state.range(0)));
+    const std::vector<SweepAxis> grid = {
+        {SweepParameter::PROCESSING_TIME, {1, 2, 3, 4}, {}},
+        {SweepParameter::DELIVERY_INTERVAL, {1, 2, 3, 4}, {}},
+    };
+    SweepOptions options;
+    options.duration = 50;
+    options.threads = 1;
+
+    const Factory base = parse_factory_structure(text);
+    for (auto _ : state) {
+        if (state.range(1) != 0) {
+            run_sweep(base, grid, options, [](const SweepResult& r) { benchmark::DoNotOptimize(r.point); });
+            continue;
+        }
+        for (std::size_t point = 0; point < sweep_size(grid); ++point) {
+            const std::vector<std::int64_t> values = sweep_point(grid, point);
+            Factory factory = parse_factory_structure(text);
+            for (auto it = factory.worker_cbegin(); it != factory.worker_cend(); ++it) {
+                factory.find_worker_by_id(it->get_id())->set_processing_duration(values[0]);
+            }
+            for (auto it = factory.ramp_cbegin(); it != factory.ramp_cend(); ++it) {
+                factory.find_ramp_by_id(it->get_id())->set_delivery_interval(values[1]);
+            }
+            ImageSimulationOptions single;
+            single.report_turn = [](Time) { return false; };
+            single.seed = options.seed;
+            simulate_compiled(factory, options.duration, [](Factory&, Time) {}, single);
+            MetricsSnapshot metrics = snapshot_metrics(factory, options.duration);
+            benchmark::DoNotOptimize(metrics.turn);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(sweep_size(grid)));
+}
+
+// Okresowa linia: ramp -> 20 workers in a chain -> aggregate storehouse,
+// simulated with reports every 10^5 turns. Arguments: horizon in turns,
+// 1 = fast_forward (cycle detection and skipped periods).
+void BM_FastForward(benchmark::State& state) {
+    std::ostringstream structure;
+    structure << "LOADING_RAMP id=1 delivery-interval=3\n";
+    for (int w = 1; w <= 20; ++w) {
+        structure << "WORKER id=" << w << " processing-time=" << 2 + w % 2 << " queue-type=FIFO\n";
+        structure << "LINK src=" << (w == 1 ? "ramp-1" : "worker-" + std::to_string(w - 1))
+                  << " dest=worker-" << w << "\n";
+    }
+    structure << "STOREHOUSE id=1 stock=aggregate\nLINK src=worker-20 dest=store-1\n";
+    const std::string text = structure.str();
+
+    const IntervalReportNotifier notifier(100'000);
+    ImageSimulationOptions options;
+    options.report_turn = [&](Time t) { return notifier.should_generate_report(t); };
+    options.next_report_turn = [&](Time t) { return notifier.next_report_turn(t); };
+    options.fast_forward = state.range(1) != 0;
+
+    for (auto _ : state) {
+        Factory factory = parse_factory_structure(text);
+        simulate_compiled(factory, static_cast<TimeOffset>(state.range(0)), [](Factory&, Time) {}, options);
+        benchmark::DoNotOptimize(factory.get_storehouses().begin()->get_arrival_count());
+    }
+}
+
+void BM_IsConsistent(benchmark::State& state) {
+    Factory factory = make_factory(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(factory.is_consistent());
+    }
+    label(state);
+}
+
+// Full traversal: an unreachable dead end defeats the fast path and every
+// iteration changes the topology version, so the cached result is stale.
+void BM_IsConsistentFullCheck(benchmark::State& state) {
+    Factory factory = make_factory(state);
+    const ElementID id = static_cast<ElementID>(factory.get_workers().size()) + 1;
+    factory.add_worker(Worker(id, 1, make_package_queue(PackageQueueType::FIFO)));
+    Worker& dead_end = *factory.find_worker_by_id(id);
+
+    for (auto _ : state) {
+        dead_end.add_receiver(&dead_end);
+        dead_end.receiver_preferences_.remove_receiver(&dead_end);
+        benchmark::DoNotOptimize(factory.is_consistent());
+    }
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * factory.get_workers().size()));
+    label(state);
+}
+
+void BM_SimulateTurn(benchmark::State& state) {
+    Factory factory = make_factory(state);
+    factory.get_context().seed(1);
+    SimulationContext::Scope scope(factory.get_context());
+
+    Time t = 0;
+    for (auto _ : state) {
+        ++t;
+        factory.get_context().set_current_turn(t);
+        factory.do_deliveries(t);
+        factory.do_package_passing();
+        factory.do_work(t);
+    }
+    state.SetItemsProcessed(static_cast<std::int64_t>(
+        state.iterations() * (factory.get_ramps().size() + factory.get_workers().size())));
+    label(state);
+}
+
+void BM_SimulateTurnCompiled(benchmark::State& state) {
+    Factory factory = make_factory(state);
+    factory.get_context().seed(1);
+    SimulationContext::Scope scope(factory.get_context());
+    SimulationImage image(factory);
+
+    Time t = 0;
+    for (auto _ : state) {
+        image.run_turn(++t);
+    }
+    state.SetItemsProcessed(static_cast<std::int64_t>(
+        state.iterations() * (factory.get_ramps().size() + factory.get_workers().size())));
+    label(state);
+}
+
+// Argumenty: wielkość partii rampy; batch-size ramps, or as many single-package
+// ramps (1 = one ramp delivering the whole batch, 0 = separate ramps).
+void BM_RampBatch(benchmark::State& state) {
+    const auto batch = static_cast<std::size_t>(state.range(0));
+    const std::size_t ramps = state.range(1) == 1 ? 1 : batch;
+    std::string text;
+    for (std::size_t r = 1; r <= ramps; ++r) {
+        text += "LOADING_RAMP id=" + std::to_string(r) + " delivery-interval=1 batch-size="
+              + std::to_string(batch / ramps) + "\n";
+    }
+    text += "STOREHOUSE id=1 stock=aggregate\nSTOREHOUSE id=2 stock=aggregate\n";
+    for (std::size_t r = 1; r <= ramps; ++r) {
+        text += "LINK src=ramp-" + std::to_string(r) + " dest=store-1\n";
+        text += "LINK src=ramp-" + std::to_string(r) + " dest=store-2\n";
+    }
+    Factory factory = parse_factory_structure(text);
+    factory.get_context().seed(1);
+    SimulationContext::Scope scope(factory.get_context());
+
+    Time t = 0;
+    for (auto _ : state) {
+        ++t;
+        factory.get_context().set_current_turn(t);
+        factory.do_deliveries(t);
+        factory.do_package_passing();
+    }
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * batch));
+}
+
+// Argumenty: liczba odbiorców, wagi (0 = równe, 1 = różne).
+void BM_ChooseReceiver(benchmark::State& state) {
+    std::vector<Storehouse> stores;
+    stores.reserve(static_cast<std::size_t>(state.range(0)));
+    ReceiverPreferences prefs([n = 0u]() mutable { return ((n++ * 2654435761u) % 1000) / 1000.0; });
+    for (std::int64_t i = 0; i < state.range(0); ++i) {
+        stores.emplace_back(static_cast<ElementID>(i + 1));
+        prefs.add_receiver(&stores.back(), state.range(1) == 0 ? 1.0 : 1.0 + static_cast<double>(i % 7));
+    }
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(prefs.choose_receiver());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Argumenty: format raportu (ReportFormat), liczba węzłów.
+void BM_TurnReport(benchmark::State& state) {
+    std::istringstream is(generate_factory_structure(GeneratedTopology::LAYERED,
+                                                     static_cast<std::size_t>(state.range(1))));
+    Factory factory = load_factory_structure(is);
+    factory.get_context().seed(1);
+    simulate(factory, 50, [](Factory&, Time) {});
+
+    NullBuffer null;
+    std::ostream os(&null);
+    ReportWriter writer(os, static_cast<ReportFormat>(state.range(0)));
+    Time t = 50;
+    for (auto _ : state) {
+        writer.write_turn(factory, t);
+    }
+    writer.flush();
+    state.SetItemsProcessed(static_cast<std::int64_t>(
+        state.iterations() * (factory.get_workers().size() + factory.get_storehouses().size())));
+}
+
+// Porównanie kolejki opartej na buforze kołowym z dawną implementacją na std::list.
+// Każda iteracja to push + pop przy stałej liczbie paczek czekających w kolejce.
+
+class ListPackageQueue {
+public:
+    explicit ListPackageQueue(PackageQueueType type) : type_(type) {}
+
+    void push(Package&& package) { packages_.emplace_back(std::move(package)); }
+
+    Package pop() {
+        if (type_ == PackageQueueType::FIFO) {
+            Package pkg = std::move(packages_.front());
+            packages_.pop_front();
+            return pkg;
+        }
+        Package pkg = std::move(packages_.back());
+        packages_.pop_back();
+        return pkg;
+    }
+
+private:
+    PackageQueueType type_;
+    std::list<Package> packages_;
+};
+
+template <typename Queue>
+void run_queue_steady_state(benchmark::State& state, Queue& q) {
+    for (int64_t i = 0; i < state.range(0); ++i) {
+        q.push(Package());
+    }
+
+    for (auto _ : state) {
+        Package p = q.pop();
+        benchmark::DoNotOptimize(p.get_id());
+        q.push(std::move(p));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Argumenty: liczba paczek w kolejce, typ kolejki (0 = FIFO, 1 = LIFO).
+template <typename Queue>
+void BM_QueueSteadyState(benchmark::State& state) {
+    Queue q(state.range(1) == 0 ? PackageQueueType::FIFO : PackageQueueType::LIFO);
+    run_queue_steady_state(state, q);
+}
+
+// Kolejka z porządkiem ustalonym w czasie kompilacji; argument: liczba paczek.
+template <typename Order>
+void BM_TypedQueueSteadyState(benchmark::State& state) {
+    BasicPackageQueue<Order> q;
+    run_queue_steady_state(state, q);
+}
+
+} // unnamed namespace
+
+BENCHMARK(BM_LoadFactoryStructure)->Apply(network_args)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_BuildFactory)->Apply(build_factory_args)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_Sweep)->ArgsProduct({{100, 1000, 10'000}, {0, 1}})->ArgNames({"nodes", "sweep"})
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_FastForward)->Args({1'000'000, 0})->Args({1'000'000, 1})->Args({1'000'000'000, 1})
+    ->ArgNames({"turns", "fast_forward"})->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_IsConsistent)->Apply(network_args);
+BENCHMARK(BM_IsConsistentFullCheck)->Apply(network_args)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_SimulateTurn)->Apply(network_args)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_SimulateTurnCompiled)->Apply(network_args)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_RampBatch)->ArgsProduct({{10, 100, 500}, {0, 1}})->ArgNames({"packages", "batched"});
+BENCHMARK(BM_ChooseReceiver)->ArgsProduct({{1, 2, 4, 16, 64}, {0, 1}})->ArgNames({"receivers", "weighted"});
+BENCHMARK(BM_TurnReport)->ArgsProduct({{0, 1, 2, 3}, {100, 10'000}})->ArgNames({"format", "nodes"});
+
+BENCHMARK_TEMPLATE(BM_QueueSteadyState, PackageQueue)
+    ->ArgsProduct({benchmark::CreateRange(8, 1 << 20, 32), {0, 1}});
+BENCHMARK_TEMPLATE(BM_QueueSteadyState, ListPackageQueue)
+    ->ArgsProduct({benchmark::CreateRange(8, 1 << 20, 32), {0, 1}});
+BENCHMARK_TEMPLATE(BM_TypedQueueSteadyState, Fifo)->RangeMultiplier(32)->Range(8, 1 << 20);
+BENCHMARK_TEMPLATE(BM_TypedQueueSteadyState, Lifo)->RangeMultiplier(32)->Range(8, 1 << 20);
+
+BENCHMARK_MAIN();
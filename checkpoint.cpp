@@ -0,0 +1,334 @@
+#include "checkpoint.hxx"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include "factory_binary.hxx"
+#include "id_pool.hxx"
+#include "mapped_file.hxx"
+#include "simulation_context.hxx"
+#include "storage_types.hxx"
+
+namespace {
+
+constexpr char checkpoint_magic[8] = {'N', 'S', 'C', 'K', 'P', 'T', '\0', '\0'};
+
+template <typename T>
+void append(std::string& out, const T& value) {
+    const auto* bytes = reinterpret_cast<const char*>(&value);
+    out.append(bytes, sizeof(T));
+}
+
+class StateCursor {
+public:
+    explicit StateCursor(std::string_view bytes) : bytes_(bytes) {}
+
+    template <typename T>
+    T read() {
+        if (bytes_.size() < sizeof(T)) {
+            throw std::runtime_error("Truncated checkpoint");
+        }
+        T value;
+        std::memcpy(&value, bytes_.data(), sizeof(T));
+        bytes_.remove_prefix(sizeof(T));
+        return value;
+    }
+
+    std::string_view read_bytes(std::size_t n) {
+        if (bytes_.size() < n) {
+            throw std::runtime_error("Truncated checkpoint");
+        }
+        const std::string_view result = bytes_.substr(0, n);
+        bytes_.remove_prefix(n);
+        return result;
+    }
+
+    std::size_t remaining() const { return bytes_.size(); }
+
+private:
+    std::string_view bytes_;
+};
+
+} // unnamed namespace
+
+// Dostęp do prywatnego stanu węzłów.
+class CheckpointCodec {
+public:
+    static void save_state(const Factory& factory, std::string& out);
+    static void load_state(Factory& factory, StateCursor& cursor, std::uint32_t version);
+
+private:
+    static void put_package(std::string& out, const std::optional<Package>& package) {
+        append(out, static_cast<std::uint32_t>(package ? package->get_id() : 0));
+    }
+
+    static void put_packages(std::string& out, const IPackageStockpile& stock) {
+        append(out, static_cast<std::uint32_t>(stock.end() - stock.begin()));
+        for (const auto& package : stock) {
+            append(out, static_cast<std::uint32_t>(package.get_id()));
+        }
+    }
+
+    static std::optional<Package> get_package(StateCursor& cursor) {
+        const auto id = cursor.read<std::uint32_t>();
+        if (id == 0) {
+            return std::nullopt;
+        }
+        // Sprawdzane przed reserve(): duży ID rozdmuchałby bitmapę puli.
+        if (id > static_cast<std::uint32_t>(IdPool::max_reserved_id) ||
+            SimulationContext::current().id_pool().is_used(static_cast<ElementID>(id))) {
+            throw std::runtime_error("Invalid checkpoint package");
+        }
+        return Package(static_cast<ElementID>(id));
+    }
+
+    static void put_sender_metrics(std::string& out, const SenderMetrics& metrics) {
+        append(out, metrics.sent);
+        append(out, metrics.dropped);
+    }
+
+    static void get_sender_metrics(StateCursor& cursor, SenderMetrics& metrics) {
+        metrics.sent = cursor.read<std::uint64_t>();
+        metrics.dropped = cursor.read<std::uint64_t>();
+    }
+
+    static void put_worker_metrics(std::string& out, const WorkerMetrics& metrics) {
+        append(out, static_cast<std::int64_t>(metrics.last_turn_));
+        append(out, static_cast<std::uint8_t>(metrics.processing_));
+        append(out, static_cast<std::uint64_t>(metrics.queue_length_));
+        append(out, static_cast<std::uint64_t>(metrics.max_queue_length_));
+        append(out, metrics.busy_turns_);
+        append(out, metrics.idle_turns_);
+        append(out, metrics.queue_length_sum_);
+        append(out, metrics.received_);
+        append(out, metrics.processed_);
+    }
+
+    static void get_worker_metrics(StateCursor& cursor, WorkerMetrics& metrics) {
+        metrics.last_turn_ = static_cast<Time>(cursor.read<std::int64_t>());
+        metrics.processing_ = cursor.read<std::uint8_t>() != 0;
+        metrics.queue_length_ = static_cast<std::size_t>(cursor.read<std::uint64_t>());
+        metrics.max_queue_length_ = static_cast<std::size_t>(cursor.read<std::uint64_t>());
+        metrics.busy_turns_ = cursor.read<std::uint64_t>();
+        metrics.idle_turns_ = cursor.read<std::uint64_t>();
+        metrics.queue_length_sum_ = cursor.read<std::uint64_t>();
+        metrics.received_ = cursor.read<std::uint64_t>();
+        metrics.processed_ = cursor.read<std::uint64_t>();
+    }
+
+    template <typename Stock>
+    static void get_packages(StateCursor& cursor, Stock& stock) {
+        const auto n = cursor.read<std::uint32_t>();
+        for (std::uint32_t i = 0; i < n; ++i) {
+            std::optional<Package> package = get_package(cursor);
+            if (!package) {
+                throw std::runtime_error("Invalid checkpoint package");
+            }
+            stock.push_back(std::move(*package));
+        }
+    }
+};
+
+void CheckpointCodec::save_state(const Factory& factory, std::string& out) {
+    std::ostringstream rng_state;
+    rng_state << factory.get_context().rng();
+    const std::string rng_text = rng_state.str();
+    append(out, static_cast<std::uint32_t>(rng_text.size()));
+    out.append(rng_text);
+
+    for (const auto& r : factory.get_ramps()) {
+        put_package(out, r.get_sending_buffer());
+        append(out, static_cast<std::uint32_t>(r.get_sending_batch().size()));
+        for (const auto& package : r.get_sending_batch()) {
+            append(out, static_cast<std::uint32_t>(package.get_id()));
+        }
+        append(out, r.delivered_);
+        put_sender_metrics(out, r.sender_metrics_);
+    }
+    for (const auto& w : factory.get_workers()) {
+        append(out, static_cast<std::int64_t>(w.t_));
+        put_package(out, w.bufor_);
+        put_package(out, w.get_sending_buffer());
+        put_packages(out, *w.q_);
+        put_sender_metrics(out, w.sender_metrics_);
+        put_worker_metrics(out, w.metrics_);
+    }
+    for (const auto& s : factory.get_storehouses()) {
+        const auto* aggregate = dynamic_cast<const AggregateStockpile*>(s.d_.get());
+        append(out, static_cast<std::uint8_t>(aggregate != nullptr));
+        if (aggregate != nullptr) {
+            append(out, aggregate->delivered_);
+            append(out, static_cast<std::int64_t>(aggregate->first_arrival_));
+            append(out, static_cast<std::int64_t>(aggregate->last_arrival_));
+            for (std::uint64_t count : aggregate->histogram_) {
+                append(out, count);
+            }
+        }
+        put_packages(out, *s.d_);
+        append(out, s.arrivals_);
+    }
+}
+
+void CheckpointCodec::load_state(Factory& factory, StateCursor& cursor, std::uint32_t version) {
+    // Paczki rezerwują swoje ID w puli odtwarzanej fabryki.
+    SimulationContext::Scope scope(factory.get_context());
+
+    const auto rng_size = cursor.read<std::uint32_t>();
+    std::istringstream rng_state{std::string(cursor.read_bytes(rng_size))};
+    rng_state >> factory.get_context().rng();
+    if (!rng_state) {
+        throw std::runtime_error("Invalid checkpoint random state");
+    }
+
+    // Stockpiles take packages through push(); adapter for get_packages().
+    struct StockPusher {
+        IPackageStockpile& stock;
+        void push_back(Package&& package) { stock.push(std::move(package)); }
+    };
+
+    for (const auto& ramp : factory.get_ramps()) {
+        Ramp& r = *factory.find_ramp_by_id(ramp.get_id());
+        static_cast<PackageSender&>(r).bufor_ = get_package(cursor);
+        if (version >= 3) {
+            get_packages(cursor, static_cast<PackageSender&>(r).batch_);
+        }
+        if (version >= 2) {
+            r.delivered_ = cursor.read<std::uint64_t>();
+            get_sender_metrics(cursor, r.sender_metrics_);
+        }
+    }
+    for (const auto& worker : factory.get_workers()) {
+        Worker& w = *factory.find_worker_by_id(worker.get_id());
+        w.t_ = static_cast<Time>(cursor.read<std::int64_t>());
+        w.bufor_ = get_package(cursor);
+        static_cast<PackageSender&>(w).bufor_ = get_package(cursor);
+        StockPusher queue{*w.q_};
+        get_packages(cursor, queue);
+        if (version >= 2) {
+            get_sender_metrics(cursor, w.sender_metrics_);
+            get_worker_metrics(cursor, w.metrics_);
+        }
+    }
+    for (const auto& storehouse : factory.get_storehouses()) {
+        Storehouse& s = *factory.find_storehouse_by_id(storehouse.get_id());
+        auto* aggregate = dynamic_cast<AggregateStockpile*>(s.d_.get());
+        if (cursor.read<std::uint8_t>() != static_cast<std::uint8_t>(aggregate != nullptr)) {
+            throw std::runtime_error("Checkpoint stock type mismatch");
+        }
+        if (aggregate != nullptr) {
+            aggregate->delivered_ = cursor.read<std::uint64_t>();
+            aggregate->first_arrival_ = static_cast<Time>(cursor.read<std::int64_t>());
+            aggregate->last_arrival_ = static_cast<Time>(cursor.read<std::int64_t>());
+            for (std::uint64_t& count : aggregate->histogram_) {
+                count = cursor.read<std::uint64_t>();
+            }
+            // Kept packages go straight to the buffer: push() would count them.
+            get_packages(cursor, aggregate->recent_);
+        } else {
+            StockPusher stock{*s.d_};
+            get_packages(cursor, stock);
+        }
+        if (version >= 2) {
+            s.arrivals_ = cursor.read<std::uint64_t>();
+        }
+    }
+}
+
+void save_checkpoint(const Factory& factory, Time turn, std::ostream& os) {
+    std::string image;
+    append_checkpoint(factory, turn, image);
+    os.write(image.data(), static_cast<std::streamsize>(image.size()));
+}
+
+void append_checkpoint(const Factory& factory, Time turn, std::string& out) {
+    const std::size_t start = out.size();
+    append(out, CheckpointHeader{});
+
+    append_factory_binary(factory, out);
+    const std::size_t state_start = out.size();
+    CheckpointCodec::save_state(factory, out);
+
+    CheckpointHeader header{};
+    std::memcpy(header.magic, checkpoint_magic, sizeof(checkpoint_magic));
+    header.version = checkpoint_version;
+    header.header_size = sizeof(CheckpointHeader);
+    header.turn = static_cast<std::int64_t>(turn);
+    header.structure_size = state_start - start - sizeof(CheckpointHeader);
+    header.state_size = out.size() - state_start;
+    header.checksum = fnv1a_checksum(std::string_view(out).substr(state_start));
+    std::memcpy(out.data() + start, &header, sizeof(header));
+}
+
+Checkpoint load_checkpoint(std::string_view bytes) {
+    if (bytes.size() < sizeof(CheckpointHeader)
+        || std::memcmp(bytes.data(), checkpoint_magic, sizeof(checkpoint_magic)) != 0) {
+        throw std::runtime_error("Not a checkpoint");
+    }
+    CheckpointHeader header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (header.version < 1 || header.version > checkpoint_version
+        || header.header_size != sizeof(CheckpointHeader)) {
+        throw std::runtime_error("Unsupported checkpoint version");
+    }
+    bytes.remove_prefix(sizeof(CheckpointHeader));
+    if (header.structure_size > bytes.size() || bytes.size() - header.structure_size != header.state_size) {
+        throw std::runtime_error("Checkpoint size mismatch");
+    }
+    const std::string_view state = bytes.substr(header.structure_size);
+    if (fnv1a_checksum(state) != header.checksum) {
+        throw std::runtime_error("Checkpoint checksum mismatch");
+    }
+
+    Checkpoint checkpoint{load_factory_binary(bytes.substr(0, header.structure_size)),
+                          static_cast<Time>(header.turn)};
+    StateCursor cursor(state);
+    CheckpointCodec::load_state(checkpoint.factory, cursor, header.version);
+    if (cursor.remaining() != 0) {
+        throw std::runtime_error("Checkpoint size mismatch");
+    }
+    checkpoint.factory.get_context().set_current_turn(checkpoint.turn);
+    return checkpoint;
+}
+
+Checkpoint load_checkpoint_file(const std::string& path) {
+    MappedFile file(path);
+    return load_checkpoint(file.view());
+}
+
+// ===== PeriodicCheckpoint =====
+
+PeriodicCheckpoint::PeriodicCheckpoint(std::string path, TimeOffset interval)
+    : path_(std::move(path)), interval_(interval) {
+    if (interval_ <= 0) {
+        throw std::invalid_argument("Checkpoint interval must be positive");
+    }
+}
+
+void PeriodicCheckpoint::operator()(const Factory& factory, Time t) {
+    if (t % interval_ == 0) {
+        write(factory, t);
+    }
+}
+
+void PeriodicCheckpoint::write(const Factory& factory, Time t) {
+    buffer_.clear();
+    append_checkpoint(factory, t, buffer_);
+
+    const std::string tmp = path_ + ".tmp";
+    {
+        std::ofstream os(tmp, std::ios::binary | std::ios::trunc);
+        if (!os) {
+            throw std::runtime_error("Cannot open file: " + tmp);
+        }
+        os.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+        if (!os.flush()) {
+            throw std::runtime_error("Cannot write file: " + tmp);
+        }
+    }
+    std::filesystem::rename(tmp, path_);
+}
@@ -0,0 +1,102 @@
+#pragma once
+#ifndef CHECKPOINT_HXX
+#define CHECKPOINT_HXX
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <string_view>
+
+#include "factory.hxx"
+#include "types.hxx"
+
+// Punkt kontrolny symulacji.
+//
+// Layout (host byte order):
+//   CheckpointHeader
+//   factory structure in the binary format (factory_binary.hxx)
+//   state section:
+//     u32 n, n bytes        random generator state (std::mt19937 text form)
+//     per ramp              u32 sending package, u32 n, n * u32 further
+//                           packages of the batch (version 3);
+//                           counters (version 2)
+//     per worker            i64 processing start, u32 processing package,
+//                           u32 sending package, u32 n, n * u32 queued package;
+//                           counters (version 2)
+//     per storehouse        u8 stock (0 = queue, 1 = aggregate); aggregate:
+//                           u64 delivered, i64 first arrival, i64 last
+//                           arrival, u64 histogram[65]; then u32 n,
+//                           n * u32 stored package; u64 arrivals (version 2)
+//   counters of a ramp:     u64 delivered, u64 sent, u64 dropped
+//   counters of a worker:   u64 sent, u64 dropped, i64 last accounted turn,
+//                           u8 processing, u64 queue length, u64 maximum
+//                           queue length, u64 busy turns, u64 idle turns,
+//                           u64 queue length sum, u64 received, u64 processed
+//
+// Version 1 checkpoints (without counters, which then start from zero)
+// and version 2 checkpoints (without ramp batches) are still read.
+// Nodes appear in factory order, package IDs are >= 1 and 0 means "none".
+// Queues are listed in their iteration order, which is also their push
+// order. The package ID pool is not stored: its used IDs are exactly the
+// IDs of the live packages, which are reserved again on restore (so only
+// IDs up to IdPool::max_reserved_id can be restored). The checksum (FNV-1a)
+// covers the state section; the structure has its own.
+//
+// Probability generators are not part of the checkpoint. Restored senders
+// use the global probability_generator (backed by the restored random
+// state); counter-based generators keep no state between turns, so they
+// can simply be installed again with the same seed.
+struct CheckpointHeader {
+    char magic[8];                   // "NSCKPT\0\0"
+    std::uint32_t version;
+    std::uint32_t header_size;
+    std::int64_t turn;               // last simulated turn
+    std::uint64_t structure_size;
+    std::uint64_t state_size;
+    std::uint64_t checksum;
+};
+
+static_assert(sizeof(CheckpointHeader) == 48);
+
+constexpr std::uint32_t checkpoint_version = 3;
+
+// Factory restored from a checkpoint, with the turn it was taken after.
+struct Checkpoint {
+    Factory factory;
+    Time turn;
+};
+
+// The factory state after the given turn. Call it between turns (e.g. from
+// the report function); with a SimulationImage, after store().
+void save_checkpoint(const Factory& factory, Time turn, std::ostream& os);
+void append_checkpoint(const Factory& factory, Time turn, std::string& out);
+
+// Throws std::runtime_error for a malformed image or a checksum mismatch.
+// The restored context's current turn is the checkpoint's turn; continue
+// with simulate_from(factory, turn + 1, ...).
+Checkpoint load_checkpoint(std::string_view bytes);
+Checkpoint load_checkpoint_file(const std::string& path);
+
+// Zapis co K tur (do użycia w funkcji raportującej).
+//
+// After every interval-th turn the checkpoint is written to "<path>.tmp"
+// and renamed over path, so the file always holds a complete checkpoint.
+// The serialization buffer is reused between checkpoints.
+class PeriodicCheckpoint {
+public:
+    PeriodicCheckpoint(std::string path, TimeOffset interval);
+
+    void operator()(const Factory& factory, Time t);
+
+    // Writes a checkpoint regardless of the interval.
+    void write(const Factory& factory, Time t);
+
+    const std::string& path() const { return path_; }
+
+private:
+    std::string path_;
+    TimeOffset interval_;
+    std::string buffer_;
+};
+
+#endif // CHECKPOINT_HXX
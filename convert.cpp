@@ -0,0 +1,33 @@
+#include <cstring>
+#include <exception>
+#include <iostream>
+
+#include "factory_binary.hxx"
+
+// Konwerter plików struktury fabryki (tekst <-> format binarny).
+//
+// netsim_convert [--text | --binary] <input> <output>
+// The input format is detected; the output is binary unless --text is given.
+int main(int argc, char** argv) {
+    bool to_binary = true;
+    int arg = 1;
+    if (arg < argc && std::strcmp(argv[arg], "--text") == 0) {
+        to_binary = false;
+        ++arg;
+    } else if (arg < argc && std::strcmp(argv[arg], "--binary") == 0) {
+        ++arg;
+    }
+
+    if (argc - arg != 2) {
+        std::cerr << "usage: " << argv[0] << " [--text | --binary] <input> <output>\n";
+        return 2;
+    }
+
+    try {
+        convert_factory_file(argv[arg], argv[arg + 1], to_binary);
+    } catch (const std::exception& e) {
+        std::cerr << argv[0] << ": " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
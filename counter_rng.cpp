@@ -0,0 +1,46 @@
+#include "counter_rng.hxx"
+
+namespace {
+
+constexpr std::uint32_t philox_m0 = 0xD2511F53u;
+constexpr std::uint32_t philox_m1 = 0xCD9E8D57u;
+constexpr std::uint32_t philox_w0 = 0x9E3779B9u;
+constexpr std::uint32_t philox_w1 = 0xBB67AE85u;
+
+} // unnamed namespace
+
+std::array<std::uint32_t, 4> philox4x32(
+    std::array<std::uint32_t, 4> c,
+    std::array<std::uint32_t, 2> k
+) {
+    for (int round = 0; round < 10; ++round) {
+        const std::uint64_t p0 = static_cast<std::uint64_t>(philox_m0) * c[0];
+        const std::uint64_t p1 = static_cast<std::uint64_t>(philox_m1) * c[2];
+        c = {
+            static_cast<std::uint32_t>(p1 >> 32) ^ c[1] ^ k[0],
+            static_cast<std::uint32_t>(p1),
+            static_cast<std::uint32_t>(p0 >> 32) ^ c[3] ^ k[1],
+            static_cast<std::uint32_t>(p0)
+        };
+        k[0] += philox_w0;
+        k[1] += philox_w1;
+    }
+    return c;
+}
+
+double counter_probability(
+    std::uint64_t seed,
+    bool is_ramp,
+    ElementID sender_id,
+    Time turn,
+    std::uint32_t draw
+) {
+    const auto t = static_cast<std::uint64_t>(turn);
+    const auto r = philox4x32(
+        {static_cast<std::uint32_t>(t), static_cast<std::uint32_t>(t >> 32),
+         static_cast<std::uint32_t>(sender_id), (draw << 1) | (is_ramp ? 1u : 0u)},
+        {static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32)});
+
+    const std::uint64_t bits = (static_cast<std::uint64_t>(r[0]) << 32) | r[1];
+    return static_cast<double>(bits >> 11) * 0x1.0p-53;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#ifndef COUNTER_RNG_HXX
+#define COUNTER_RNG_HXX
+
+#include <array>
+#include <cstdint>
+
+#include "types.hxx"
+
+// Generator licznikowy Philox4x32-10 (Salmon et al., "Parallel random numbers:
+// as easy as 1, 2, 3").
+//
+// The output is a pure function of (counter, key): there is no state to share
+// or advance, so any draw can be recomputed independently - by any thread, in
+// any order.
+std::array<std::uint32_t, 4> philox4x32(
+    std::array<std::uint32_t, 4> counter,
+    std::array<std::uint32_t, 2> key
+);
+
+// Uniform number from [0, 1) with 53 random bits, keyed by
+// (seed, sender kind, sender ID, turn, draw number within the turn).
+double counter_probability(
+    std::uint64_t seed,
+    bool is_ramp,
+    ElementID sender_id,
+    Time turn,
+    std::uint32_t draw = 0
+);
+
+#endif // COUNTER_RNG_HXX
@@ -1,11 +1,40 @@
 #include "factory.hxx"
+#include "trace.hxx"
+
+#include <unordered_set>
+#include <vector>
+
+Factory::Factory(const FactoryResources& resources)
+    : resources_(resources),
+      ramps_(resources.topology),
+      workers_(resources.topology),
+      storehouses_(resources.topology),
+      topology_(std::make_unique<FactoryTopology>(resources.topology)) {}
+
+Factory& Factory::operator=(Factory&& other) noexcept {
+    if (this != &other) {
+        ramps_ = std::move(other.ramps_);
+        workers_ = std::move(other.workers_);
+        storehouses_ = std::move(other.storehouses_);
+        context_ = std::move(other.context_);
+        resources_ = other.resources_;
+        topology_ = std::move(other.topology_);
+    }
+    return *this;
+}
 
 void Factory::add_ramp(Ramp&& r) {
+    const ElementID id = r.get_id();
     ramps_.add(std::move(r));
+    topology_->add_sender(*ramps_.get_by_id(id));
 }
 
 void Factory::remove_ramp(ElementID id) {
+    if (Ramp* ramp = ramps_.get_by_id(id)) {
+        topology_->remove_sender(ramp->receiver_preferences_);
+    }
     ramps_.remove_by_id(id);
+    topology_->touch();
 }
 
 NodeCollection<Ramp>::iterator Factory::find_ramp_by_id(ElementID id) {
@@ -57,11 +86,14 @@ NodeCollection<Storehouse>::const_iterator Factory::find_storehouse_by_id(Elemen
 }
 
 void Factory::add_worker(Worker&& w) {
+    const ElementID id = w.get_id();
     workers_.add(std::move(w));
+    topology_->add_sender(*workers_.get_by_id(id));
 }
 
 void Factory::add_storehouse(Storehouse&& s) {
     storehouses_.add(std::move(s));
+    topology_->touch();
 }
 
 void Factory::remove_worker(ElementID id) {
@@ -72,66 +104,71 @@ void Factory::remove_storehouse(ElementID id) {
     remove_receiver(storehouses_, id);
 }
 
-bool has_reachable_storehouse(
-    const PackageSender* sender,
-    std::map<const PackageSender*, NodeColor>& colors
-) {
-    if (colors[sender] == NodeColor::VERIFIED)
-        return true;
-
-    colors[sender] = NodeColor::VISITED;
-
-    const auto& prefs = sender->receiver_preferences_;
-    if (prefs.empty()) {
-        throw std::logic_error("Sender has no receivers");
-    }
-
-    bool ok = false;
-
-    for (const auto& [receiver, _] : prefs) {
-        if (receiver->get_receiver_type() == ReceiverType::STOREHOUSE) {
-            ok = true;
-        } else {
-            auto worker = dynamic_cast<Worker*>(receiver);
-            auto next = dynamic_cast<PackageSender*>(worker);
-
-            if (next == sender) continue;
+FactoryUpstream Factory::get_upstream(const IPackageReceiver& receiver) const {
+    FactoryUpstream upstream;
+    topology_->upstream(&receiver, upstream.ramps, upstream.workers);
+    return upstream;
+}
 
-            ok = true;
+namespace {
 
-            if (colors[next] == NodeColor::UNVISITED) {
-                has_reachable_storehouse(next, colors);
-            }
+// Nadawca bez odbiorców (poza samym sobą; self = nullptr dla rampy).
+bool is_dead_end(const PackageSender& sender, const IPackageReceiver* self) {
+    for (const auto& [receiver, _] : sender.receiver_preferences_) {
+        if (receiver != self) {
+            return false;
         }
     }
-
-    colors[sender] = NodeColor::VERIFIED;
-
-    if (!ok) {
-        throw std::logic_error("No reachable storehouse");
-    }
-
     return true;
 }
 
+} // unnamed namespace
+
 bool Factory::is_consistent() const {
-    std::map<const PackageSender*, NodeColor> colors;
+    if (topology_->dead_end_count() == 0) {
+        return true;
+    }
 
-    for (const auto& r : ramps_)
-        colors[&r] = NodeColor::UNVISITED;
+    const std::uint64_t version = topology_->version();
+    const std::uint64_t cached = topology_->consistency_cache().load(std::memory_order_acquire);
+    if ((cached >> 1) == version) {
+        return (cached & 1) != 0;
+    }
 
-    for (const auto& w : workers_)
-        colors[&w] = NodeColor::UNVISITED;
+    // Iteracyjne przejście po robotnikach osiągalnych z ramp.
+    bool consistent = true;
+    std::unordered_set<const Worker*> visited;
+    std::vector<const Worker*> stack;
+    auto visit_receivers = [&](const PackageSender& sender) {
+        for (const auto& [receiver, _] : sender.receiver_preferences_) {
+            if (receiver->get_receiver_type() == ReceiverType::WORKER) {
+                const auto* worker = static_cast<const Worker*>(receiver);
+                if (visited.insert(worker).second) {
+                    stack.push_back(worker);
+                }
+            }
+        }
+    };
 
-    try {
-        for (const auto& r : ramps_) {
-            has_reachable_storehouse(&r, colors);
+    for (const auto& r : ramps_) {
+        if (is_dead_end(r, nullptr)) {
+            consistent = false;
+            break;
+        }
+        visit_receivers(r);
+    }
+    while (consistent && !stack.empty()) {
+        const Worker* worker = stack.back();
+        stack.pop_back();
+        if (is_dead_end(*worker, worker)) {
+            consistent = false;
+            break;
         }
-    } catch (const std::logic_error&) {
-        return false;
+        visit_receivers(*worker);
     }
 
-    return true;
+    topology_->consistency_cache().store(version << 1 | (consistent ? 1 : 0), std::memory_order_release);
+    return consistent;
 }
 
 void Factory::do_deliveries(Time t) {
@@ -141,8 +178,28 @@ void Factory::do_deliveries(Time t) {
 }
 
 void Factory::do_package_passing() {
-    for (auto& r : ramps_) r.send_package();
-    for (auto& w : workers_) w.send_package();
+    // Nadawca nie zna swojego ID – zdarzenia SEND zapisuje fabryka.
+    ITraceSink* sink = context_->trace();
+    auto trace_send = [&](TraceNode kind, ElementID id, const PackageSender& sender) {
+        if (sink != nullptr && sender.get_sending_buffer()) {
+            sink->record(make_trace_record(context_->current_turn(),
+                                           sender.get_sending_buffer()->get_id(),
+                                           id, TraceEvent::SEND, kind));
+            for (const auto& package : sender.get_sending_batch()) {
+                sink->record(make_trace_record(context_->current_turn(), package.get_id(),
+                                               id, TraceEvent::SEND, kind));
+            }
+        }
+    };
+
+    for (auto& r : ramps_) {
+        trace_send(TraceNode::RAMP, r.get_id(), r);
+        r.send_package();
+    }
+    for (auto& w : workers_) {
+        trace_send(TraceNode::WORKER, w.get_id(), w);
+        w.send_package();
+    }
 }
 
 void Factory::do_work(Time t) {
@@ -1,56 +1,222 @@
 #pragma once
 
-#include <list>
 #include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
 #include <utility>
-#include <map>
 #include <stdexcept>
+#include <memory>
+#include <memory_resource>
+#include <vector>
 #include "nodes.hxx"
+#include "factory_memory.hxx"
+#include "id_index.hxx"
+#include "simulation_context.hxx"
+#include "topology.hxx"
 
+// Kolekcja węzłów jednego rodzaju.
+//
+// Nodes are stored in fixed-size chunks which are never moved, so the address
+// of a node (e.g. an IPackageReceiver* kept in ReceiverPreferences) stays valid
+// until that node is removed. Iteration follows insertion order through a
+// dense array of node pointers, and find_by_id goes through an ID index.
+// Chunks and tables come from the collection's memory resource; senders
+// added to it get their receiver tables there as well.
 template <typename Node>
 class NodeCollection {
 public:
-    using container_t = std::list<Node>;
-    using iterator = typename container_t::iterator;
-    using const_iterator = typename container_t::const_iterator;
+    template <bool Const>
+    class basic_iterator {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = Node;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::conditional_t<Const, const Node*, Node*>;
+        using reference = std::conditional_t<Const, const Node&, Node&>;
+
+        basic_iterator() = default;
+        explicit basic_iterator(Node* const* p) : p_(p) {}
+
+        // iterator -> const_iterator
+        template <bool C = Const, typename = std::enable_if_t<C>>
+        basic_iterator(const basic_iterator<false>& other) : p_(other.base()) {}
+
+        reference operator*() const { return **p_; }
+        pointer operator->() const { return *p_; }
+
+        basic_iterator& operator++() { ++p_; return *this; }
+        basic_iterator operator++(int) { auto tmp = *this; ++p_; return tmp; }
+        basic_iterator& operator--() { --p_; return *this; }
+        basic_iterator operator--(int) { auto tmp = *this; --p_; return tmp; }
+        basic_iterator& operator+=(difference_type n) { p_ += n; return *this; }
+        basic_iterator& operator-=(difference_type n) { p_ -= n; return *this; }
+        friend basic_iterator operator+(basic_iterator it, difference_type n) { return it += n; }
+        friend basic_iterator operator-(basic_iterator it, difference_type n) { return it -= n; }
+        friend difference_type operator-(const basic_iterator& a, const basic_iterator& b) { return a.p_ - b.p_; }
+
+        friend bool operator==(const basic_iterator& a, const basic_iterator& b) { return a.p_ == b.p_; }
+
+        Node* const* base() const { return p_; }
+
+    private:
+        Node* const* p_ = nullptr;
+    };
+
+    using iterator = basic_iterator<false>;
+    using const_iterator = basic_iterator<true>;
+
+    NodeCollection() = default;
+    explicit NodeCollection(std::pmr::memory_resource* resource)
+        : resource_(resource), chunks_(resource), free_slots_(resource), order_(resource), index_(resource) {}
+
+    // The moved collection keeps its resource (the containers move with
+    // their allocators).
+    NodeCollection(NodeCollection&& other) noexcept
+        : resource_(other.resource_), chunks_(std::move(other.chunks_)),
+          chunk_fill_(std::exchange(other.chunk_fill_, chunk_size)),
+          free_slots_(std::move(other.free_slots_)), order_(std::move(other.order_)),
+          index_(std::exchange(other.index_, IdIndex(other.resource_))) {}
+
+    NodeCollection& operator=(NodeCollection&& other) noexcept {
+        if (this != &other) {
+            std::destroy_at(this);
+            std::construct_at(this, std::move(other));
+        }
+        return *this;
+    }
+
+    NodeCollection(const NodeCollection&) = delete;
+    NodeCollection& operator=(const NodeCollection&) = delete;
+
+    ~NodeCollection() {
+        destroy_all();
+        for (Slot* chunk : chunks_) {
+            resource_->deallocate(chunk, chunk_size * sizeof(Slot), alignof(Slot));
+        }
+    }
 
     void add(Node&& node) {
-        collection_.push_back(std::move(node));
+        const ElementID id = node.get_id();
+        if (index_.find(id) != IdIndex::npos) {
+            throw std::logic_error("Duplicate node ID");
+        }
+        Node* slot = allocate_slot();
+        if constexpr (std::is_constructible_v<Node, Node&&, std::pmr::memory_resource*>) {
+            std::construct_at(slot, std::move(node), resource_);
+        } else {
+            std::construct_at(slot, std::move(node));
+        }
+        index_.assign(id, order_.size());
+        order_.push_back(slot);
     }
 
     iterator find_by_id(ElementID id) {
-        return std::find_if(collection_.begin(), collection_.end(),
-            [id](const Node& n) { return n.get_id() == id; });
+        return iterator(order_.data() + position_of(id));
     }
 
     const_iterator find_by_id(ElementID id) const {
-        return std::find_if(collection_.cbegin(), collection_.cend(),
-            [id](const Node& n) { return n.get_id() == id; });
+        return const_iterator(order_.data() + position_of(id));
+    }
+
+    // O(1) lookup of the node's address; nullptr if absent.
+    Node* get_by_id(ElementID id) {
+        const std::size_t pos = index_.find(id);
+        return pos == IdIndex::npos ? nullptr : order_[pos];
+    }
+
+    const Node* get_by_id(ElementID id) const {
+        const std::size_t pos = index_.find(id);
+        return pos == IdIndex::npos ? nullptr : order_[pos];
     }
 
     void remove_by_id(ElementID id) {
-        auto it = find_by_id(id);
-        if (it != collection_.end()) {
-            collection_.erase(it);
+        const std::size_t pos = index_.find(id);
+        if (pos == IdIndex::npos) {
+            return;
+        }
+        Node* node = order_[pos];
+        index_.erase(id);
+        order_.erase(order_.begin() + static_cast<std::ptrdiff_t>(pos));
+        for (std::size_t i = pos; i < order_.size(); ++i) {
+            index_.assign(order_[i]->get_id(), i);
         }
+        std::destroy_at(node);
+        free_slots_.push_back(node);
     }
 
-    iterator begin() { return collection_.begin(); }
-    iterator end() { return collection_.end(); }
+    iterator begin() { return iterator(order_.data()); }
+    iterator end() { return iterator(order_.data() + order_.size()); }
+
+    const_iterator begin() const { return const_iterator(order_.data()); }
+    const_iterator end() const { return const_iterator(order_.data() + order_.size()); }
 
-    const_iterator begin() const { return collection_.cbegin(); }
-    const_iterator end() const { return collection_.cend(); }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
 
-    const_iterator cbegin() const { return collection_.cbegin(); }
-    const_iterator cend() const { return collection_.cend(); }
+    std::size_t size() const { return order_.size(); }
+    bool empty() const { return order_.empty(); }
 
 private:
-    container_t collection_;
+    static constexpr std::size_t chunk_size = 256;
+
+    struct alignas(Node) Slot {
+        std::byte bytes[sizeof(Node)];
+    };
+
+    std::pmr::memory_resource* resource_ = std::pmr::get_default_resource();
+    std::pmr::vector<Slot*> chunks_;
+    std::size_t chunk_fill_ = chunk_size;   // slots used in the last chunk
+    std::pmr::vector<Node*> free_slots_;
+    std::pmr::vector<Node*> order_;
+    IdIndex index_;
+
+    std::size_t position_of(ElementID id) const {
+        const std::size_t pos = index_.find(id);
+        return pos == IdIndex::npos ? order_.size() : pos;
+    }
+
+    Node* allocate_slot() {
+        if (!free_slots_.empty()) {
+            Node* slot = free_slots_.back();
+            free_slots_.pop_back();
+            return slot;
+        }
+        if (chunk_fill_ == chunk_size) {
+            void* chunk = resource_->allocate(chunk_size * sizeof(Slot), alignof(Slot));
+            chunks_.push_back(static_cast<Slot*>(chunk));
+            chunk_fill_ = 0;
+        }
+        return reinterpret_cast<Node*>(&chunks_.back()[chunk_fill_++]);
+    }
+
+    void destroy_all() {
+        for (Node* node : order_) {
+            std::destroy_at(node);
+        }
+        order_.clear();
+    }
 };
 
 
+// Nadawcy połączeni z danym odbiorcą (see Factory::get_upstream).
+struct FactoryUpstream {
+    std::vector<const Ramp*> ramps;
+    std::vector<const Worker*> workers;
+};
+
 class Factory {
 public:
+    Factory() = default;
+    // Nodes, links and topology state go to resources.topology; queues
+    // created for the factory (parser, loaders, copy) use resources.packages.
+    explicit Factory(const FactoryResources& resources);
+
+    Factory(Factory&&) = default;
+    // The old nodes are destroyed before the context is taken over: their
+    // packages release IDs into the old context's pool.
+    Factory& operator=(Factory&& other) noexcept;
+
     // Rampy
     void add_ramp(Ramp&& r);
     void remove_ramp(ElementID id);
@@ -84,7 +250,14 @@ public:
     void remove_storehouse(ElementID id);
 
     // Logika
+    // Every sender reachable from a ramp must have a receiver other than
+    // itself. O(1) while no sender is a dead end; otherwise one iterative
+    // traversal per topology version.
     bool is_consistent() const;
+
+    // Senders with a link to the receiver, in link order. O(in-degree).
+    FactoryUpstream get_upstream(const IPackageReceiver& receiver) const;
+
     void do_deliveries(Time t);
     void do_package_passing();
     void do_work(Time t);
@@ -94,22 +267,46 @@ public:
     const NodeCollection<Worker>& get_workers() const { return workers_; }
     const NodeCollection<Storehouse>& get_storehouses() const { return storehouses_; }
 
+    // Changes whenever a node or a link is added or removed. Values are
+    // unique across all factories, so (factory, version) identifies a network.
+    std::uint64_t get_topology_version() const { return topology_->version(); }
+
+    const FactoryResources& get_resources() const { return resources_; }
+
+    // Kontekst symulacji (pula ID paczek) – własny dla każdej fabryki.
+    SimulationContext& get_context() { return *context_; }
+    const SimulationContext& get_context() const { return *context_; }
+
 private:
+    friend class SimulationImage;
+
+    // Declared first so that it outlives every package held by the nodes
+    // (see also the move assignment).
+    std::unique_ptr<SimulationContext> context_ = std::make_unique<SimulationContext>();
+
+    FactoryResources resources_;
+
     NodeCollection<Ramp> ramps_;
     NodeCollection<Worker> workers_;
     NodeCollection<Storehouse> storehouses_;
 
+    std::unique_ptr<FactoryTopology> topology_ = std::make_unique<FactoryTopology>();
+
     template <typename Node>
     void remove_receiver(NodeCollection<Node>& collection, ElementID id);
 };
 
 template <typename Node>
 void Factory::remove_receiver(NodeCollection<Node>& collection, ElementID id) {
-    for (auto& r : ramps_) {
-        r.receiver_preferences_.remove_receiver(id);
+    Node* node = collection.get_by_id(id);
+    if (node == nullptr) {
+        return;
     }
-    for (auto& w : workers_) {
-        w.receiver_preferences_.remove_receiver(id);
+    // Only the senders actually linked to the node are visited.
+    topology_->unlink_receiver(node);
+    if constexpr (std::is_same_v<Node, Worker>) {
+        topology_->remove_sender(node->receiver_preferences_);
     }
     collection.remove_by_id(id);
+    topology_->touch();
 }
\ No newline at end of file
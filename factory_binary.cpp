@@ -0,0 +1,264 @@
+#include "factory_binary.hxx"
+
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "factory.hxx"
+#include "factory_parser.hxx"
+#include "helpers.hxx"
+#include "mapped_file.hxx"
+#include "storage_types.hxx"
+
+namespace {
+
+constexpr char binary_magic[8] = {'N', 'S', 'F', 'A', 'C', 'T', '\0', '\0'};
+
+template <typename T>
+void append(std::string& out, const T& value) {
+    const auto* bytes = reinterpret_cast<const char*>(&value);
+    out.append(bytes, sizeof(T));
+}
+
+// Odczyt kolejnych rekordów z obrazu (bez założeń o wyrównaniu).
+class BinaryCursor {
+public:
+    explicit BinaryCursor(std::string_view bytes) : bytes_(bytes) {}
+
+    template <typename T>
+    T read() {
+        if (bytes_.size() < sizeof(T)) {
+            throw std::runtime_error("Truncated factory binary");
+        }
+        T value;
+        std::memcpy(&value, bytes_.data(), sizeof(T));
+        bytes_.remove_prefix(sizeof(T));
+        return value;
+    }
+
+    std::size_t remaining() const { return bytes_.size(); }
+
+private:
+    std::string_view bytes_;
+};
+
+// Okresy zapisane jako int64; węzły przyjmują dodatni TimeOffset.
+bool is_valid_offset(std::int64_t value) {
+    return value > 0 && value <= std::numeric_limits<TimeOffset>::max();
+}
+
+} // unnamed namespace
+
+std::uint64_t fnv1a_checksum(std::string_view bytes) {
+    std::uint64_t hash = 0xcbf29ce484222325ull;
+    for (unsigned char c : bytes) {
+        hash ^= c;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+void save_factory_binary(const Factory& factory, std::ostream& os) {
+    std::string image;
+    append_factory_binary(factory, image);
+    os.write(image.data(), static_cast<std::streamsize>(image.size()));
+}
+
+void append_factory_binary(const Factory& factory, std::string& out) {
+    const auto& ramps = factory.get_ramps();
+    const auto& workers = factory.get_workers();
+    const auto& stores = factory.get_storehouses();
+
+    std::string payload;
+
+    for (const auto& r : ramps) {
+        append(payload, BinaryRamp{r.get_id(), static_cast<std::uint32_t>(r.get_batch_size()),
+                                   static_cast<std::int64_t>(r.get_delivery_interval())});
+    }
+    for (const auto& w : workers) {
+        append(payload, BinaryWorker{w.get_id(),
+                                     static_cast<std::uint8_t>(w.get_queue_type() == PackageQueueType::LIFO),
+                                     {}, static_cast<std::int64_t>(w.get_processing_time())});
+    }
+    for (const auto& s : stores) {
+        const auto* aggregate = dynamic_cast<const AggregateStockpile*>(&s.get_stock());
+        append(payload, BinaryStorehouse{s.get_id(), static_cast<std::uint8_t>(aggregate != nullptr), {},
+                                         aggregate != nullptr ? aggregate->keep_last() : 0});
+    }
+
+    // Odbiorcy jako indeksy w tablicach robotników i magazynów.
+    auto to_link = [&](const IPackageReceiver* receiver, double weight) {
+        if (receiver->get_receiver_type() == ReceiverType::WORKER) {
+            const auto index = workers.find_by_id(receiver->get_id()) - workers.begin();
+            return BinaryLink{0, {}, static_cast<std::uint32_t>(index), weight};
+        }
+        const auto index = stores.find_by_id(receiver->get_id()) - stores.begin();
+        return BinaryLink{1, {}, static_cast<std::uint32_t>(index), weight};
+    };
+
+    std::vector<BinaryLink> links;
+    std::uint64_t offset = 0;
+    auto add_sender = [&](const ReceiverPreferences& prefs) {
+        append(payload, offset);
+        for (std::size_t i = 0; i < prefs.size(); ++i) {
+            links.push_back(to_link(prefs.get_preferences()[i].first, prefs.weight(i)));
+        }
+        offset = links.size();
+    };
+    for (const auto& r : ramps) add_sender(r.receiver_preferences_);
+    for (const auto& w : workers) add_sender(w.receiver_preferences_);
+    append(payload, offset);
+
+    for (const auto& link : links) {
+        append(payload, link);
+    }
+
+    FactoryBinaryHeader header{};
+    std::memcpy(header.magic, binary_magic, sizeof(binary_magic));
+    header.version = factory_binary_version;
+    header.header_size = sizeof(FactoryBinaryHeader);
+    header.ramp_count = static_cast<std::uint32_t>(ramps.size());
+    header.worker_count = static_cast<std::uint32_t>(workers.size());
+    header.storehouse_count = static_cast<std::uint32_t>(stores.size());
+    header.link_count = links.size();
+    header.checksum = fnv1a_checksum(payload);
+
+    append(out, header);
+    out.append(payload);
+}
+
+bool is_factory_binary(std::string_view bytes) {
+    return bytes.size() >= sizeof(binary_magic)
+        && std::memcmp(bytes.data(), binary_magic, sizeof(binary_magic)) == 0;
+}
+
+Factory load_factory_binary(std::string_view bytes, const FactoryResources& resources) {
+    if (!is_factory_binary(bytes)) {
+        throw std::runtime_error("Not a factory binary");
+    }
+    BinaryCursor cursor(bytes);
+    const auto header = cursor.read<FactoryBinaryHeader>();
+    if (header.version < 1 || header.version > factory_binary_version
+        || header.header_size != sizeof(FactoryBinaryHeader)) {
+        throw std::runtime_error("Unsupported factory binary version");
+    }
+
+    const std::uint64_t senders = std::uint64_t{header.ramp_count} + header.worker_count;
+    const std::uint64_t expected_size =
+        sizeof(BinaryRamp) * std::uint64_t{header.ramp_count}
+        + sizeof(BinaryWorker) * std::uint64_t{header.worker_count}
+        + sizeof(BinaryStorehouse) * std::uint64_t{header.storehouse_count}
+        + sizeof(std::uint64_t) * (senders + 1)
+        + sizeof(BinaryLink) * header.link_count;
+    if (cursor.remaining() != expected_size) {
+        throw std::runtime_error("Factory binary size mismatch");
+    }
+    if (fnv1a_checksum(bytes.substr(sizeof(FactoryBinaryHeader))) != header.checksum) {
+        throw std::runtime_error("Factory binary checksum mismatch");
+    }
+
+    Factory factory(resources);
+    std::vector<Ramp*> ramps;
+    std::vector<Worker*> workers;
+    std::vector<Storehouse*> stores;
+    ramps.reserve(header.ramp_count);
+    workers.reserve(header.worker_count);
+    stores.reserve(header.storehouse_count);
+
+    for (std::uint32_t i = 0; i < header.ramp_count; ++i) {
+        const auto r = cursor.read<BinaryRamp>();
+        if ((header.version >= 2 && r.batch_size == 0) || !is_valid_offset(r.delivery_interval)
+            || std::as_const(factory).find_ramp_by_id(r.id) != factory.ramp_cend()) {
+            throw std::runtime_error("Invalid factory binary ramp");
+        }
+        factory.add_ramp(Ramp(r.id, static_cast<TimeOffset>(r.delivery_interval),
+                              r.batch_size == 0 ? 1 : r.batch_size));
+        ramps.push_back(&*factory.find_ramp_by_id(r.id));
+    }
+    for (std::uint32_t i = 0; i < header.worker_count; ++i) {
+        const auto w = cursor.read<BinaryWorker>();
+        if (!is_valid_offset(w.processing_time)
+            || std::as_const(factory).find_worker_by_id(w.id) != factory.worker_cend()) {
+            throw std::runtime_error("Invalid factory binary worker");
+        }
+        const auto type = w.queue_type != 0 ? PackageQueueType::LIFO : PackageQueueType::FIFO;
+        factory.add_worker(Worker(w.id, static_cast<TimeOffset>(w.processing_time),
+                                  make_package_queue(type, resources.packages)));
+        workers.push_back(&*factory.find_worker_by_id(w.id));
+    }
+    for (std::uint32_t i = 0; i < header.storehouse_count; ++i) {
+        const auto s = cursor.read<BinaryStorehouse>();
+        if (std::as_const(factory).find_storehouse_by_id(s.id) != factory.storehouse_cend()) {
+            throw std::runtime_error("Invalid factory binary storehouse");
+        }
+        if (s.stock != 0) {
+            factory.add_storehouse(Storehouse(s.id, make_stockpile<AggregateStockpile>(
+                resources.packages, static_cast<std::size_t>(s.keep_last), resources.packages)));
+        } else {
+            factory.add_storehouse(
+                Storehouse(s.id, make_package_queue(PackageQueueType::FIFO, resources.packages)));
+        }
+        stores.push_back(&*factory.find_storehouse_by_id(s.id));
+    }
+
+    std::vector<std::uint64_t> offsets(senders + 1);
+    for (auto& offset : offsets) {
+        offset = cursor.read<std::uint64_t>();
+    }
+    if (offsets.front() != 0 || offsets.back() != header.link_count) {
+        throw std::runtime_error("Invalid factory binary link table");
+    }
+
+    std::vector<ReceiverPreferences::receiver_weight_t> receivers;
+    for (std::uint64_t s = 0; s < senders; ++s) {
+        if (offsets[s + 1] < offsets[s]) {
+            throw std::runtime_error("Invalid factory binary link table");
+        }
+        ReceiverPreferences& prefs = s < header.ramp_count
+            ? ramps[s]->receiver_preferences_
+            : workers[s - header.ramp_count]->receiver_preferences_;
+        receivers.clear();
+        for (std::uint64_t l = offsets[s]; l < offsets[s + 1]; ++l) {
+            const auto link = cursor.read<BinaryLink>();
+            IPackageReceiver* receiver = nullptr;
+            if (link.kind == 0 && link.index < workers.size()) {
+                receiver = workers[link.index];
+            } else if (link.kind == 1 && link.index < stores.size()) {
+                receiver = stores[link.index];
+            } else {
+                throw std::runtime_error("Invalid factory binary link");
+            }
+            receivers.emplace_back(receiver, link.weight);
+        }
+        prefs.add_receivers(receivers);
+    }
+
+    return factory;
+}
+
+Factory load_factory_binary_file(const std::string& path, const FactoryResources& resources) {
+    MappedFile file(path);
+    return load_factory_binary(file.view(), resources);
+}
+
+void convert_factory_file(const std::string& input, const std::string& output, bool to_binary) {
+    Factory factory = [&input] {
+        MappedFile file(input);
+        return is_factory_binary(file.view()) ? load_factory_binary(file.view())
+                                              : parse_factory_structure(file.view());
+    }();
+
+    std::ofstream os(output, to_binary ? std::ios::binary : std::ios::out);
+    if (!os) {
+        throw std::runtime_error("Cannot open file: " + output);
+    }
+    if (to_binary) {
+        save_factory_binary(factory, os);
+    } else {
+        save_factory_structure(factory, os);
+    }
+}
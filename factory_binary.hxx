@@ -0,0 +1,101 @@
+#pragma once
+#ifndef FACTORY_BINARY_HXX
+#define FACTORY_BINARY_HXX
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <string_view>
+
+#include "factory_memory.hxx"
+
+class Factory;
+
+// Binarny format struktury fabryki.
+//
+// Layout (host byte order, every section 8-byte aligned):
+//   FactoryBinaryHeader
+//   BinaryRamp[ramp_count]
+//   BinaryWorker[worker_count]
+//   BinaryStorehouse[storehouse_count]
+//   std::uint64_t link_offset[ramp_count + worker_count + 1]
+//   BinaryLink[link_count]
+//
+// Links form a CSR table: the receivers of sender s (ramps first, then
+// workers, in table order) are link_offset[s] .. link_offset[s + 1] - 1.
+// Receivers are indices into the worker or storehouse table, so loading
+// needs no ID lookups. The checksum (FNV-1a, 64 bit) covers everything
+// after the header.
+//
+// Version 1 files are still read: batch_size was a reserved word there, so
+// 0 means one package per delivery.
+
+struct FactoryBinaryHeader {
+    char magic[8];                   // "NSFACT\0\0"
+    std::uint32_t version;
+    std::uint32_t header_size;
+    std::uint32_t ramp_count;
+    std::uint32_t worker_count;
+    std::uint32_t storehouse_count;
+    std::uint32_t reserved;
+    std::uint64_t link_count;
+    std::uint64_t checksum;
+};
+
+struct BinaryRamp {
+    std::int32_t id;
+    std::uint32_t batch_size;        // >= 1 (version 1: 0 = 1)
+    std::int64_t delivery_interval;
+};
+
+struct BinaryWorker {
+    std::int32_t id;
+    std::uint8_t queue_type;         // 0 = FIFO, 1 = LIFO
+    std::uint8_t reserved[3];
+    std::int64_t processing_time;
+};
+
+struct BinaryStorehouse {
+    std::int32_t id;
+    std::uint8_t stock;              // 0 = queue, 1 = aggregate
+    std::uint8_t reserved[3];
+    std::uint64_t keep_last;
+};
+
+struct BinaryLink {
+    std::uint8_t kind;               // 0 = worker, 1 = storehouse
+    std::uint8_t reserved[3];
+    std::uint32_t index;
+    double weight;
+};
+
+static_assert(sizeof(FactoryBinaryHeader) == 48);
+static_assert(sizeof(BinaryRamp) == 16);
+static_assert(sizeof(BinaryWorker) == 16);
+static_assert(sizeof(BinaryStorehouse) == 16);
+static_assert(sizeof(BinaryLink) == 16);
+
+constexpr std::uint32_t factory_binary_version = 2;
+
+void save_factory_binary(const Factory& factory, std::ostream& os);
+// Appends the image to a buffer (e.g. to embed it in a checkpoint).
+void append_factory_binary(const Factory& factory, std::string& out);
+
+// Builds the factory from an in-memory image of the format; throws
+// std::runtime_error for a malformed image or a checksum mismatch.
+Factory load_factory_binary(std::string_view bytes, const FactoryResources& resources = {});
+
+// Memory-maps the file and loads it.
+Factory load_factory_binary_file(const std::string& path, const FactoryResources& resources = {});
+
+// FNV-1a, 64 bit.
+std::uint64_t fnv1a_checksum(std::string_view bytes);
+
+// True if the bytes start with the binary format's magic number.
+bool is_factory_binary(std::string_view bytes);
+
+// Konwersja między formatami: the input format is detected from its
+// contents, the output is binary when to_binary is set, text otherwise.
+void convert_factory_file(const std::string& input, const std::string& output, bool to_binary);
+
+#endif // FACTORY_BINARY_HXX
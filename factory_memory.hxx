@@ -0,0 +1,49 @@
+#pragma once
+#ifndef FACTORY_MEMORY_HXX
+#define FACTORY_MEMORY_HXX
+
+#include <cstddef>
+#include <memory_resource>
+
+// Zasoby pamięci fabryki.
+//
+// `topology` holds what is built once and lives as long as the network:
+// node storage, ID indexes, receiver tables and the link state.
+// `packages` holds what grows and shrinks during a simulation: the package
+// storage of worker queues and storehouse stockpiles. Both resources must
+// outlive every factory built on them.
+struct FactoryResources {
+    std::pmr::memory_resource* topology = std::pmr::get_default_resource();
+    std::pmr::memory_resource* packages = std::pmr::get_default_resource();
+};
+
+// Arena dla fabryk budowanych jedna po drugiej (e.g. by one thread of a
+// parameter sweep).
+//
+// The topology goes into a monotonic buffer (no per-node heap allocations,
+// nothing is freed before release()), packages into a pool which reuses
+// freed queue blocks. Not thread-safe: every thread needs its own arena.
+class FactoryArena {
+public:
+    explicit FactoryArena(std::size_t initial_size = 64 * 1024,
+                          std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+        : topology_(initial_size, upstream), packages_(upstream) {}
+
+    FactoryArena(const FactoryArena&) = delete;
+    FactoryArena& operator=(const FactoryArena&) = delete;
+
+    FactoryResources resources() { return {&topology_, &packages_}; }
+
+    // Returns all memory to the upstream resource; no factory built on the
+    // arena may be alive.
+    void release() {
+        packages_.release();
+        topology_.release();
+    }
+
+private:
+    std::pmr::monotonic_buffer_resource topology_;
+    std::pmr::unsynchronized_pool_resource packages_;
+};
+
+#endif // FACTORY_MEMORY_HXX
@@ -0,0 +1,310 @@
+#include "factory_parser.hxx"
+
+#include <charconv>
+#include <memory>
+#include <vector>
+
+#include "factory.hxx"
+#include "mapped_file.hxx"
+#include "storage_types.hxx"
+
+FactoryParseError::FactoryParseError(std::size_t line, std::size_t column, const std::string& message)
+    : std::logic_error("line " + std::to_string(line) + ", column " + std::to_string(column) + ": " + message),
+      line_(line), column_(column) {}
+
+namespace {
+
+struct Token {
+    std::string_view key;
+    std::string_view value;
+    std::size_t column;       // column of the value
+};
+
+// Jedna linia pliku: typ elementu i pary key=value (bez kopiowania).
+// Tokens go to storage shared by all lines of a file, so any number of
+// pairs is accepted without an allocation per line.
+class LineParser {
+public:
+    LineParser(std::string_view line, std::size_t line_number, std::vector<Token>& tokens)
+        : line_(line), line_number_(line_number), tokens_(tokens) {
+        tokens_.clear();
+    }
+
+    // Splits the line; false for blank and comment lines.
+    bool tokenize() {
+        std::size_t pos = skip_spaces(0);
+        if (pos == line_.size() || line_[pos] == '#' || line_[pos] == ';') {
+            return false;
+        }
+
+        std::size_t end = token_end(pos);
+        type_ = line_.substr(pos, end - pos);
+        type_column_ = pos + 1;
+
+        for (pos = skip_spaces(end); pos < line_.size(); pos = skip_spaces(end)) {
+            end = token_end(pos);
+            const std::string_view token = line_.substr(pos, end - pos);
+            const std::size_t eq = token.find('=');
+            if (eq == std::string_view::npos) {
+                fail(pos, "Invalid key=value");
+            }
+            tokens_.push_back(Token{token.substr(0, eq), token.substr(eq + 1), pos + eq + 2});
+        }
+        return true;
+    }
+
+    std::string_view type() const { return type_; }
+    std::size_t type_column() const { return type_column_; }
+
+    // The last occurrence of a key wins (as with repeated keys before).
+    const Token* find(std::string_view key) const {
+        for (std::size_t i = tokens_.size(); i > 0; --i) {
+            if (tokens_[i - 1].key == key) {
+                return &tokens_[i - 1];
+            }
+        }
+        return nullptr;
+    }
+
+    const Token& require(std::string_view key) const {
+        const Token* token = find(key);
+        if (token == nullptr) {
+            fail(line_.size(), "Missing parameter: " + std::string(key));
+        }
+        return *token;
+    }
+
+    template <typename T>
+    T number(const Token& token) const {
+        T value{};
+        const char* first = token.value.data();
+        const char* last = first + token.value.size();
+        auto [ptr, ec] = std::from_chars(first, last, value);
+        if (ec != std::errc() || ptr != last || token.value.empty()) {
+            fail(token.column - 1, "Invalid number: " + std::string(token.value));
+        }
+        return value;
+    }
+
+    // pos is a 0-based offset within the line.
+    [[noreturn]] void fail(std::size_t pos, const std::string& message) const {
+        throw FactoryParseError(line_number_, pos + 1, message);
+    }
+
+    [[noreturn]] void fail_at(const Token& token, const std::string& message) const {
+        fail(token.column - 1, message);
+    }
+
+private:
+    std::string_view line_;
+    std::size_t line_number_;
+    std::string_view type_;
+    std::size_t type_column_ = 0;
+    std::vector<Token>& tokens_;
+
+    static bool is_space(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+    std::size_t skip_spaces(std::size_t pos) const {
+        while (pos < line_.size() && is_space(line_[pos])) ++pos;
+        return pos;
+    }
+
+    std::size_t token_end(std::size_t pos) const {
+        while (pos < line_.size() && !is_space(line_[pos])) ++pos;
+        return pos;
+    }
+};
+
+// Połączenia nadawcy zbierane z kolejnych linii LINK (saved files list
+// them sender by sender) and added with one add_receivers() call, so a
+// fan-out of n links costs O(n). Nodes never move, so the pointers stay
+// valid until flush().
+class PendingLinks {
+public:
+    void add(ReceiverPreferences& sender, IPackageReceiver* receiver, double weight) {
+        if (&sender != sender_) {
+            flush();
+            sender_ = &sender;
+        }
+        links_.emplace_back(receiver, weight);
+    }
+
+    void flush() {
+        if (sender_ != nullptr) {
+            sender_->add_receivers(links_);
+        }
+        sender_ = nullptr;
+        links_.clear();
+    }
+
+private:
+    ReceiverPreferences* sender_ = nullptr;
+    std::vector<ReceiverPreferences::receiver_weight_t> links_;
+};
+
+IPackageReceiver* find_receiver(Factory& factory, const LineParser& line, const Token& token) {
+    const std::size_t dash = token.value.find('-');
+    if (dash == std::string_view::npos || dash == 0 || dash + 1 >= token.value.size()) {
+        line.fail_at(token, "Invalid endpoint format (expected type-id)");
+    }
+    const std::string_view type = token.value.substr(0, dash);
+    const auto id = line.number<ElementID>(Token{{}, token.value.substr(dash + 1), token.column + dash + 1});
+
+    if (type == "worker") {
+        auto it = factory.find_worker_by_id(id);
+        if (it != factory.worker_cend()) {
+            return &*it;
+        }
+    } else if (type == "store") {
+        auto it = factory.find_storehouse_by_id(id);
+        if (it != factory.storehouse_cend()) {
+            return &*it;
+        }
+    } else {
+        line.fail_at(token, "Invalid LINK destination type");
+    }
+    line.fail_at(token, "Invalid LINK destination");
+}
+
+void add_link(Factory& factory, const LineParser& line, PendingLinks& links) {
+    const Token& src = line.require("src");
+    const Token& dest = line.require("dest");
+
+    // Opcjonalna waga połączenia (domyślnie 1 – rozkład jednostajny).
+    double weight = 1.0;
+    if (const Token* w = line.find("weight")) {
+        weight = line.number<double>(*w);
+        if (!(weight > 0.0)) {
+            line.fail_at(*w, "Receiver weight must be positive");
+        }
+    }
+
+    IPackageReceiver* receiver = find_receiver(factory, line, dest);
+
+    // Source must be a sender: ramp or worker
+    const std::size_t dash = src.value.find('-');
+    if (dash == std::string_view::npos || dash == 0 || dash + 1 >= src.value.size()) {
+        line.fail_at(src, "Invalid endpoint format (expected type-id)");
+    }
+    const std::string_view type = src.value.substr(0, dash);
+    const auto id = line.number<ElementID>(Token{{}, src.value.substr(dash + 1), src.column + dash + 1});
+
+    if (type == "ramp") {
+        auto it = factory.find_ramp_by_id(id);
+        if (it != factory.ramp_cend()) {
+            links.add(it->receiver_preferences_, receiver, weight);
+            return;
+        }
+    } else if (type == "worker") {
+        auto it = factory.find_worker_by_id(id);
+        if (it != factory.worker_cend()) {
+            links.add(it->receiver_preferences_, receiver, weight);
+            return;
+        }
+    } else {
+        line.fail_at(src, "Invalid LINK source type");
+    }
+    line.fail_at(src, "Invalid LINK source");
+}
+
+void parse_element(Factory& factory, const LineParser& line, PendingLinks& links) {
+    const std::string_view type = line.type();
+
+    if (type == "LOADING_RAMP") {
+        const auto id = line.number<ElementID>(line.require("id"));
+        const Token& interval = line.require("delivery-interval");
+        const auto di = line.number<TimeOffset>(interval);
+        if (di <= 0) {
+            line.fail_at(interval, "Delivery interval must be positive");
+        }
+
+        // Partia paczek na dostawę (domyślnie jedna).
+        std::size_t batch_size = 1;
+        if (const Token* batch = line.find("batch-size")) {
+            batch_size = line.number<std::size_t>(*batch);
+            if (batch_size == 0) {
+                line.fail_at(*batch, "Batch size must be positive");
+            }
+        }
+        factory.add_ramp(Ramp(id, di, batch_size));
+    } else if (type == "WORKER") {
+        const auto id = line.number<ElementID>(line.require("id"));
+        const Token& processing_time = line.require("processing-time");
+        const auto pd = line.number<TimeOffset>(processing_time);
+        if (pd <= 0) {
+            line.fail_at(processing_time, "Processing time must be positive");
+        }
+
+        // Domyślny typ kolejki to FIFO; można go nadpisać parametrem "queue-type".
+        PackageQueueType queue_type = PackageQueueType::FIFO;
+        if (const Token* qt = line.find("queue-type")) {
+            if (qt->value == "FIFO") {
+                queue_type = PackageQueueType::FIFO;
+            } else if (qt->value == "LIFO") {
+                queue_type = PackageQueueType::LIFO;
+            } else {
+                line.fail_at(*qt, "Unknown queue-type");
+            }
+        }
+        factory.add_worker(Worker(id, pd, make_package_queue(queue_type, factory.get_resources().packages)));
+    } else if (type == "STOREHOUSE") {
+        const auto id = line.number<ElementID>(line.require("id"));
+
+        // Domyślnie magazyn przechowuje wszystkie paczki; "stock=aggregate"
+        // zostawia tylko liczniki (i ostatnie "keep-last" paczek).
+        std::pmr::memory_resource* packages = factory.get_resources().packages;
+        const Token* stock = line.find("stock");
+        if (stock == nullptr || stock->value == "queue") {
+            factory.add_storehouse(Storehouse(id, make_package_queue(PackageQueueType::FIFO, packages)));
+        } else if (stock->value == "aggregate") {
+            std::size_t keep_last = 0;
+            if (const Token* keep = line.find("keep-last")) {
+                keep_last = line.number<std::size_t>(*keep);
+            }
+            factory.add_storehouse(Storehouse(id, make_stockpile<AggregateStockpile>(packages, keep_last, packages)));
+        } else {
+            line.fail_at(*stock, "Unknown stock type");
+        }
+    } else if (type == "LINK") {
+        add_link(factory, line, links);
+    } else {
+        line.fail(line.type_column() - 1, "Unknown element type");
+    }
+}
+
+} // unnamed namespace
+
+Factory parse_factory_structure(std::string_view text, const FactoryResources& resources) {
+    Factory factory(resources);
+    std::size_t line_number = 0;
+    std::vector<Token> tokens;
+    PendingLinks links;
+
+    while (!text.empty()) {
+        ++line_number;
+        const std::size_t eol = text.find('\n');
+        const std::string_view line_text = text.substr(0, eol);
+        text.remove_prefix(eol == std::string_view::npos ? text.size() : eol + 1);
+
+        LineParser line(line_text, line_number, tokens);
+        if (!line.tokenize()) {
+            continue;
+        }
+        try {
+            parse_element(factory, line, links);
+        } catch (const FactoryParseError&) {
+            throw;
+        } catch (const std::logic_error& e) {
+            // np. powtórzone ID węzła
+            throw FactoryParseError(line_number, line.type_column(), e.what());
+        }
+    }
+    links.flush();
+
+    return factory;
+}
+
+Factory load_factory_structure_file(const std::string& path, const FactoryResources& resources) {
+    MappedFile file(path);
+    return parse_factory_structure(file.view(), resources);
+}
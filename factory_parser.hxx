@@ -0,0 +1,38 @@
+#pragma once
+#ifndef FACTORY_PARSER_HXX
+#define FACTORY_PARSER_HXX
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "factory_memory.hxx"
+
+class Factory;
+
+// Błąd w pliku struktury fabryki – z numerem linii i kolumny (od 1).
+class FactoryParseError : public std::logic_error {
+public:
+    FactoryParseError(std::size_t line, std::size_t column, const std::string& message);
+
+    std::size_t line() const { return line_; }
+    std::size_t column() const { return column_; }
+
+private:
+    std::size_t line_;
+    std::size_t column_;
+};
+
+// Jednoprzebiegowy parser struktury fabryki.
+//
+// The text is tokenized in place (std::string_view, std::from_chars) without
+// per-line allocations; LINK endpoints are resolved through the factories'
+// ID index. Syntax errors are reported as FactoryParseError. The factory
+// is built on `resources` (factory_memory.hxx).
+Factory parse_factory_structure(std::string_view text, const FactoryResources& resources = {});
+
+// Memory-maps the file (see MappedFile) and parses it.
+Factory load_factory_structure_file(const std::string& path, const FactoryResources& resources = {});
+
+#endif // FACTORY_PARSER_HXX
@@ -1,10 +1,16 @@
 #include "helpers.hxx"
 #include "factory.hxx"
 #include "types.hxx"
+#include "counter_rng.hxx"
+#include "factory_parser.hxx"
+#include "simulation_context.hxx"
 
+#include <charconv>
 #include <cstdlib>
+#include <limits>
 #include <random>
 #include <functional>
+#include <iterator>
 #include <stdexcept>
 #include <sstream>
 #include <stdexcept>
@@ -16,27 +22,6 @@ static const std::map<std::string, ElementType> element_map {
         {"LINK", ElementType::LINK}
 };
 
-namespace {
-
-struct ParsedEndpoint {
-    std::string type;
-    ElementID id;
-};
-
-ParsedEndpoint parse_endpoint(const std::string& value) {
-    auto dash_pos = value.find('-');
-    if (dash_pos == std::string::npos || dash_pos == 0 || dash_pos + 1 >= value.size()) {
-        throw std::logic_error("Invalid endpoint format (expected type-id)");
-    }
-
-    ParsedEndpoint ep;
-    ep.type = value.substr(0, dash_pos);
-    ep.id = static_cast<ElementID>(std::stoi(value.substr(dash_pos + 1)));
-    return ep;
-}
-
-} // unnamed namespace
-
 ParsedLineData parse_line(const std::string& line) {
     std::istringstream ss(line);
     std::string type_str;
@@ -63,106 +48,27 @@ ParsedLineData parse_line(const std::string& line) {
     return data;
 }
 
-Factory load_factory_structure(std::istream& is) {
-    Factory factory;
-    std::string line;
-
-    while (std::getline(is, line)) {
-        if (line.empty() || line[0] == '#' || line[0] == ';')
-            continue;
-
-        auto data = parse_line(line);
-
-        switch (data.element_type) {
-        case ElementType::RAMP: {
-                ElementID id = std::stoi(data.params.at("id"));
-                Time t = std::stoi(data.params.at("delivery-interval"));
-                factory.add_ramp(Ramp{id, t});
-                break;
-            }
-            case ElementType::WORKER: {
-                ElementID id = std::stoi(data.params.at("id"));
-                Time t = std::stoi(data.params.at("processing-time"));
-
-                // Domyślny typ kolejki to FIFO; można go nadpisać parametrem "queue-type".
-                PackageQueueType queue_type = PackageQueueType::FIFO;
-                auto qt_it = data.params.find("queue-type");
-                if (qt_it != data.params.end()) {
-                    if (qt_it->second == "FIFO") {
-                        queue_type = PackageQueueType::FIFO;
-                    } else if (qt_it->second == "LIFO") {
-                        queue_type = PackageQueueType::LIFO;
-                    } else {
-                        throw std::logic_error("Unknown queue-type");
-                    }
-                }
-
-                factory.add_worker(
-                    Worker(id, t, std::make_unique<PackageQueue>(queue_type))
-                );
-                break;
-            }
-            case ElementType::STOREHOUSE: {
-                ElementID id = std::stoi(data.params.at("id"));
-                factory.add_storehouse(Storehouse{id});
-                break;
-            }
-            case ElementType::LINK: {
-                // src and dest are in the format type-id, e.g. ramp-1, worker-2, store-1
-                ParsedEndpoint src_ep = parse_endpoint(data.params.at("src"));
-                ParsedEndpoint dest_ep = parse_endpoint(data.params.at("dest"));
-
-                IPackageReceiver* receiver = nullptr;
-
-                if (dest_ep.type == "worker") {
-                    auto w_it = factory.find_worker_by_id(dest_ep.id);
-                    if (w_it != factory.worker_cend()) {
-                        receiver = &(*w_it);
-                    }
-                } else if (dest_ep.type == "store") {
-                    auto s_it = factory.find_storehouse_by_id(dest_ep.id);
-                    if (s_it != factory.storehouse_cend()) {
-                        receiver = &(*s_it);
-                    }
-                } else {
-                    throw std::logic_error("Invalid LINK destination type");
-                }
-
-                if (receiver == nullptr) {
-                    throw std::logic_error("Invalid LINK destination");
-                }
-
-                // Source must be a sender: ramp or worker
-                if (src_ep.type == "ramp") {
-                    auto r_it = factory.find_ramp_by_id(src_ep.id);
-                    if (r_it != factory.ramp_cend()) {
-                        r_it->add_receiver(receiver);
-                        break;
-                    }
-                } else if (src_ep.type == "worker") {
-                    auto wsrc_it = factory.find_worker_by_id(src_ep.id);
-                    if (wsrc_it != factory.worker_cend()) {
-                        wsrc_it->add_receiver(receiver);
-                        break;
-                    }
-                } else {
-                    throw std::logic_error("Invalid LINK source type");
-                }
-
-                throw std::logic_error("Invalid LINK source");
-            }
-
-        }
-    }
+Factory load_factory_structure(std::istream& is, const FactoryResources& resources) {
+    const std::string text{std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>()};
+    return parse_factory_structure(text, resources);
+}
 
-    return factory;
+// Najkrótszy zapis wagi, który wczytuje się do tej samej wartości.
+static void write_weight(std::ostream& os, double weight) {
+    char digits[32];
+    const auto r = std::to_chars(digits, digits + sizeof(digits), weight);
+    os << " weight=";
+    os.write(digits, r.ptr - digits);
 }
 
 void save_factory_structure(const Factory& factory, std::ostream& os) {
     for (auto it = factory.ramp_cbegin(); it != factory.ramp_cend(); ++it) {
         os << "LOADING_RAMP id=" << it->get_id()
-           << " delivery-interval=" << it->get_delivery_interval()
-           << "\n";
+           << " delivery-interval=" << it->get_delivery_interval();
+        if (it->get_batch_size() != 1) {
+            os << " batch-size=" << it->get_batch_size();
+        }
+        os << "\n";
     }
 
     for (auto it = factory.worker_cbegin(); it != factory.worker_cend(); ++it) {
@@ -173,47 +79,143 @@ void save_factory_structure(const Factory& factory, std::ostream& os) {
     }
 
     for (auto it = factory.storehouse_cbegin(); it != factory.storehouse_cend(); ++it) {
-        os << "STOREHOUSE id=" << it->get_id() << "\n";
+        os << "STOREHOUSE id=" << it->get_id();
+        if (const auto* aggregate = dynamic_cast<const AggregateStockpile*>(&it->get_stock())) {
+            os << " stock=aggregate";
+            if (aggregate->keep_last() > 0) {
+                os << " keep-last=" << aggregate->keep_last();
+            }
+        }
+        os << "\n";
     }
 
     os.flush();
 
     // Save LINKS using typed endpoints: ramp-<id>, worker-<id>, store-<id>
     for (auto it = factory.ramp_cbegin(); it != factory.ramp_cend(); ++it) {
-        for (const auto& [receiver, _] : it->receiver_preferences_) {
+        const auto& prefs = it->receiver_preferences_;
+        for (std::size_t i = 0; i < prefs.size(); ++i) {
+            const IPackageReceiver* receiver = prefs.get_preferences()[i].first;
             std::string dest_type =
                 (receiver->get_receiver_type() == ReceiverType::STOREHOUSE) ? "store" : "worker";
             os << "LINK src=ramp-" << it->get_id()
-               << " dest=" << dest_type << "-" << receiver->get_id()
-               << "\n";
+               << " dest=" << dest_type << "-" << receiver->get_id();
+            const double weight = prefs.weight(i);
+            if (weight != 1.0) {
+                write_weight(os, weight);
+            }
+            os << "\n";
         }
     }
 
     for (auto it = factory.worker_cbegin(); it != factory.worker_cend(); ++it) {
-        for (const auto& [receiver, _] : it->receiver_preferences_) {
+        const auto& prefs = it->receiver_preferences_;
+        for (std::size_t i = 0; i < prefs.size(); ++i) {
+            const IPackageReceiver* receiver = prefs.get_preferences()[i].first;
             std::string dest_type =
                 (receiver->get_receiver_type() == ReceiverType::STOREHOUSE) ? "store" : "worker";
             os << "LINK src=worker-" << it->get_id()
-               << " dest=" << dest_type << "-" << receiver->get_id()
-               << "\n";
+               << " dest=" << dest_type << "-" << receiver->get_id();
+            const double weight = prefs.weight(i);
+            if (weight != 1.0) {
+                write_weight(os, weight);
+            }
+            os << "\n";
         }
     }
 }
 
 
+Factory copy_factory_structure(const Factory& factory, const FactoryResources& resources) {
+    Factory copy(resources);
+
+    for (auto it = factory.ramp_cbegin(); it != factory.ramp_cend(); ++it) {
+        copy.add_ramp(Ramp(it->get_id(), it->get_delivery_interval(), it->get_batch_size()));
+    }
+    for (auto it = factory.worker_cbegin(); it != factory.worker_cend(); ++it) {
+        copy.add_worker(Worker(it->get_id(), it->get_processing_duration(),
+                               make_package_queue(it->get_queue_type(), resources.packages)));
+    }
+    for (auto it = factory.storehouse_cbegin(); it != factory.storehouse_cend(); ++it) {
+        if (const auto* aggregate = dynamic_cast<const AggregateStockpile*>(&it->get_stock())) {
+            copy.add_storehouse(Storehouse(it->get_id(), make_stockpile<AggregateStockpile>(
+                resources.packages, aggregate->keep_last(), resources.packages)));
+        } else {
+            copy.add_storehouse(
+                Storehouse(it->get_id(), make_package_queue(PackageQueueType::FIFO, resources.packages)));
+        }
+    }
+
+    // Odbiorcy w kopii – ten sam typ i ID co w oryginale.
+    auto copied_receiver = [&copy](const IPackageReceiver* receiver) -> IPackageReceiver* {
+        if (receiver->get_receiver_type() == ReceiverType::STOREHOUSE) {
+            return &(*copy.find_storehouse_by_id(receiver->get_id()));
+        }
+        return &(*copy.find_worker_by_id(receiver->get_id()));
+    };
+
+    // Wszyscy odbiorcy nadawcy naraz (O(fan-out)).
+    std::vector<ReceiverPreferences::receiver_weight_t> links;
+    auto copy_links = [&](const ReceiverPreferences& from, ReceiverPreferences& to) {
+        links.clear();
+        const auto& receivers = from.get_preferences();
+        for (std::size_t i = 0; i < receivers.size(); ++i) {
+            links.emplace_back(copied_receiver(receivers[i].first), from.weight(i));
+        }
+        to.add_receivers(links);
+    };
+    for (auto it = factory.ramp_cbegin(); it != factory.ramp_cend(); ++it) {
+        copy_links(it->receiver_preferences_, copy.find_ramp_by_id(it->get_id())->receiver_preferences_);
+    }
+    for (auto it = factory.worker_cbegin(); it != factory.worker_cend(); ++it) {
+        copy_links(it->receiver_preferences_, copy.find_worker_by_id(it->get_id())->receiver_preferences_);
+    }
+
+    return copy;
+}
+
 // Do generowania wysokiej jakości ciągów liczb pseudolosowych warto użyć
 // zaawansowanych generatorów, np. algorytmu Mersenne Twister.
 // zob. https://en.cppreference.com/w/cpp/numeric/random
 std::random_device rd;
-std::mt19937 rng(rd());
+std::mt19937& rng = SimulationContext::default_context().rng();
 
 double default_probability_generator() {
-    // Generuj liczby pseudolosowe z przedziału [0, 1); 10 bitów losowości.
-    return std::generate_canonical<double, 10>(rng);
+    // Generuj liczby pseudolosowe z przedziału [0, 1) z pełną precyzją double.
+    // Generator należy do aktywnego kontekstu symulacji (osobny dla każdej fabryki).
+    return std::generate_canonical<double, std::numeric_limits<double>::digits>(
+        SimulationContext::current().rng());
 }
 
 std::function<double()> probability_generator = default_probability_generator;
 
+ProbabilityGenerator counter_probability_generator(
+    std::uint64_t seed,
+    ElementType sender_type,
+    ElementID sender_id
+) {
+    const bool is_ramp = (sender_type == ElementType::RAMP);
+    return [seed, is_ramp, sender_id, turn = Time{0}, draw = std::uint32_t{0}]() mutable {
+        const Time now = SimulationContext::current().current_turn();
+        if (now != turn) {
+            turn = now;
+            draw = 0;
+        }
+        return counter_probability(seed, is_ramp, sender_id, now, draw++);
+    };
+}
+
+void use_counter_probability_generators(Factory& factory, std::uint64_t seed) {
+    for (const auto& r : factory.get_ramps()) {
+        factory.find_ramp_by_id(r.get_id())->receiver_preferences_.set_probability_generator(
+            counter_probability_generator(seed, ElementType::RAMP, r.get_id()));
+    }
+    for (const auto& w : factory.get_workers()) {
+        factory.find_worker_by_id(w.get_id())->receiver_preferences_.set_probability_generator(
+            counter_probability_generator(seed, ElementType::WORKER, w.get_id()));
+    }
+}
+
 // ===== SpecificTurnsReportNotifier =====
 
 SpecificTurnsReportNotifier::SpecificTurnsReportNotifier(
@@ -224,6 +226,11 @@ bool SpecificTurnsReportNotifier::should_generate_report(Time t) const {
     return turns_.find(t) != turns_.end();
 }
 
+Time SpecificTurnsReportNotifier::next_report_turn(Time t) const {
+    auto it = turns_.lower_bound(t);
+    return it != turns_.end() ? *it : std::numeric_limits<Time>::max();
+}
+
 // ===== IntervalReportNotifier =====
 
 IntervalReportNotifier::IntervalReportNotifier(TimeOffset interval)
@@ -233,18 +240,36 @@ bool IntervalReportNotifier::should_generate_report(Time t) const {
     return (t - 1) % interval_ == 0;
 }
 
+Time IntervalReportNotifier::next_report_turn(Time t) const {
+    // Reports are generated in turns 1 + k * interval.
+    const Time k = (t - 1 + interval_ - 1) / interval_;
+    return 1 + k * interval_;
+}
+
 // ===== simulate() =====
 
 void simulate(
     Factory& factory,
     TimeOffset duration,
     std::function<void(Factory&, Time)> report_function
+) {
+    simulate_from(factory, 1, duration, std::move(report_function));
+}
+
+void simulate_from(
+    Factory& factory,
+    Time first_turn,
+    TimeOffset duration,
+    std::function<void(Factory&, Time)> report_function
 ) {
     if (!factory.is_consistent()) {
         throw std::logic_error("Factory network is inconsistent");
     }
 
-    for (Time t = 1; t <= duration; ++t) {
+    SimulationContext::Scope scope(factory.get_context());
+
+    for (Time t = first_turn; t <= duration; ++t) {
+        factory.get_context().set_current_turn(t);
         factory.do_deliveries(t);
         factory.do_package_passing();
         factory.do_work(t);
@@ -253,3 +278,13 @@ void simulate(
     }
 }
 
+void simulate(
+    Factory& factory,
+    TimeOffset duration,
+    std::function<void(Factory&, Time)> report_function,
+    std::uint64_t seed
+) {
+    use_counter_probability_generators(factory, seed);
+    factory.get_context().seed(seed);
+    simulate(factory, duration, std::move(report_function));
+}
@@ -1,6 +1,7 @@
 #ifndef HELPERS_HPP_
 #define HELPERS_HPP_
 
+#include <cstdint>
 #include <functional>
 #include <random>
 #include <map>
@@ -9,6 +10,7 @@
 #include <iosfwd>
 
 #include "types.hxx"
+#include "factory_memory.hxx"
 
 class Factory;
 
@@ -26,26 +28,71 @@ struct ParsedLineData {
 
 ParsedLineData parse_line(const std::string& line);
 
-Factory load_factory_structure(std::istream& is);
+// Reads the whole stream and parses it with parse_factory_structure()
+// (factory_parser.hxx); errors are reported as FactoryParseError.
+Factory load_factory_structure(std::istream& is, const FactoryResources& resources = {});
 void save_factory_structure(const Factory& factory, std::ostream& os);
 
+// Copy of the factory's structure (nodes, links and weights) with empty
+// queues and buffers and a fresh simulation context. Senders use the current
+// global probability_generator. The copy is built on `resources` (not on
+// the original's).
+Factory copy_factory_structure(const Factory& factory, const FactoryResources& resources = {});
+
 extern std::random_device rd;
-extern std::mt19937 rng;
+// Generator of the default simulation context (used outside of simulate()).
+extern std::mt19937& rng;
 
 extern double default_probability_generator();
 
 extern ProbabilityGenerator probability_generator;
 
+// Generator licznikowy dla nadawcy (RAMP lub WORKER) o danym ID.
+//
+// The n-th number drawn in turn t is counter_probability(seed, sender, t, n),
+// with t taken from the active simulation context. The generator has no
+// shared state, so every routing decision can be recomputed independently
+// of the others (also on another thread).
+ProbabilityGenerator counter_probability_generator(
+    std::uint64_t seed,
+    ElementType sender_type,
+    ElementID sender_id
+);
+
+// Installs counter_probability_generator(seed, ...) in every ramp and worker.
+void use_counter_probability_generators(Factory& factory, std::uint64_t seed);
+
 void simulate(
     Factory& factory,
     TimeOffset duration,
     std::function<void(Factory&, Time)> report_function
 );
 
+// Turns first_turn .. duration of a simulation, e.g. resuming after a
+// checkpoint taken after turn first_turn - 1 (checkpoint.hxx).
+void simulate_from(
+    Factory& factory,
+    Time first_turn,
+    TimeOffset duration,
+    std::function<void(Factory&, Time)> report_function
+);
+
+// Reproducible simulation: routing uses counter-based generators keyed by
+// the seed (they stay installed in the factory afterwards) and the context's
+// generator is seeded as well.
+void simulate(
+    Factory& factory,
+    TimeOffset duration,
+    std::function<void(Factory&, Time)> report_function,
+    std::uint64_t seed
+);
+
 class SpecificTurnsReportNotifier {
 public:
     explicit SpecificTurnsReportNotifier(const std::set<Time>& turns);
     bool should_generate_report(Time t) const;
+    // Smallest report turn >= t (maximum Time value if there is none).
+    Time next_report_turn(Time t) const;
 
 private:
     std::set<Time> turns_;
@@ -55,6 +102,8 @@ class IntervalReportNotifier {
 public:
     explicit IntervalReportNotifier(TimeOffset interval);
     bool should_generate_report(Time t) const;
+    // Smallest report turn >= t.
+    Time next_report_turn(Time t) const;
 
 private:
     TimeOffset interval_;
@@ -0,0 +1,85 @@
+#include "id_index.hxx"
+
+#include <cstdint>
+
+std::size_t IdIndex::home_bucket(ElementID id) const {
+    // Fibonacci hashing - spreads consecutive IDs over the whole table.
+    const auto h = static_cast<std::uint64_t>(static_cast<std::uint32_t>(id)) * 0x9E3779B97F4A7C15ULL;
+    return static_cast<std::size_t>(h >> 32) & (buckets_.size() - 1);
+}
+
+std::size_t IdIndex::find(ElementID id) const {
+    if (buckets_.empty()) {
+        return npos;
+    }
+    const std::size_t mask = buckets_.size() - 1;
+    for (std::size_t b = home_bucket(id);; b = (b + 1) & mask) {
+        const Entry& e = buckets_[b];
+        if (e.slot == npos) {
+            return npos;
+        }
+        if (e.id == id) {
+            return e.slot;
+        }
+    }
+}
+
+void IdIndex::assign(ElementID id, std::size_t slot) {
+    // Keep the load factor at or below 1/2.
+    if ((size_ + 1) * 2 > buckets_.size()) {
+        rehash(buckets_.empty() ? 16 : buckets_.size() * 2);
+    }
+    const std::size_t mask = buckets_.size() - 1;
+    for (std::size_t b = home_bucket(id);; b = (b + 1) & mask) {
+        Entry& e = buckets_[b];
+        if (e.slot == npos) {
+            e.id = id;
+            e.slot = slot;
+            ++size_;
+            return;
+        }
+        if (e.id == id) {
+            e.slot = slot;
+            return;
+        }
+    }
+}
+
+void IdIndex::erase(ElementID id) {
+    if (buckets_.empty()) {
+        return;
+    }
+    const std::size_t mask = buckets_.size() - 1;
+    std::size_t hole = home_bucket(id);
+    while (buckets_[hole].slot != npos && buckets_[hole].id != id) {
+        hole = (hole + 1) & mask;
+    }
+    if (buckets_[hole].slot == npos) {
+        return;
+    }
+
+    // Shift following entries of the probe run back into the hole, so that
+    // lookups never need tombstones.
+    for (std::size_t b = (hole + 1) & mask; buckets_[b].slot != npos; b = (b + 1) & mask) {
+        const std::size_t home = home_bucket(buckets_[b].id);
+        const bool movable = (hole <= b) ? (home <= hole || home > b)
+                                         : (home <= hole && home > b);
+        if (movable) {
+            buckets_[hole] = buckets_[b];
+            hole = b;
+        }
+    }
+    buckets_[hole] = Entry{};
+    --size_;
+}
+
+void IdIndex::rehash(std::size_t bucket_count) {
+    std::pmr::vector<Entry> old(bucket_count, buckets_.get_allocator());
+    old.swap(buckets_);
+    size_ = 0;
+    for (const Entry& e : old) {
+        if (e.slot != npos) {
+            assign(e.id, e.slot);
+        }
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+#ifndef ID_INDEX_HXX
+#define ID_INDEX_HXX
+
+#include "types.hxx"
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+// Open-addressing hash map ElementID -> slot number (linear probing with
+// backward-shift deletion), used by NodeCollection for O(1) lookups.
+class IdIndex {
+public:
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    IdIndex() = default;
+    explicit IdIndex(std::pmr::memory_resource* resource) : buckets_(resource) {}
+
+    // Slot stored for the ID or npos.
+    std::size_t find(ElementID id) const;
+
+    // Inserts the ID or overwrites its slot.
+    void assign(ElementID id, std::size_t slot);
+
+    void erase(ElementID id);
+
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+private:
+    struct Entry {
+        ElementID id = 0;
+        std::size_t slot = npos;    // npos = empty bucket
+    };
+
+    std::pmr::vector<Entry> buckets_;
+    std::size_t size_ = 0;
+
+    std::size_t home_bucket(ElementID id) const;
+    void rehash(std::size_t bucket_count);
+};
+
+#endif // ID_INDEX_HXX
@@ -0,0 +1,117 @@
+#include "id_pool.hxx"
+
+#include <bit>
+#include <stdexcept>
+
+IdPool::IdPool() {
+    // ID 0 is never handed out - packages are numbered from 1.
+    mark_used(0);
+}
+
+ElementID IdPool::acquire() {
+    // Descend from the summary level towards the leaves, each time picking
+    // the first word that still has a free bit. Words past the end of a level
+    // do not exist yet and are treated as empty.
+    std::size_t index = 0;
+    for (std::size_t level = levels_.size(); level-- > 0;) {
+        const auto& words = levels_[level];
+        std::size_t word = index;
+
+        if (level + 1 == levels_.size()) {
+            word = 0;
+            while (word < words.size() && words[word] == ~word_t{0}) {
+                ++word;
+            }
+        }
+
+        const word_t bits = (word < words.size()) ? words[word] : 0;
+        index = word * word_bits + static_cast<std::size_t>(std::countr_one(bits));
+    }
+
+    mark_used(index);
+    ++size_;
+    return static_cast<ElementID>(index);
+}
+
+void IdPool::reserve(ElementID id) {
+    if (id < 1 || id > max_reserved_id) {
+        throw std::invalid_argument("Package ID out of range");
+    }
+    if (is_used(id)) {
+        throw std::invalid_argument("Package ID already in use");
+    }
+    mark_used(static_cast<std::size_t>(id));
+    ++size_;
+}
+
+void IdPool::release(ElementID id) {
+    if (id < 1 || !is_used(id)) {
+        return;
+    }
+
+    // Clear the leaf bit; a word which stops being full clears its bit
+    // one level up, and so on.
+    std::size_t index = static_cast<std::size_t>(id);
+    for (auto& words : levels_) {
+        word_t& word = words[index / word_bits];
+        const bool was_full = (word == ~word_t{0});
+        word &= ~(word_t{1} << (index % word_bits));
+        if (!was_full) {
+            break;
+        }
+        index /= word_bits;
+    }
+    --size_;
+}
+
+bool IdPool::is_used(ElementID id) const {
+    if (id < 0 || levels_.empty()) {
+        return false;
+    }
+    const std::size_t index = static_cast<std::size_t>(id);
+    const auto& leaves = levels_.front();
+    if (index / word_bits >= leaves.size()) {
+        return false;
+    }
+    return (leaves[index / word_bits] >> (index % word_bits)) & word_t{1};
+}
+
+void IdPool::ensure_capacity(std::size_t index) {
+    std::size_t needed = index / word_bits + 1;
+    if (!levels_.empty() && levels_.front().size() >= needed) {
+        return;
+    }
+
+    // New words are empty, so existing summary bits stay valid; only a newly
+    // added summary level has to be filled from the level below.
+    std::size_t level = 0;
+    do {
+        if (level == levels_.size()) {
+            levels_.emplace_back(needed, 0);
+            for (std::size_t w = 0; level > 0 && w < levels_[level - 1].size(); ++w) {
+                if (levels_[level - 1][w] == ~word_t{0}) {
+                    levels_[level][w / word_bits] |= word_t{1} << (w % word_bits);
+                }
+            }
+        }
+        if (levels_[level].size() < needed) {
+            levels_[level].resize(needed, 0);
+        }
+        needed = (needed + word_bits - 1) / word_bits;
+        ++level;
+    } while (levels_[level - 1].size() > 1);
+}
+
+void IdPool::mark_used(std::size_t index) {
+    ensure_capacity(index);
+
+    // Set the leaf bit; a word which becomes full sets its bit one level up.
+    for (auto& words : levels_) {
+        word_t& word = words[index / word_bits];
+        word |= word_t{1} << (index % word_bits);
+        if (word != ~word_t{0}) {
+            break;
+        }
+        index /= word_bits;
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+#ifndef ID_POOL_HXX
+#define ID_POOL_HXX
+
+#include "types.hxx"
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// Allocator of package IDs which always hands out the lowest free ID (>= 1).
+//
+// IDs are kept in a hierarchical bitmap: levels_[0] holds one bit per ID
+// (set = in use), levels_[k] holds one bit per word of levels_[k - 1]
+// (set = that word is full). Acquire and release touch one word per level,
+// i.e. O(log64 n) - at most four words for a million live packages.
+class IdPool {
+public:
+    // Largest ID accepted by reserve(); keeps the bitmap of restored IDs
+    // within 8 MB. acquire() is not limited by it.
+    static constexpr ElementID max_reserved_id = (ElementID{1} << 26) - 1;
+
+    IdPool();
+
+    // Returns the lowest free ID and marks it as used.
+    ElementID acquire();
+
+    // Marks an explicitly chosen ID as used. Throws std::invalid_argument
+    // for IDs outside [1, max_reserved_id] and for IDs already in use.
+    void reserve(ElementID id);
+
+    // Returns the ID to the pool; unknown or free IDs are ignored.
+    void release(ElementID id);
+
+    bool is_used(ElementID id) const;
+
+    // Number of IDs currently in use.
+    std::size_t size() const { return size_; }
+
+private:
+    using word_t = std::uint64_t;
+    static constexpr std::size_t word_bits = 64;
+
+    std::vector<std::vector<word_t>> levels_;
+    std::size_t size_ = 0;
+
+    void ensure_capacity(std::size_t index);
+    void mark_used(std::size_t index);
+};
+
+#endif // ID_POOL_HXX
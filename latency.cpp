@@ -0,0 +1,100 @@
+#include "latency.hxx"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <stdexcept>
+
+LatencyHistogram::LatencyHistogram(unsigned precision_bits) : bits_(precision_bits) {
+    if (precision_bits < 1 || precision_bits > 20) {
+        throw std::invalid_argument("Histogram precision must be between 1 and 20 bits");
+    }
+}
+
+// Indeksy 0 .. 2^b - 1: wartości dokładne. Dalej, dla wartości o szerokości
+// b + k bitów (k >= 1), połowa 2^b kubełków na każdą potęgę dwójki:
+// mantysa v >> k leży w [2^(b-1), 2^b).
+std::size_t LatencyHistogram::index_of(std::uint64_t value) const {
+    const std::uint64_t exact = std::uint64_t{1} << bits_;
+    if (value < exact) {
+        return static_cast<std::size_t>(value);
+    }
+    const unsigned shift = static_cast<unsigned>(std::bit_width(value)) - bits_;
+    const std::uint64_t half = exact >> 1;
+    return static_cast<std::size_t>(exact + (shift - 1) * half + ((value >> shift) - half));
+}
+
+std::uint64_t LatencyHistogram::highest_equivalent(std::size_t index) const {
+    const std::uint64_t exact = std::uint64_t{1} << bits_;
+    if (index < exact) {
+        return index;
+    }
+    const std::uint64_t half = exact >> 1;
+    const std::uint64_t shift = (index - exact) / half + 1;
+    const std::uint64_t mantissa = half + (index - exact) % half;
+    return ((mantissa + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(std::uint64_t value, std::uint64_t count) {
+    if (count == 0) {
+        return;
+    }
+    const std::size_t i = index_of(value);
+    if (i >= counts_.size()) {
+        counts_.resize(i + 1, 0);
+    }
+    counts_[i] += count;
+    min_ = total_ ? std::min(min_, value) : value;
+    max_ = std::max(max_, value);
+    total_ += count;
+    sum_ += static_cast<double>(value) * static_cast<double>(count);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    if (other.bits_ != bits_) {
+        throw std::invalid_argument("Cannot merge histograms of different precision");
+    }
+    if (other.total_ == 0) {
+        return;
+    }
+    if (other.counts_.size() > counts_.size()) {
+        counts_.resize(other.counts_.size(), 0);
+    }
+    for (std::size_t i = 0; i < other.counts_.size(); ++i) {
+        counts_[i] += other.counts_[i];
+    }
+    min_ = total_ ? std::min(min_, other.min_) : other.min_;
+    max_ = std::max(max_, other.max_);
+    total_ += other.total_;
+    sum_ += other.sum_;
+}
+
+void LatencyHistogram::clear() {
+    counts_.clear();
+    total_ = 0;
+    min_ = 0;
+    max_ = 0;
+    sum_ = 0.0;
+}
+
+double LatencyHistogram::mean() const {
+    return total_ ? sum_ / static_cast<double>(total_) : 0.0;
+}
+
+std::uint64_t LatencyHistogram::value_at_percentile(double percentile) const {
+    if (total_ == 0) {
+        return 0;
+    }
+    const double clamped = std::clamp(percentile, 0.0, 100.0);
+    const auto rank = std::max<std::uint64_t>(
+        1, static_cast<std::uint64_t>(std::ceil(clamped * static_cast<double>(total_) / 100.0)));
+
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < counts_.size(); ++i) {
+        seen += counts_[i];
+        if (seen >= rank) {
+            return std::min(highest_equivalent(i), max_);
+        }
+    }
+    return max_;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#ifndef LATENCY_HXX
+#define LATENCY_HXX
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Histogram opóźnień w stylu HDR.
+//
+// Values below 2^precision_bits are counted exactly; larger ones go to
+// log-linear buckets (2^(precision_bits - 1) per power of two), so every
+// reported value is within a relative error of 2^(1 - precision_bits) of
+// the recorded one (under 1.6% for the default 7 bits). Memory grows with
+// the logarithm of the largest value, not with the number of samples.
+class LatencyHistogram {
+public:
+    explicit LatencyHistogram(unsigned precision_bits = 7);
+
+    void record(std::uint64_t value, std::uint64_t count = 1);
+    // Both histograms must have the same precision.
+    void merge(const LatencyHistogram& other);
+    void clear();
+
+    std::uint64_t count() const { return total_; }
+    std::uint64_t min() const { return total_ ? min_ : 0; }
+    std::uint64_t max() const { return max_; }
+    double mean() const;
+
+    // Smallest bucket value (capped at max()) with at least `percentile`
+    // percent of the samples at or below it; 0 when empty.
+    std::uint64_t value_at_percentile(double percentile) const;
+
+    unsigned precision_bits() const { return bits_; }
+
+    friend bool operator==(const LatencyHistogram&, const LatencyHistogram&) = default;
+
+private:
+    unsigned bits_;
+    std::vector<std::uint64_t> counts_;
+    std::uint64_t total_ = 0;
+    std::uint64_t min_ = 0;
+    std::uint64_t max_ = 0;
+    double sum_ = 0.0;
+
+    std::size_t index_of(std::uint64_t value) const;
+    std::uint64_t highest_equivalent(std::size_t index) const;
+};
+
+#endif // LATENCY_HXX
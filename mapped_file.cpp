@@ -0,0 +1,55 @@
+#include "mapped_file.hxx"
+
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define NETSIM_HAVE_MMAP 1
+#endif
+
+MappedFile::MappedFile(const std::string& path) {
+#ifdef NETSIM_HAVE_MMAP
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open file: " + path);
+    }
+    struct stat st {};
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Cannot read file: " + path);
+    }
+    size_ = static_cast<std::size_t>(st.st_size);
+    if (size_ > 0) {
+        void* data = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            ::close(fd);
+            throw std::runtime_error("Cannot map file: " + path);
+        }
+        data_ = static_cast<const char*>(data);
+        mapped_ = true;
+    }
+    // Mapowanie pozostaje ważne po zamknięciu deskryptora.
+    ::close(fd);
+#else
+    std::ifstream is(path, std::ios::binary);
+    if (!is) {
+        throw std::runtime_error("Cannot open file: " + path);
+    }
+    contents_.assign(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+    data_ = contents_.data();
+    size_ = contents_.size();
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifdef NETSIM_HAVE_MMAP
+    if (mapped_) {
+        ::munmap(const_cast<char*>(data_), size_);
+    }
+#endif
+}
@@ -0,0 +1,31 @@
+#pragma once
+#ifndef MAPPED_FILE_HXX
+#define MAPPED_FILE_HXX
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Plik wczytany do pamięci tylko do odczytu.
+//
+// The file is memory-mapped on POSIX systems; elsewhere its contents are
+// read into a buffer. Throws std::runtime_error when the file cannot be read.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile();
+
+    std::string_view view() const { return {data_, size_}; }
+
+private:
+    const char* data_ = nullptr;
+    std::size_t size_ = 0;
+    bool mapped_ = false;
+    std::string contents_;   // used when mapping is not available
+};
+
+#endif // MAPPED_FILE_HXX
@@ -0,0 +1,51 @@
+#include "metrics.hxx"
+
+#include "factory.hxx"
+
+MetricsSnapshot snapshot_metrics(const Factory& factory, Time t) {
+    MetricsSnapshot snapshot;
+    snapshot.turn = t;
+
+    snapshot.ramps.reserve(factory.get_ramps().size());
+    for (const auto& r : factory.get_ramps()) {
+        const SenderMetrics& sender = r.get_sender_metrics();
+        snapshot.ramps.push_back(RampMetricsSnapshot{r.get_id(), r.get_delivered_count(),
+                                                     sender.sent, sender.dropped});
+    }
+
+    snapshot.workers.reserve(factory.get_workers().size());
+    for (const auto& w : factory.get_workers()) {
+        const WorkerMetrics& metrics = w.get_metrics();
+        const SenderMetrics& sender = w.get_sender_metrics();
+        const std::uint64_t busy = metrics.busy_turns(t);
+        const std::uint64_t idle = metrics.idle_turns(t);
+        const double turns = static_cast<double>(busy + idle);
+        auto per_turn = [turns](double value) { return turns > 0 ? value / turns : 0.0; };
+
+        snapshot.workers.push_back(WorkerMetricsSnapshot{
+            w.get_id(), busy, idle,
+            per_turn(static_cast<double>(busy)),
+            per_turn(static_cast<double>(metrics.queue_length_sum(t))),
+            metrics.max_queue_length(),
+            metrics.received(),
+            metrics.processed(),
+            per_turn(static_cast<double>(metrics.processed())),
+            sender.sent, sender.dropped});
+    }
+
+    snapshot.storehouses.reserve(factory.get_storehouses().size());
+    for (const auto& s : factory.get_storehouses()) {
+        snapshot.storehouses.push_back(StorehouseMetricsSnapshot{s.get_id(), s.get_arrival_count()});
+    }
+    return snapshot;
+}
+
+#ifdef NETSIM_PACKAGE_METADATA
+LatencyHistogram factory_latency(const Factory& factory) {
+    LatencyHistogram latency;
+    for (const auto& s : factory.get_storehouses()) {
+        latency.merge(s.get_latency());
+    }
+    return latency;
+}
+#endif
@@ -0,0 +1,158 @@
+#pragma once
+#ifndef METRICS_HXX
+#define METRICS_HXX
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "latency.hxx"
+#include "types.hxx"
+
+class Factory;
+
+// Liczniki nadawcy (rampy lub robotnika).
+struct SenderMetrics {
+    std::uint64_t sent = 0;          // passed to a receiver
+    std::uint64_t dropped = 0;       // no receiver chosen (choose_receiver() == nullptr)
+};
+
+// Liczniki robotnika.
+//
+// A turn counts as busy when a package was being processed at some point
+// of it; the queue length of a turn is the length after its work phase.
+// Turns are accounted lazily: between two updates the worker's state does
+// not change, so only turns in which a package arrives, starts or finishes
+// are recorded (the common case costs a branch) and the event-driven
+// engine, which skips the other turns, yields the same values. Queries take
+// the turn up to which the totals are wanted.
+class WorkerMetrics {
+public:
+    // Packages (count of them) entered the queue in turn t; queue_length
+    // includes them.
+    void package_received(Time t, std::size_t queue_length, std::uint64_t count = 1) {
+        advance(t - 1);
+        queue_length_ = queue_length;
+        max_queue_length_ = std::max(max_queue_length_, queue_length);
+        received_ += count;
+    }
+
+    // Work phase of turn t in which a package started or finished. busy: a
+    // package was processed during the turn; processing: one is still being
+    // processed after it.
+    void turn_worked(Time t, bool busy, bool processing, std::size_t queue_length, bool finished) {
+        advance(t - 1);
+        ++(busy ? busy_turns_ : idle_turns_);
+        queue_length_sum_ += queue_length;
+        processed_ += finished;
+        last_turn_ = t;
+        processing_ = processing;
+        queue_length_ = queue_length;
+    }
+
+    std::uint64_t busy_turns(Time t) const { return busy_turns_ + (processing_ ? pending(t) : 0); }
+    std::uint64_t idle_turns(Time t) const { return idle_turns_ + (processing_ ? 0 : pending(t)); }
+    std::uint64_t queue_length_sum(Time t) const { return queue_length_sum_ + queue_length_ * pending(t); }
+
+    std::size_t max_queue_length() const { return max_queue_length_; }
+    std::uint64_t received() const { return received_; }
+    std::uint64_t processed() const { return processed_; }
+
+    // Accounts turns up to t now; queries return the same values afterwards.
+    void settle(Time t) { advance(t); }
+    // State which decides how the totals grow after the last update.
+    bool processing() const { return processing_; }
+    std::size_t queue_length() const { return queue_length_; }
+
+    // Stan okresowy: *this and `earlier` were both settled, `period` turns
+    // apart, in the same state; adds the totals of `cycles` more periods.
+    // The maximum queue length cannot grow in repeated periods.
+    void extrapolate(const WorkerMetrics& earlier, std::uint64_t cycles, TimeOffset period) {
+        busy_turns_ += cycles * (busy_turns_ - earlier.busy_turns_);
+        idle_turns_ += cycles * (idle_turns_ - earlier.idle_turns_);
+        queue_length_sum_ += cycles * (queue_length_sum_ - earlier.queue_length_sum_);
+        received_ += cycles * (received_ - earlier.received_);
+        processed_ += cycles * (processed_ - earlier.processed_);
+        last_turn_ += static_cast<Time>(cycles) * period;
+    }
+
+private:
+    friend class CheckpointCodec;
+
+    Time last_turn_ = 0;             // turns 1 .. last_turn_ are accounted
+    bool processing_ = false;
+    std::size_t queue_length_ = 0;
+    std::size_t max_queue_length_ = 0;
+    std::uint64_t busy_turns_ = 0;
+    std::uint64_t idle_turns_ = 0;
+    std::uint64_t queue_length_sum_ = 0;
+    std::uint64_t received_ = 0;
+    std::uint64_t processed_ = 0;
+
+    std::uint64_t pending(Time t) const {
+        return t > last_turn_ ? static_cast<std::uint64_t>(t - last_turn_) : 0;
+    }
+
+    void advance(Time t) {
+        const std::uint64_t n = pending(t);
+        (processing_ ? busy_turns_ : idle_turns_) += n;
+        queue_length_sum_ += queue_length_ * n;
+        last_turn_ = std::max(last_turn_, t);
+    }
+};
+
+// Migawka liczników fabryki po danej turze.
+struct RampMetricsSnapshot {
+    ElementID id;
+    std::uint64_t delivered;
+    std::uint64_t sent;
+    std::uint64_t dropped;
+
+    friend bool operator==(const RampMetricsSnapshot&, const RampMetricsSnapshot&) = default;
+};
+
+struct WorkerMetricsSnapshot {
+    ElementID id;
+    std::uint64_t busy_turns;
+    std::uint64_t idle_turns;
+    double utilization;              // busy / (busy + idle)
+    double mean_queue_length;        // time average
+    std::size_t max_queue_length;
+    std::uint64_t received;
+    std::uint64_t processed;
+    double throughput;               // processed packages per turn
+    std::uint64_t sent;
+    std::uint64_t dropped;
+
+    friend bool operator==(const WorkerMetricsSnapshot&, const WorkerMetricsSnapshot&) = default;
+};
+
+struct StorehouseMetricsSnapshot {
+    ElementID id;
+    std::uint64_t arrivals;
+
+    friend bool operator==(const StorehouseMetricsSnapshot&, const StorehouseMetricsSnapshot&) = default;
+};
+
+struct MetricsSnapshot {
+    Time turn;
+    std::vector<RampMetricsSnapshot> ramps;
+    std::vector<WorkerMetricsSnapshot> workers;
+    std::vector<StorehouseMetricsSnapshot> storehouses;
+
+    friend bool operator==(const MetricsSnapshot&, const MetricsSnapshot&) = default;
+};
+
+// Counters of every node as of the end of turn t (nodes in factory order).
+// Reads only the per-node counters, no queues. Counters are part of
+// checkpoints (from version 2), so a restored run gives the same snapshots.
+MetricsSnapshot snapshot_metrics(const Factory& factory, Time t);
+
+#ifdef NETSIM_PACKAGE_METADATA
+// End-to-end latency of every package stored so far (storehouse
+// histograms merged), e.g. value_at_percentile(99.9).
+LatencyHistogram factory_latency(const Factory& factory);
+#endif
+
+#endif // METRICS_HXX
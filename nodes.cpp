@@ -1,121 +1,397 @@
 #include "nodes.hxx"
+#include "simulation_context.hxx"
+#include "trace.hxx"
 
-void ReceiverPreferences::add_receiver(IPackageReceiver* receiver) {
-    const std::size_t old_count = preferences_.size();
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_set>
+#include <variant>
 
-    if (old_count == 0) {
-        preferences_.emplace(receiver, 1.0);
-        return;
+namespace {
+
+void trace_event(const SimulationContext& context, TraceEvent event, TraceNode node_kind, ElementID node,
+                 const Package& package) {
+    if (ITraceSink* sink = context.trace()) {
+        sink->record(make_trace_record(context.current_turn(), package.get_id(), node, event, node_kind));
     }
+}
 
-    const double new_prob = 1.0 / (old_count + 1);
+} // unnamed namespace
 
-    for (auto& entry : preferences_) {
-        entry.second = new_prob;
+void ReceiverPreferences::add_receiver(IPackageReceiver* receiver, double weight) {
+    if (!(weight > 0.0)) {
+        throw std::invalid_argument("Receiver weight must be positive");
+    }
+    for (const auto& entry : preferences_) {
+        if (entry.first == receiver) {
+            return;
+        }
     }
 
-    preferences_.emplace(receiver, new_prob);
+    append(receiver, weight);
+    rebuild();
+    if (observer_ != nullptr) {
+        observer_->receiver_added(*this, receiver);
+    }
 }
 
-void ReceiverPreferences::remove_receiver(IPackageReceiver* receiver) {
-    const std::size_t old_count = preferences_.size();
+void ReceiverPreferences::add_receivers(std::span<const receiver_weight_t> receivers) {
+    for (const auto& [_, weight] : receivers) {
+        if (!(weight > 0.0)) {
+            throw std::invalid_argument("Receiver weight must be positive");
+        }
+    }
 
-    if (old_count <= 1) {
-        preferences_.erase(receiver);
+    const std::size_t first = preferences_.size();
+    std::unordered_set<const IPackageReceiver*> present;
+    present.reserve(first + receivers.size());
+    for (const auto& entry : preferences_) {
+        present.insert(entry.first);
+    }
+    for (const auto& [receiver, weight] : receivers) {
+        if (present.insert(receiver).second) {
+            append(receiver, weight);
+        }
+    }
+    if (preferences_.size() == first) {
         return;
     }
 
-    const double updated_prob = 1.0 / (old_count - 1);
-
-    for (auto& entry : preferences_) {
-        if (entry.first != receiver) {
-            entry.second = updated_prob;
+    rebuild();
+    if (observer_ != nullptr) {
+        for (std::size_t i = first; i < preferences_.size(); ++i) {
+            observer_->receiver_added(*this, preferences_[i].first);
         }
     }
+}
 
-    preferences_.erase(receiver);
+void ReceiverPreferences::append(IPackageReceiver* receiver, double weight) {
+    preferences_.emplace_back(receiver, 0.0);
+    weights_.push_back(weight);
+    if (auto* worker = dynamic_cast<Worker*>(receiver)) {
+        handles_.emplace_back(worker);
+    } else if (auto* storehouse = dynamic_cast<Storehouse*>(receiver)) {
+        handles_.emplace_back(storehouse);
+    } else {
+        handles_.emplace_back(receiver);
+    }
+}
+
+void ReceiverPreferences::remove_receiver(IPackageReceiver* receiver) {
+    for (std::size_t i = 0; i < preferences_.size(); ++i) {
+        if (preferences_[i].first == receiver) {
+            preferences_.erase(preferences_.begin() + static_cast<std::ptrdiff_t>(i));
+            weights_.erase(weights_.begin() + static_cast<std::ptrdiff_t>(i));
+            handles_.erase(handles_.begin() + static_cast<std::ptrdiff_t>(i));
+            rebuild();
+            if (observer_ != nullptr) {
+                observer_->receiver_removed(*this, receiver);
+            }
+            return;
+        }
+    }
 }
 
 void ReceiverPreferences::remove_receiver(ElementID id) {
-    IPackageReceiver* found = nullptr;
-    for (auto& entry : preferences_) {
+    for (const auto& entry : preferences_) {
         if (entry.first->get_id() == id) {
-            found = entry.first;
-            break;
+            remove_receiver(entry.first);
+            return;
         }
     }
-    if (found != nullptr) {
-        remove_receiver(found);
-    }
 }
 
-IPackageReceiver* ReceiverPreferences::choose_receiver() {
-    const double p = pg_();
+double ReceiverPreferences::get_weight(const IPackageReceiver* receiver) const {
+    for (std::size_t i = 0; i < preferences_.size(); ++i) {
+        if (preferences_[i].first == receiver) {
+            return weights_[i];
+        }
+    }
+    return 0.0;
+}
 
-    if (p < 0.0 || p > 1.0) {
-        return nullptr;
+void ReceiverPreferences::rebuild() {
+    double total = 0.0;
+    uniform_ = true;
+    for (double w : weights_) {
+        total += w;
+        uniform_ = uniform_ && (w == weights_.front());
     }
 
+    cumulative_.resize(preferences_.size());
     double cumulative = 0.0;
+    for (std::size_t i = 0; i < preferences_.size(); ++i) {
+        preferences_[i].second = weights_[i] / total;
+        cumulative += preferences_[i].second;
+        cumulative_[i] = cumulative;
+    }
+    if (!cumulative_.empty()) {
+        // Guard against rounding: p == 1 must always select the last receiver.
+        cumulative_.back() = 1.0;
+    }
+}
 
-    for (auto& entry : preferences_) {
-        cumulative += entry.second;
+std::size_t ReceiverPreferences::index_for(double p) const {
+    if (p < 0.0 || p > 1.0 || preferences_.empty()) {
+        return npos;
+    }
 
-        if (cumulative < 0.0 || cumulative > 1.0) {
-            return nullptr;
+    if (uniform_) {
+        // Equal probabilities: the bucket follows from p directly; the
+        // correction steps only matter for p lying on a bucket boundary.
+        const std::size_t n = cumulative_.size();
+        std::size_t i = std::min(n - 1, static_cast<std::size_t>(p * static_cast<double>(n)));
+        if (i > 0 && p <= cumulative_[i - 1]) {
+            --i;
+        } else if (p > cumulative_[i]) {
+            ++i;
         }
+        return i;
+    }
+
+    return static_cast<std::size_t>(
+        std::lower_bound(cumulative_.begin(), cumulative_.end(), p) - cumulative_.begin());
+}
+
+IPackageReceiver* ReceiverPreferences::choose_receiver() {
+    const std::size_t i = choose_index();
+    return i == npos ? nullptr : preferences_[i].first;
+}
+
+void group_batch(const std::vector<std::size_t>& choices, std::vector<std::uint32_t>& order) {
+    const std::size_t n = choices.size();
+    order.resize(n);
 
-        if (p <= cumulative) {
-            return entry.first;
+    // Sortowanie przez zliczanie (stable) over the receivers actually drawn;
+    // slot `receivers` collects packages without a receiver.
+    std::size_t receivers = 0;
+    for (std::size_t i : choices) {
+        if (i != ReceiverPreferences::npos) {
+            receivers = std::max(receivers, i + 1);
         }
     }
+    if (receivers > 4 * n) {
+        // Few packages spread over a wide fan-out: sorting is cheaper.
+        for (std::size_t k = 0; k < n; ++k) {
+            order[k] = static_cast<std::uint32_t>(k);
+        }
+        std::stable_sort(order.begin(), order.end(), [&choices](std::uint32_t a, std::uint32_t b) {
+            return choices[a] < choices[b];
+        });
+        return;
+    }
+
+    thread_local std::vector<std::uint32_t> offset;
+    offset.assign(receivers + 2, 0);
+    auto slot = [receivers](std::size_t i) { return i == ReceiverPreferences::npos ? receivers : i; };
+    for (std::size_t i : choices) {
+        ++offset[slot(i) + 1];
+    }
+    for (std::size_t s = 1; s < offset.size(); ++s) {
+        offset[s] += offset[s - 1];
+    }
+    for (std::size_t k = 0; k < n; ++k) {
+        order[offset[slot(choices[k])]++] = static_cast<std::uint32_t>(k);
+    }
+}
+
+namespace {
+
+// Bufory robocze send_batch() (shared by the senders of a thread).
+struct BatchScratch {
+    std::vector<std::size_t> choices;
+    std::vector<std::uint32_t> order;
+    std::vector<Package> outgoing;
+};
+
+thread_local BatchScratch batch_scratch;
+
+} // unnamed namespace
+
+void PackageSender::send_batch() {
+    BatchScratch& scratch = batch_scratch;
+    const std::size_t n = 1 + batch_.size();
+    auto package_at = [this](std::size_t k) -> Package& { return k == 0 ? *bufor_ : batch_[k - 1]; };
+
+    scratch.choices.clear();
+    for (std::size_t k = 0; k < n; ++k) {
+        scratch.choices.push_back(receiver_preferences_.choose_index());
+    }
+    group_batch(scratch.choices, scratch.order);
 
-    return nullptr;
+    scratch.outgoing.clear();
+    for (std::uint32_t k : scratch.order) {
+        scratch.outgoing.push_back(std::move(package_at(k)));
+    }
+    bufor_.reset();
+    batch_.clear();
+
+    // Przebiegi paczek do tego samego odbiorcy.
+    std::size_t begin = 0;
+    while (begin < n) {
+        const std::size_t i = scratch.choices[scratch.order[begin]];
+        std::size_t end = begin + 1;
+        while (end < n && scratch.choices[scratch.order[end]] == i) {
+            ++end;
+        }
+        if (i == ReceiverPreferences::npos) {
+            sender_metrics_.dropped += end - begin;
+        } else {
+            const std::span<Package> run = std::span<Package>(scratch.outgoing).subspan(begin, end - begin);
+            std::visit([run](auto* receiver) { receiver->receive_batch(run); }, receiver_preferences_.handle(i));
+            sender_metrics_.sent += end - begin;
+        }
+        begin = end;
+    }
+    scratch.outgoing.clear();
 }
 
 void PackageSender::send_package() {
     if (!bufor_) {
         return;
     }
-    IPackageReceiver* chosen = receiver_preferences_.choose_receiver();
+    if (!batch_.empty()) {
+        send_batch();
+        return;
+    }
+    const std::size_t i = receiver_preferences_.choose_index();
 
-    if (chosen) {
-        chosen->receive_package(std::move(*bufor_));
+    if (i != ReceiverPreferences::npos) {
+        std::visit([this](auto* receiver) { receiver->receive_package(std::move(*bufor_)); },
+                   receiver_preferences_.handle(i));
+        ++sender_metrics_.sent;
+    } else {
+        ++sender_metrics_.dropped;
     }
 
     bufor_.reset();
 }
 
-void Worker::do_work(Time current) {
-    if (!bufor_ && !q_->empty()) {
-        bufor_.emplace(q_->pop());
-        t_ = current;
-        return;
+Worker::QueueRef Worker::queue_ref(IPackageQueue* q) {
+    if (auto* fifo = dynamic_cast<FifoPackageQueue*>(q)) {
+        return fifo;
+    }
+    if (auto* lifo = dynamic_cast<LifoPackageQueue*>(q)) {
+        return lifo;
+    }
+    if (auto* queue = dynamic_cast<PackageQueue*>(q)) {
+        return queue;
+    }
+    return q;
+}
+
+void Worker::set_queue(PackageQueuePtr q) {
+    std::vector<Package> packages;
+    packages.reserve(q_->size());
+    while (!q_->empty()) {
+        packages.push_back(q_->pop());
     }
+    if (q_->get_queue_type() == PackageQueueType::LIFO) {
+        std::reverse(packages.begin(), packages.end());
+    }
+    q->push_batch(packages);
+    q_ = std::move(q);
+    queue_ = queue_ref(q_.get());
+}
+
+template <typename Queue>
+void Worker::start_processing(Time t, Queue& q, const SimulationContext& context) {
+    bufor_.emplace(q.pop());
+    t_ = t;
+#ifdef NETSIM_PACKAGE_METADATA
+    wait_times_.record(static_cast<std::uint64_t>(bufor_->dequeued(t)));
+#endif
+    trace_event(context, TraceEvent::PROCESSING_START, TraceNode::WORKER, id_, *bufor_);
+}
 
-    if (current - t_ + 1 == pd_) {
-        push_package(Package(bufor_->get_id()));
+template <typename Queue>
+void Worker::work(Time current, Queue& q) {
+    if (!bufor_ && !q.empty()) {
+        start_processing(current, q, SimulationContext::current());
+        metrics_.turn_worked(current, true, true, q.size(), false);
+    } else if (bufor_ && current - t_ + 1 == pd_) {
+        const SimulationContext& context = SimulationContext::current();
+        trace_event(context, TraceEvent::PROCESSING_FINISH, TraceNode::WORKER, id_, *bufor_);
+        push_package(std::move(*bufor_));
         bufor_.reset();
 
-        if (!q_->empty()) {
-            bufor_.emplace(q_->pop());
-            t_ = current;
+        if (!q.empty()) {
+            start_processing(current, q, context);
         }
+        metrics_.turn_worked(current, true, bufor_.has_value(), q.size(), true);
     }
 }
 
+void Worker::do_work(Time current) {
+    std::visit([this, current](auto* q) { work(current, *q); }, queue_);
+}
+
+template <typename Queue>
+void Worker::receive(std::span<Package> packages, Queue& q) {
+    const SimulationContext& context = SimulationContext::current();
+    for (Package& pkg : packages) {
+        trace_event(context, TraceEvent::QUEUE_PUSH, TraceNode::WORKER, id_, pkg);
+#ifdef NETSIM_PACKAGE_METADATA
+        pkg.arrived(context.current_turn());
+#endif
+        q.push(std::move(pkg));
+    }
+    metrics_.package_received(context.current_turn(), q.size(), packages.size());
+}
+
 void Worker::receive_package(Package&& pkg) {
-    q_->push(std::move(pkg));
+    std::visit([this, &pkg](auto* q) { receive(std::span<Package>(&pkg, 1), *q); }, queue_);
+}
+
+void Worker::receive_batch(std::span<Package> packages) {
+    std::visit([this, packages](auto* q) { receive(packages, *q); }, queue_);
 }
 
 void Storehouse::receive_package(Package&& pkg) {
+    const SimulationContext& context = SimulationContext::current();
+    record_arrival(context, pkg);
     d_->push(std::move(pkg));
+    ++arrivals_;
+}
+
+void Storehouse::receive_batch(std::span<Package> packages) {
+    const SimulationContext& context = SimulationContext::current();
+    for (Package& pkg : packages) {
+        record_arrival(context, pkg);
+    }
+    d_->push_batch(packages);
+    arrivals_ += packages.size();
+}
+
+void Storehouse::record_arrival(const SimulationContext& context, Package& pkg) {
+    trace_event(context, TraceEvent::STOREHOUSE_ARRIVAL, TraceNode::STOREHOUSE, id_, pkg);
+#ifdef NETSIM_PACKAGE_METADATA
+    pkg.arrived(context.current_turn());
+    latency_.record(static_cast<std::uint64_t>(context.current_turn() - pkg.get_metadata().created));
+#endif
+}
+
+Ramp::Ramp(ElementID id, TimeOffset di, std::size_t batch_size)
+    : PackageSender(), id_(id), di_(di), batch_size_(batch_size) {
+    if (batch_size == 0) {
+        throw std::invalid_argument("Ramp batch size must be positive");
+    }
+    reserve_batch(batch_size);
 }
 
 void Ramp::deliver_goods(Time current) {
     // Dostarcza paczki w stałych odstępach czasu równych di_,
     // począwszy od pierwszej jednostki czasu.
     if ((current - 1) % di_ == 0) {
+        const SimulationContext& context = SimulationContext::current();
         push_package(Package());
+        ++delivered_;
+        trace_event(context, TraceEvent::DELIVERY, TraceNode::RAMP, id_, *get_sending_buffer());
+
+        for (std::size_t k = 1; k < batch_size_; ++k) {
+            push_package(Package());
+            trace_event(context, TraceEvent::DELIVERY, TraceNode::RAMP, id_, get_sending_batch().back());
+        }
+        delivered_ += batch_size_ - 1;
     }
 }
@@ -6,14 +6,31 @@
 #include "package.hxx"
 #include "storage_types.hxx"
 #include "helpers.hxx"
+#include "latency.hxx"
+#include "metrics.hxx"
+#include <cstdint>
 #include <memory>
-#include <map>
+#include <memory_resource>
 #include <optional>
+#include <span>
 #include <utility>
+#include <variant>
+#include <vector>
+
+class SimulationContext;
+
 class IPackageReceiver {
 public:
     virtual void receive_package(Package&& p) = 0;
 
+    // Several packages from one sender, in order (the span's packages are
+    // moved from). Same effect as receive_package() for each of them.
+    virtual void receive_batch(std::span<Package> packages) {
+        for (Package& p : packages) {
+            receive_package(std::move(p));
+        }
+    }
+
     virtual ElementID get_id() const = 0;
 
     virtual IPackageStockpile::const_iterator cbegin() const = 0;
@@ -28,60 +45,173 @@ public:
     virtual ~IPackageReceiver() = default;
 };
 
+class ReceiverPreferences;
+class Worker;
+class Storehouse;
+
+// Odbiorca z typem znanym statycznie: Worker and Storehouse are final, so
+// calls through their pointers are direct; other IPackageReceiver
+// implementations go through the virtual interface.
+using ReceiverHandle = std::variant<Worker*, Storehouse*, IPackageReceiver*>;
+
+// Obserwator zmian połączeń (used by Factory to keep its topology state).
+class ILinkObserver {
+public:
+    virtual void receiver_added(ReceiverPreferences& prefs, IPackageReceiver* receiver) = 0;
+    virtual void receiver_removed(ReceiverPreferences& prefs, IPackageReceiver* receiver) = 0;
+
+    virtual ~ILinkObserver() = default;
+};
+
+// Preferencje odbiorców nadawcy.
+//
+// Receivers are kept in insertion order together with their selection
+// probability (weight / sum of weights). A cumulative-probability table is
+// rebuilt only when the set of receivers changes; choose_receiver() then
+// maps the drawn number p to the first receiver whose cumulative probability
+// is >= p - directly for uniform weights, by binary search otherwise.
 class ReceiverPreferences {
 public:
-    using preferences_t = std::map<IPackageReceiver *, double>;
+    using preferences_t = std::pmr::vector<std::pair<IPackageReceiver *, double>>;
     using const_iterator = preferences_t::const_iterator;
 
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
     explicit ReceiverPreferences(ProbabilityGenerator pg = probability_generator)
         : pg_(std::move(pg)) {}
 
+    // The observer is not carried over: it watches one particular object.
+    ReceiverPreferences(ReceiverPreferences&& other) noexcept
+        : preferences_(std::move(other.preferences_)), weights_(std::move(other.weights_)),
+          handles_(std::move(other.handles_)), cumulative_(std::move(other.cumulative_)),
+          uniform_(other.uniform_), pg_(std::move(other.pg_)) {}
+    // Same, with the tables moved to memory from the resource.
+    ReceiverPreferences(ReceiverPreferences&& other, std::pmr::memory_resource* resource)
+        : preferences_(std::move(other.preferences_), resource), weights_(std::move(other.weights_), resource),
+          handles_(std::move(other.handles_), resource), cumulative_(std::move(other.cumulative_), resource),
+          uniform_(other.uniform_), pg_(std::move(other.pg_)) {}
+
     const_iterator cbegin() const { return preferences_.cbegin(); }
     const_iterator cend() const { return preferences_.cend(); }
 
     const_iterator begin() const { return preferences_.cbegin(); }
     const_iterator end() const { return preferences_.cend(); }
 
-    void add_receiver(IPackageReceiver *r);
+    using receiver_weight_t = std::pair<IPackageReceiver *, double>;
+
+    // Adding an already present receiver is a no-op. O(number of receivers)
+    // - a large fan-out should be built with add_receivers().
+    void add_receiver(IPackageReceiver *r, double weight = 1.0);
+    // Same as add_receiver() for each entry in turn, with one duplicate check
+    // and one table rebuild for all of them: O(n) for n receivers. All
+    // weights are checked before anything is added.
+    void add_receivers(std::span<const receiver_weight_t> receivers);
     void remove_receiver(IPackageReceiver *r);
     void remove_receiver(ElementID id);
     IPackageReceiver *choose_receiver();
 
+    // Position (in get_preferences()) of the receiver drawn by the generator,
+    // or npos when nothing is chosen.
+    std::size_t choose_index() { return index_for(pg_()); }
+    // Position selected by a given number p from [0, 1], or npos.
+    std::size_t index_for(double p) const;
+
+    void set_probability_generator(ProbabilityGenerator pg) { pg_ = std::move(pg); }
+
+    // Notified after every added or removed receiver (nullptr = none).
+    void set_observer(ILinkObserver* observer) { observer_ = observer; }
+
     const preferences_t &get_preferences() const { return preferences_; }
+    // Receiver at position i of get_preferences(), with its concrete type.
+    ReceiverHandle handle(std::size_t i) const { return handles_[i]; }
+    // Weight of the receiver at position i (O(1), unlike get_weight()).
+    double weight(std::size_t i) const { return weights_[i]; }
+
+    // Weight the receiver was added with (0 if it is not a receiver).
+    double get_weight(const IPackageReceiver *r) const;
 
     bool empty() const { return preferences_.empty(); }
+    std::size_t size() const { return preferences_.size(); }
 
 private:
     preferences_t preferences_;
+    std::pmr::vector<double> weights_;
+    std::pmr::vector<ReceiverHandle> handles_;
+    std::pmr::vector<double> cumulative_;
+    bool uniform_ = true;
     ProbabilityGenerator pg_;
+    ILinkObserver* observer_ = nullptr;
+
+    void append(IPackageReceiver *r, double weight);
+    void rebuild();
 };
 
+// Kolejność doręczenia partii paczek.
+//
+// choices[k] is the receiver index drawn for package k of a batch (npos =
+// none). Fills `order` with package positions grouped by receiver: receivers
+// in ascending index, packages of one receiver in batch order, packages
+// without a receiver last.
+void group_batch(const std::vector<std::size_t>& choices, std::vector<std::uint32_t>& order);
+
+// Bufor nadawczy to mały wektor: the first package is kept inline (a worker
+// never holds more), the rest of a ramp's batch in batch_.
 class PackageSender {
 public:
     ReceiverPreferences receiver_preferences_;
 
     PackageSender() = default;
     PackageSender(PackageSender &&pack_sender) = default;
-
+    // Przeniesienie z preferencjami w pamięci z zasobu (used by Factory).
+    PackageSender(PackageSender &&other, std::pmr::memory_resource *resource)
+        : receiver_preferences_(std::move(other.receiver_preferences_), resource),
+          bufor_(std::move(other.bufor_)), batch_(std::move(other.batch_)),
+          sender_metrics_(other.sender_metrics_) {}
+
+    // Sends the whole buffer: one receiver draw per package; a batch goes to
+    // its receivers with one receive_batch() call each.
     void send_package();
 
+    // First package of the sending buffer.
     const std::optional<Package> &get_sending_buffer() const { return bufor_; }
+    // Packages 2..n of the sending buffer (empty unless a ramp delivered a batch).
+    const std::vector<Package> &get_sending_batch() const { return batch_; }
+    std::size_t get_sending_count() const { return bufor_ ? 1 + batch_.size() : 0; }
+
+    const SenderMetrics& get_sender_metrics() const { return sender_metrics_; }
 
 protected:
-    void push_package(Package &&package) { bufor_.emplace(package.get_id()); };
+    // Appends to the sending buffer.
+    void push_package(Package &&package) {
+        if (!bufor_) {
+            bufor_.emplace(std::move(package));
+        } else {
+            batch_.push_back(std::move(package));
+        }
+    }
+
+    void reserve_batch(std::size_t n) { batch_.reserve(n > 0 ? n - 1 : 0); }
 
 private:
+    friend class SimulationImage;
+    friend class CheckpointCodec;
+
     std::optional<Package> bufor_ = std::nullopt;
+    std::vector<Package> batch_;
+    SenderMetrics sender_metrics_;
+
+    void send_batch();
 };
 
-class Storehouse : public IPackageReceiver {
+class Storehouse final : public IPackageReceiver {
 public:
     Storehouse(ElementID id,
-               std::unique_ptr<IPackageStockpile> d =
-                   std::make_unique<PackageQueue>(PackageQueueType::FIFO))
+               PackageStockpilePtr d =
+                   make_package_queue(PackageQueueType::FIFO))
         : id_(id), d_(std::move(d)) {}
 
     void receive_package(Package &&p) override;
+    void receive_batch(std::span<Package> packages) override;
 
     ElementID get_id() const override { return id_; }
 
@@ -95,24 +225,61 @@ public:
 
     const IPackageStockpile& get_stock() const { return *d_; }
 
+    // Packages received so far (also when the stockpile keeps only counters).
+    std::uint64_t get_arrival_count() const { return arrivals_; }
+
+#ifdef NETSIM_PACKAGE_METADATA
+    // End-to-end latency (turns from ramp delivery to arrival) of received packages.
+    const LatencyHistogram& get_latency() const { return latency_; }
+#endif
+
 private:
+    friend class SimulationImage;
+    friend class CheckpointCodec;
+
     ElementID id_;
-    std::unique_ptr<IPackageStockpile> d_;
+    PackageStockpilePtr d_;
+    std::uint64_t arrivals_ = 0;
+#ifdef NETSIM_PACKAGE_METADATA
+    LatencyHistogram latency_;
+#endif
+
+    void record_arrival(const SimulationContext& context, Package& package);
 };
 
 
-class Worker : public IPackageReceiver, public PackageSender {
+// Kolejka robotnika jest trzymana jako IPackageQueue, but do_work() and the
+// receive functions go through queue_, which records the queue's concrete
+// type once: FifoPackageQueue and LifoPackageQueue operations then inline.
+class Worker final : public IPackageReceiver, public PackageSender {
 public:
-    Worker(ElementID id, TimeOffset pd, std::unique_ptr<IPackageQueue> q)
-        : PackageSender(), id_(id), pd_(pd), t_(0), q_(std::move(q)) {}
+    Worker(ElementID id, TimeOffset pd, PackageQueuePtr q)
+        : PackageSender(), id_(id), pd_(pd), t_(0), q_(std::move(q)), queue_(queue_ref(q_.get())) {}
+
+    Worker(Worker &&other) = default;
+    // Links moved to memory from the resource; the queue is taken over as is.
+    Worker(Worker &&other, std::pmr::memory_resource *resource)
+        : PackageSender(std::move(other), resource), id_(other.id_), pd_(other.pd_), t_(other.t_),
+          q_(std::move(other.q_)), queue_(other.queue_), bufor_(std::move(other.bufor_)),
+          metrics_(other.metrics_)
+#ifdef NETSIM_PACKAGE_METADATA
+          , wait_times_(std::move(other.wait_times_))
+#endif
+    {}
 
     void do_work(Time t);
 
     TimeOffset get_processing_duration() const { return pd_; }
     TimeOffset get_processing_time() const { return pd_; }
+    // Applies from the next package started.
+    void set_processing_duration(TimeOffset pd) { pd_ = pd; }
+
+    // Replaces the queue; queued packages move to the new one in stored order.
+    void set_queue(PackageQueuePtr q);
     Time get_package_processing_start_time() const { return t_; }
 
     void receive_package(Package &&p) override;
+    void receive_batch(std::span<Package> packages) override;
 
     ElementID get_id() const override { return id_; }
 
@@ -128,34 +295,75 @@ public:
     const std::optional<Package>& get_processing_buffer() const { return bufor_; }
     const IPackageQueue* get_queue() const { return q_.get(); }
 
+    const WorkerMetrics& get_metrics() const { return metrics_; }
+
+#ifdef NETSIM_PACKAGE_METADATA
+    // Turns packages spent in this worker's queue.
+    const LatencyHistogram& get_wait_times() const { return wait_times_; }
+#endif
+
     // Ułatwienie konfiguracji połączeń – deleguje do ReceiverPreferences.
-    void add_receiver(IPackageReceiver* receiver) { receiver_preferences_.add_receiver(receiver); }
+    void add_receiver(IPackageReceiver* receiver, double weight = 1.0) { receiver_preferences_.add_receiver(receiver, weight); }
 
 private:
+    friend class SimulationImage;
+    friend class CheckpointCodec;
+
+    using QueueRef = std::variant<FifoPackageQueue*, LifoPackageQueue*, PackageQueue*, IPackageQueue*>;
+
     ElementID id_;
     TimeOffset pd_;
     Time t_;
-    std::unique_ptr<IPackageQueue> q_;
+    PackageQueuePtr q_;
+    QueueRef queue_;
     std::optional<Package> bufor_ = std::nullopt;
+    WorkerMetrics metrics_;
+#ifdef NETSIM_PACKAGE_METADATA
+    LatencyHistogram wait_times_;
+#endif
+
+    static QueueRef queue_ref(IPackageQueue* q);
+
+    template <typename Queue>
+    void work(Time current, Queue& q);
+    template <typename Queue>
+    void start_processing(Time t, Queue& q, const SimulationContext& context);
+    template <typename Queue>
+    void receive(std::span<Package> packages, Queue& q);
 };
 
 
 class Ramp : public PackageSender {
 public:
-    Ramp(ElementID id, TimeOffset di)
-        : PackageSender(), id_(id), di_(di) {}
+    // Every delivery brings batch_size packages (a truck rather than a parcel).
+    Ramp(ElementID id, TimeOffset di, std::size_t batch_size = 1);
+
+    Ramp(Ramp &&other) = default;
+    Ramp(Ramp &&other, std::pmr::memory_resource *resource)
+        : PackageSender(std::move(other), resource), id_(other.id_), di_(other.di_),
+          batch_size_(other.batch_size_), delivered_(other.delivered_) {}
 
     void deliver_goods(Time t);
 
     TimeOffset get_delivery_interval() const { return di_; }
+    void set_delivery_interval(TimeOffset di) { di_ = di; }
+    std::size_t get_batch_size() const { return batch_size_; }
     ElementID get_id() const { return id_; }
 
+    // Packages created so far.
+    std::uint64_t get_delivered_count() const { return delivered_; }
+
     // Ułatwienie konfiguracji sieci – przekazuje dalej do ReceiverPreferences.
-    void add_receiver(IPackageReceiver* receiver) { receiver_preferences_.add_receiver(receiver); }
+    void add_receiver(IPackageReceiver* receiver, double weight = 1.0) { receiver_preferences_.add_receiver(receiver, weight); }
 
 private:
+    friend class SimulationImage;
+    friend class CheckpointCodec;
+
     ElementID id_;
     TimeOffset di_;
+    std::size_t batch_size_;
+    std::uint64_t delivered_ = 0;
 };
 
 #endif // NODES_HXX
\ No newline at end of file
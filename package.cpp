@@ -1,46 +1,42 @@
 #include "package.hxx"
-
-std::set<ElementID> Package::assigned_IDs_;
-std::set<ElementID> Package::freed_IDs_;
-
-ElementID Package::acquire_id() {
-    if (!freed_IDs_.empty()) {
-        auto it = freed_IDs_.begin();
-        ElementID id = *it;
-        freed_IDs_.erase(it);
-        assigned_IDs_.insert(id);
-        return id;
-    }
-
-    ElementID new_id = assigned_IDs_.empty()
-        ? 1
-        : (*assigned_IDs_.rbegin()) + 1;
-
-    assigned_IDs_.insert(new_id);
-    return new_id;
+#include "simulation_context.hxx"
+
+Package::Package() {
+    SimulationContext& context = SimulationContext::current();
+    pool_ = &context.id_pool();
+    id_ = pool_->acquire();
+#ifdef NETSIM_PACKAGE_METADATA
+    metadata_.created = context.current_turn();
+    metadata_.queued_at = metadata_.created;
+#endif
 }
 
-void Package::release_id(ElementID id) {
-    assigned_IDs_.erase(id);
-    freed_IDs_.insert(id);
-}
-
-Package::Package() : id_(acquire_id()) {}
-
 Package::Package(ElementID id) : id_(id) {
-    assigned_IDs_.insert(id);
+    SimulationContext& context = SimulationContext::current();
+    pool_ = &context.id_pool();
+    pool_->reserve(id);
+#ifdef NETSIM_PACKAGE_METADATA
+    metadata_.created = context.current_turn();
+    metadata_.queued_at = metadata_.created;
+#endif
 }
 
-Package::Package(Package&& other) noexcept : id_(other.id_) {
+Package::Package(Package&& other) noexcept
+    : id_(other.id_), pool_(other.pool_) {
+#ifdef NETSIM_PACKAGE_METADATA
+    metadata_ = other.metadata_;
+#endif
     other.id_ = -1;
 }
 
 Package& Package::operator=(Package&& other) noexcept {
     if (this != &other) {
-        if (id_ != -1) {
-            release_id(id_);
-        }
+        release_id();
         id_ = other.id_;
+        pool_ = other.pool_;
+#ifdef NETSIM_PACKAGE_METADATA
+        metadata_ = other.metadata_;
+#endif
         other.id_ = -1;
     }
     return *this;
@@ -51,7 +47,11 @@ ElementID Package::get_id() const {
 }
 
 Package::~Package() {
+    release_id();
+}
+
+void Package::release_id() {
     if (id_ != -1) {
-        release_id(id_);
+        pool_->release(id_);
     }
 }
@@ -1,7 +1,19 @@
 #pragma once
 
 #include "types.hxx"
-#include <set>
+
+class IdPool;
+
+#ifdef NETSIM_PACKAGE_METADATA
+// Metadane paczki (only with NETSIM_PACKAGE_METADATA; without it Package
+// holds just its ID).
+struct PackageMetadata {
+    Time created = 0;            // turn the package was made in (ramp delivery)
+    std::uint32_t hops = 0;      // receivers entered so far, storehouse included
+    Time waited = 0;             // turns spent in worker queues, all workers
+    Time queued_at = 0;          // turn of the last arrival
+};
+#endif
 
 class Package {
 public:
@@ -16,14 +28,32 @@ public:
 
     ElementID get_id() const;
 
+#ifdef NETSIM_PACKAGE_METADATA
+    const PackageMetadata& get_metadata() const { return metadata_; }
+
+    // Package entered a receiver in turn t.
+    void arrived(Time t) {
+        ++metadata_.hops;
+        metadata_.queued_at = t;
+    }
+
+    // Package left a worker's queue in turn t; returns the wait.
+    Time dequeued(Time t) {
+        const Time wait = t - metadata_.queued_at;
+        metadata_.waited += wait;
+        return wait;
+    }
+#endif
+
     ~Package();
 
 private:
     ElementID id_;
+    // Pool the ID was taken from (the active SimulationContext's pool at construction).
+    IdPool* pool_;
+#ifdef NETSIM_PACKAGE_METADATA
+    PackageMetadata metadata_;
+#endif
 
-    static std::set<ElementID> assigned_IDs_;
-    static std::set<ElementID> freed_IDs_;
-
-    static ElementID acquire_id();
-    static void release_id(ElementID id);
+    void release_id();
 };
@@ -0,0 +1,109 @@
+#include "replications.hxx"
+
+#include <algorithm>
+#include <cmath>
+
+#include "factory.hxx"
+#include "helpers.hxx"
+#include "simulation_image.hxx"
+#include "thread_pool.hxx"
+
+namespace {
+
+// SplitMix64 - mixes (seed, replication) into well separated seeds.
+std::uint64_t splitmix64(std::uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+SampleStatistics describe(const std::vector<double>& values) {
+    SampleStatistics stats;
+    stats.count = values.size();
+    if (values.empty()) {
+        return stats;
+    }
+
+    double sum = 0.0;
+    for (double v : values) {
+        sum += v;
+    }
+    stats.mean = sum / static_cast<double>(values.size());
+
+    double squares = 0.0;
+    for (double v : values) {
+        squares += (v - stats.mean) * (v - stats.mean);
+    }
+    if (values.size() > 1) {
+        stats.stddev = std::sqrt(squares / static_cast<double>(values.size() - 1));
+    }
+
+    auto [lo, hi] = std::minmax_element(values.begin(), values.end());
+    stats.min = *lo;
+    stats.max = *hi;
+    return stats;
+}
+
+std::map<ElementID, SampleStatistics> describe_all(
+    const std::vector<ReplicationResult>& results,
+    std::map<ElementID, std::size_t> ReplicationResult::*member
+) {
+    std::map<ElementID, std::vector<double>> samples;
+    for (const auto& result : results) {
+        for (const auto& [id, value] : result.*member) {
+            samples[id].push_back(static_cast<double>(value));
+        }
+    }
+
+    std::map<ElementID, SampleStatistics> stats;
+    for (const auto& [id, values] : samples) {
+        stats[id] = describe(values);
+    }
+    return stats;
+}
+
+} // unnamed namespace
+
+double SampleStatistics::ci95_half_width() const {
+    return count > 1 ? 1.96 * stddev / std::sqrt(static_cast<double>(count)) : 0.0;
+}
+
+std::uint64_t replication_seed(std::uint64_t base_seed, std::size_t replication) {
+    return splitmix64(base_seed ^ splitmix64(static_cast<std::uint64_t>(replication)));
+}
+
+ReplicationSummary run_replications(
+    const Factory& factory,
+    TimeOffset duration,
+    std::size_t replications,
+    std::uint64_t base_seed,
+    unsigned threads
+) {
+    ReplicationSummary summary;
+    summary.replications.resize(replications);
+
+    ImageSimulationOptions options;
+    options.report_turn = [](Time) { return false; };
+
+    ThreadPool pool(threads);
+    pool.run(replications, [&](std::size_t i) {
+        Factory copy = copy_factory_structure(factory);
+        ReplicationResult& result = summary.replications[i];
+        result.seed = replication_seed(base_seed, i);
+        copy.get_context().seed(result.seed);
+
+        simulate_compiled(copy, duration, [](Factory&, Time) {}, options);
+
+        for (auto it = copy.storehouse_cbegin(); it != copy.storehouse_cend(); ++it) {
+            result.stock_counts[it->get_id()] = static_cast<std::size_t>(it->get_arrival_count());
+        }
+        for (auto it = copy.worker_cbegin(); it != copy.worker_cend(); ++it) {
+            result.queue_lengths[it->get_id()] = it->get_queue()->size();
+        }
+    });
+
+    summary.stock_counts = describe_all(summary.replications, &ReplicationResult::stock_counts);
+    summary.queue_lengths = describe_all(summary.replications, &ReplicationResult::queue_lengths);
+    return summary;
+}
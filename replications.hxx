@@ -0,0 +1,57 @@
+#pragma once
+#ifndef REPLICATIONS_HXX
+#define REPLICATIONS_HXX
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "types.hxx"
+
+class Factory;
+
+// Statystyki próby (wartości jednej wielkości ze wszystkich replikacji).
+struct SampleStatistics {
+    std::size_t count = 0;
+    double mean = 0.0;
+    double stddev = 0.0;    // sample standard deviation
+    double min = 0.0;
+    double max = 0.0;
+
+    // Half-width of the normal-approximation 95% confidence interval of the mean.
+    double ci95_half_width() const;
+};
+
+struct ReplicationResult {
+    std::uint64_t seed = 0;
+    std::map<ElementID, std::size_t> stock_counts;     // storehouse ID -> packages delivered
+    std::map<ElementID, std::size_t> queue_lengths;    // worker ID -> packages in queue
+};
+
+struct ReplicationSummary {
+    std::vector<ReplicationResult> replications;       // in replication order
+    std::map<ElementID, SampleStatistics> stock_counts;
+    std::map<ElementID, SampleStatistics> queue_lengths;
+};
+
+// Seed used by replication number i (independent streams derived from base_seed).
+std::uint64_t replication_seed(std::uint64_t base_seed, std::size_t replication);
+
+// Runs independent Monte Carlo replications of the factory's structure.
+//
+// Each replication simulates its own copy (copy_factory_structure) with its
+// own simulation context - package IDs and a random stream seeded with
+// replication_seed(base_seed, i) - so the replications run in parallel on
+// a ThreadPool (threads == 0: all hardware threads) and the results do not
+// depend on the number of threads. Statistics describe the state after
+// `duration` turns.
+ReplicationSummary run_replications(
+    const Factory& factory,
+    TimeOffset duration,
+    std::size_t replications,
+    std::uint64_t base_seed,
+    unsigned threads = 0
+);
+
+#endif // REPLICATIONS_HXX
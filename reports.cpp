@@ -1,9 +1,12 @@
 #include "reports.hxx"
 
-#include <iostream>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
 #include <optional>
+#include <ostream>
+#include <type_traits>
 #include <vector>
-#include <algorithm>
 
 #include "factory.hxx"
 #include "nodes.hxx"
@@ -49,172 +52,509 @@ std::string receiver_type_name(ReceiverType type) {
     return "";
 }
 
+// Wszystkie paczki, które trafiły do składowiska: agregujący magazyn
+// pamięta tylko ostatnie, ale liczy każdą dostawę.
+std::uint64_t package_total(const IPackageStockpile* packages) {
+    if (packages == nullptr) return 0;
+    if (const auto* aggregate = dynamic_cast<const AggregateStockpile*>(packages)) {
+        return aggregate->delivered();
+    }
+    return packages->size();
+}
+
 } // unnamed namespace
 
 // =========================
-// STRUCTURE REPORT
+// REPORT WRITER
 // =========================
 
-void generate_structure_report(const Factory& f, std::ostream& os) {
-    // Collect and sort ramps by id
-    std::vector<const Ramp*> ramps;
-    for (const auto& r : f.get_ramps()) ramps.push_back(&r);
-    std::sort(ramps.begin(), ramps.end(),
-              [](const Ramp* a, const Ramp* b) { return a->get_id() < b->get_id(); });
-
-    // Collect and sort workers by id
-    std::vector<const Worker*> workers;
-    for (const auto& w : f.get_workers()) workers.push_back(&w);
-    std::sort(workers.begin(), workers.end(),
-              [](const Worker* a, const Worker* b) { return a->get_id() < b->get_id(); });
-
-    // Collect and sort storehouses by id
-    std::vector<const Storehouse*> stores;
-    for (const auto& s : f.get_storehouses()) stores.push_back(&s);
-    std::sort(stores.begin(), stores.end(),
-              [](const Storehouse* a, const Storehouse* b) { return a->get_id() < b->get_id(); });
-
-    // == LOADING RAMPS ==
-    os << "== LOADING RAMPS ==" << std::endl;
-    for (const auto* ramp : ramps) {
-        os << "LOADING_RAMP #" << ramp->get_id() << std::endl;
-        os << "  Delivery interval: " << ramp->get_delivery_interval() << std::endl;
-        os << "  Receivers:" << std::endl;
-
-        auto recs = sorted_receivers(ramp->receiver_preferences_);
-        for (const auto& rec : recs) {
-            os << "    " << receiver_type_name(rec.type) << " #" << rec.id << std::endl;
-        }
-        if (recs.empty()) {
-            os << "    (none)" << std::endl;
-        }
-        os << std::endl;
+ReportWriter::ReportWriter(std::ostream& os, ReportFormat format, std::size_t buffer_size)
+    : os_(os), format_(format), buffer_size_(buffer_size) {}
+
+ReportWriter::~ReportWriter() {
+    write_buffer();
+}
+
+void ReportWriter::flush() {
+    write_buffer();
+    os_.flush();
+}
+
+void ReportWriter::write_buffer() {
+    if (!buffer_.empty()) {
+        os_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+        buffer_.clear();
     }
-    if (!ramps.empty()) {
-        // remove extra blank line after last ramp
-        os.seekp(-1, std::ios_base::cur);
+}
+
+void ReportWriter::commit() {
+    // Zapis do strumienia dopiero po zapełnieniu bufora.
+    if (buffer_.size() >= buffer_size_) {
+        write_buffer();
     }
+}
 
-    // == WORKERS ==
-    if (!ramps.empty()) {
-        os << std::endl;
+void ReportWriter::update_order(const Factory& f) {
+    if (cached_factory_ == &f && cached_version_ == f.get_topology_version()) {
+        return;
     }
-    os << "== WORKERS ==" << std::endl;
-    for (const auto* worker : workers) {
-        os << "WORKER #" << worker->get_id() << std::endl;
-        os << "  Processing time: " << worker->get_processing_time() << std::endl;
-        os << "  Queue type: " << to_string(worker->get_queue_type()) << std::endl;
-        os << "  Receivers:" << std::endl;
+    cached_factory_ = &f;
+    cached_version_ = f.get_topology_version();
+
+    auto by_id = [](const auto* a, const auto* b) { return a->get_id() < b->get_id(); };
+
+    ramps_.clear();
+    for (const auto& r : f.get_ramps()) ramps_.push_back(&r);
+    std::sort(ramps_.begin(), ramps_.end(), by_id);
+
+    workers_.clear();
+    for (const auto& w : f.get_workers()) workers_.push_back(&w);
+    std::sort(workers_.begin(), workers_.end(), by_id);
+
+    storehouses_.clear();
+    for (const auto& s : f.get_storehouses()) storehouses_.push_back(&s);
+    std::sort(storehouses_.begin(), storehouses_.end(), by_id);
+}
+
+void ReportWriter::reserve_buffer() {
+    // Rezerwacja przy pierwszym raporcie: about one line per node, which
+    // a one-shot writer rarely outgrows; later reports reuse the capacity.
+    const std::size_t nodes = ramps_.size() + workers_.size() + storehouses_.size();
+    buffer_.reserve(std::min(buffer_size_, buffer_.size() + 128 * (nodes + 1)));
+}
+
+void ReportWriter::write_structure(const Factory& f) {
+    update_order(f);
+    reserve_buffer();
+    switch (format_) {
+        case ReportFormat::TEXT:   text_structure(); break;
+        case ReportFormat::CSV:    csv_structure(); break;
+        case ReportFormat::JSONL:  jsonl_structure(); break;
+        case ReportFormat::BINARY: binary_structure(); break;
+    }
+    commit();
+}
+
+void ReportWriter::write_turn(const Factory& f, Time t) {
+    update_order(f);
+    reserve_buffer();
+    switch (format_) {
+        case ReportFormat::TEXT:   text_turn(t); break;
+        case ReportFormat::CSV:    csv_turn(t); break;
+        case ReportFormat::JSONL:  jsonl_turn(t); break;
+        case ReportFormat::BINARY: binary_turn(t); break;
+    }
+    commit();
+}
 
-        auto recs = sorted_receivers(worker->receiver_preferences_);
+void ReportWriter::put_number(std::int64_t value) {
+    char digits[24];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    buffer_.append(digits, result.ptr);
+}
+
+template <typename T>
+void ReportWriter::put_raw(T value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    buffer_.append(bytes, sizeof(T));
+}
+
+// ----- TEXT -----
+
+void ReportWriter::text_structure() {
+    auto put_receivers = [this](const ReceiverPreferences& prefs) {
+        put("  Receivers:\n");
+        auto recs = sorted_receivers(prefs);
         for (const auto& rec : recs) {
-            os << "    " << receiver_type_name(rec.type) << " #" << rec.id << std::endl;
+            put("    ");
+            put(receiver_type_name(rec.type));
+            put(" #");
+            put_number(rec.id);
+            put('\n');
         }
         if (recs.empty()) {
-            os << "    (none)" << std::endl;
+            put("    (none)\n");
         }
-        os << std::endl;
-    }
-    if (!workers.empty()) {
-        os.seekp(-1, std::ios_base::cur);
+    };
+
+    put("== LOADING RAMPS ==\n");
+    for (const auto* ramp : ramps_) {
+        put("LOADING_RAMP #");
+        put_number(ramp->get_id());
+        put("\n  Delivery interval: ");
+        put_number(ramp->get_delivery_interval());
+        put('\n');
+        put_receivers(ramp->receiver_preferences_);
+        put('\n');
     }
 
-    // == STOREHOUSES ==
-    if (!workers.empty()) {
-        os << std::endl;
+    put("== WORKERS ==\n");
+    for (const auto* worker : workers_) {
+        put("WORKER #");
+        put_number(worker->get_id());
+        put("\n  Processing time: ");
+        put_number(worker->get_processing_time());
+        put("\n  Queue type: ");
+        put(to_string(worker->get_queue_type()));
+        put('\n');
+        put_receivers(worker->receiver_preferences_);
+        put('\n');
     }
-    os << "== STOREHOUSES ==" << std::endl;
-    for (const auto* store : stores) {
-        os << "STOREHOUSE #" << store->get_id() << std::endl;
+
+    put("== STOREHOUSES ==\n");
+    for (const auto* store : storehouses_) {
+        put("STOREHOUSE #");
+        put_number(store->get_id());
+        put('\n');
     }
 }
 
-// =========================
-// SIMULATION TURN REPORT
-// =========================
+void ReportWriter::text_turn(Time t) {
+    auto put_packages = [this](const IPackageStockpile* packages) {
+        const std::uint64_t total = package_total(packages);
+        if (total == 0) {
+            put("(empty)\n");
+            return;
+        }
+        bool first = true;
+        for (const auto& package : *packages) {
+            if (!first) put(", ");
+            put('#');
+            put_number(package.get_id());
+            first = false;
+        }
+        // Agregujący magazyn pamięta tylko ostatnie paczki.
+        if (total > packages->size()) {
+            if (!first) put(' ');
+            put('(');
+            put_number(static_cast<std::int64_t>(total));
+            put(" total)");
+        }
+        put('\n');
+    };
+
+    put("=== [ Turn: ");
+    put_number(t);
+    put(" ] ===\n");
+
+    put("== WORKERS ==\n");
+    for (const auto* worker : workers_) {
+        put("WORKER #");
+        put_number(worker->get_id());
 
-void generate_simulation_turn_report(
-    const Factory& f,
-    std::ostream& os,
-    Time t
-) {
-    // Header
-    os << "=== [ Turn: " << t << " ] ===" << std::endl;
-
-    // Collect and sort workers and storehouses by id
-    std::vector<const Worker*> workers;
-    for (const auto& w : f.get_workers()) workers.push_back(&w);
-    std::sort(workers.begin(), workers.end(),
-              [](const Worker* a, const Worker* b) { return a->get_id() < b->get_id(); });
-
-    std::vector<const Storehouse*> stores;
-    for (const auto& s : f.get_storehouses()) stores.push_back(&s);
-    std::sort(stores.begin(), stores.end(),
-              [](const Storehouse* a, const Storehouse* b) { return a->get_id() < b->get_id(); });
-
-    // WORKERS section
-    os << "== WORKERS ==" << std::endl;
-    for (const auto* worker : workers) {
-        os << "WORKER #" << worker->get_id() << std::endl;
-
-        // PBuffer
         const auto& buffer = worker->get_processing_buffer();
         if (buffer.has_value()) {
-            TimeOffset pt = t - worker->get_package_processing_start_time() + 1;
-            os << "  PBuffer: #" << buffer->get_id() << " (pt=" << pt << ")" << std::endl;
+            put("\n  PBuffer: #");
+            put_number(buffer->get_id());
+            put(" (pt=");
+            put_number(t - worker->get_package_processing_start_time() + 1);
+            put(")\n");
         } else {
-            os << "  PBuffer: (empty)" << std::endl;
+            put("\n  PBuffer: (empty)\n");
         }
 
-        // Queue
-        os << "  Queue: ";
-        const auto* q = worker->get_queue();
-        if (q == nullptr || q->begin() == q->end()) {
-            os << "(empty)" << std::endl;
-        } else {
-            bool first = true;
-            for (auto it = q->begin(); it != q->end(); ++it) {
-                if (!first) os << ", ";
-                os << "#" << it->get_id();
-                first = false;
-            }
-            os << std::endl;
-        }
+        put("  Queue: ");
+        put_packages(worker->get_queue());
 
-        // SBuffer (sending buffer)
         const auto& sbuf = worker->get_sending_buffer();
         if (sbuf.has_value()) {
-            os << "  SBuffer: #" << sbuf->get_id() << std::endl;
+            put("  SBuffer: #");
+            put_number(sbuf->get_id());
+            put('\n');
         } else {
-            os << "  SBuffer: (empty)" << std::endl;
+            put("  SBuffer: (empty)\n");
         }
+        put('\n');
+    }
 
-        os << std::endl;
+    put("== STOREHOUSES ==\n");
+    for (const auto* store : storehouses_) {
+        put("STOREHOUSE #");
+        put_number(store->get_id());
+        put("\n  Stock: ");
+        put_packages(&store->get_stock());
     }
-    if (!workers.empty()) {
-        os.seekp(-1, std::ios_base::cur);
+}
+
+// ----- CSV -----
+
+void ReportWriter::csv_structure() {
+    auto put_receivers = [this](const ReceiverPreferences& prefs) {
+        bool first = true;
+        for (const auto& rec : sorted_receivers(prefs)) {
+            if (!first) put(' ');
+            put(receiver_type_name(rec.type));
+            put('-');
+            put_number(rec.id);
+            first = false;
+        }
+        put('\n');
+    };
+
+    put("kind,id,delivery_interval,processing_time,queue_type,receivers\n");
+    for (const auto* ramp : ramps_) {
+        put("ramp,");
+        put_number(ramp->get_id());
+        put(',');
+        put_number(ramp->get_delivery_interval());
+        put(",,,");
+        put_receivers(ramp->receiver_preferences_);
     }
+    for (const auto* worker : workers_) {
+        put("worker,");
+        put_number(worker->get_id());
+        put(",,");
+        put_number(worker->get_processing_time());
+        put(',');
+        put(to_string(worker->get_queue_type()));
+        put(',');
+        put_receivers(worker->receiver_preferences_);
+    }
+    for (const auto* store : storehouses_) {
+        put("storehouse,");
+        put_number(store->get_id());
+        put(",,,,\n");
+    }
+}
+
+void ReportWriter::csv_turn(Time t) {
+    auto put_packages = [this](const IPackageStockpile* packages) {
+        bool first = true;
+        if (packages != nullptr) {
+            for (const auto& package : *packages) {
+                if (!first) put(' ');
+                put_number(package.get_id());
+                first = false;
+            }
+        }
+        put(',');
+        put_number(static_cast<std::int64_t>(package_total(packages)));
+        put('\n');
+    };
 
-    // STOREHOUSES section
-    if (!workers.empty()) {
-        os << std::endl;
+    if (!turn_header_written_) {
+        put("turn,kind,id,processing,processing_time,sending,packages,total\n");
+        turn_header_written_ = true;
     }
-    os << "== STOREHOUSES ==" << std::endl;
-    for (const auto* store : stores) {
-        os << "STOREHOUSE #" << store->get_id() << std::endl;
-        os << "  Stock: ";
 
-        const auto& stock = store->get_stock();
-        if (stock.begin() == stock.end()) {
-            os << "(empty)" << std::endl;
+    for (const auto* worker : workers_) {
+        put_number(t);
+        put(",worker,");
+        put_number(worker->get_id());
+        put(',');
+        const auto& buffer = worker->get_processing_buffer();
+        if (buffer.has_value()) {
+            put_number(buffer->get_id());
+            put(',');
+            put_number(t - worker->get_package_processing_start_time() + 1);
         } else {
-            bool first = true;
-            for (auto it = stock.begin(); it != stock.end(); ++it) {
-                if (!first) os << ", ";
-                os << "#" << it->get_id();
+            put(',');
+        }
+        put(',');
+        if (worker->get_sending_buffer().has_value()) {
+            put_number(worker->get_sending_buffer()->get_id());
+        }
+        put(',');
+        put_packages(worker->get_queue());
+    }
+    for (const auto* store : storehouses_) {
+        put_number(t);
+        put(",storehouse,");
+        put_number(store->get_id());
+        put(",,,,");
+        put_packages(&store->get_stock());
+    }
+}
+
+// ----- JSON lines -----
+
+void ReportWriter::jsonl_structure() {
+    auto put_receivers = [this](const ReceiverPreferences& prefs) {
+        put(",\"receivers\":[");
+        bool first = true;
+        for (const auto& rec : sorted_receivers(prefs)) {
+            if (!first) put(',');
+            put("{\"type\":\"");
+            put(receiver_type_name(rec.type));
+            put("\",\"id\":");
+            put_number(rec.id);
+            put('}');
+            first = false;
+        }
+        put("]}");
+    };
+
+    put("{\"ramps\":[");
+    for (std::size_t i = 0; i < ramps_.size(); ++i) {
+        if (i > 0) put(',');
+        put("{\"id\":");
+        put_number(ramps_[i]->get_id());
+        put(",\"delivery_interval\":");
+        put_number(ramps_[i]->get_delivery_interval());
+        put_receivers(ramps_[i]->receiver_preferences_);
+    }
+    put("],\"workers\":[");
+    for (std::size_t i = 0; i < workers_.size(); ++i) {
+        if (i > 0) put(',');
+        put("{\"id\":");
+        put_number(workers_[i]->get_id());
+        put(",\"processing_time\":");
+        put_number(workers_[i]->get_processing_time());
+        put(",\"queue_type\":\"");
+        put(to_string(workers_[i]->get_queue_type()));
+        put('"');
+        put_receivers(workers_[i]->receiver_preferences_);
+    }
+    put("],\"storehouses\":[");
+    for (std::size_t i = 0; i < storehouses_.size(); ++i) {
+        if (i > 0) put(',');
+        put("{\"id\":");
+        put_number(storehouses_[i]->get_id());
+        put('}');
+    }
+    put("]}\n");
+}
+
+void ReportWriter::jsonl_turn(Time t) {
+    auto put_packages = [this](const IPackageStockpile* packages) {
+        put('[');
+        bool first = true;
+        if (packages != nullptr) {
+            for (const auto& package : *packages) {
+                if (!first) put(',');
+                put_number(package.get_id());
                 first = false;
             }
-            os << std::endl;
         }
+        put(']');
+    };
+    auto put_package = [this](const std::optional<Package>& package) {
+        if (package.has_value()) {
+            put_number(package->get_id());
+        } else {
+            put("null");
+        }
+    };
+
+    put("{\"turn\":");
+    put_number(t);
+    put(",\"workers\":[");
+    for (std::size_t i = 0; i < workers_.size(); ++i) {
+        const auto* worker = workers_[i];
+        if (i > 0) put(',');
+        put("{\"id\":");
+        put_number(worker->get_id());
+        put(",\"processing\":");
+        put_package(worker->get_processing_buffer());
+        if (worker->get_processing_buffer().has_value()) {
+            put(",\"pt\":");
+            put_number(t - worker->get_package_processing_start_time() + 1);
+        }
+        put(",\"queue\":");
+        put_packages(worker->get_queue());
+        put(",\"sending\":");
+        put_package(worker->get_sending_buffer());
+        put('}');
+    }
+    put("],\"storehouses\":[");
+    for (std::size_t i = 0; i < storehouses_.size(); ++i) {
+        const auto& stock = storehouses_[i]->get_stock();
+        if (i > 0) put(',');
+        put("{\"id\":");
+        put_number(storehouses_[i]->get_id());
+        put(",\"stock\":");
+        put_packages(&stock);
+        put(",\"total\":");
+        put_number(static_cast<std::int64_t>(package_total(&stock)));
+        put('}');
+    }
+    put("]}\n");
+}
+
+// ----- BINARY -----
+
+void ReportWriter::binary_structure() {
+    auto put_receivers = [this](const ReceiverPreferences& prefs) {
+        auto recs = sorted_receivers(prefs);
+        put_raw(static_cast<std::uint32_t>(recs.size()));
+        for (const auto& rec : recs) {
+            put_raw(static_cast<std::uint8_t>(rec.type == ReceiverType::STOREHOUSE ? 1 : 0));
+            put_raw(static_cast<std::uint32_t>(rec.id));
+        }
+    };
+
+    put('S');
+    put_raw(static_cast<std::uint32_t>(ramps_.size()));
+    for (const auto* ramp : ramps_) {
+        put_raw(static_cast<std::uint32_t>(ramp->get_id()));
+        put_raw(static_cast<std::int64_t>(ramp->get_delivery_interval()));
+        put_receivers(ramp->receiver_preferences_);
+    }
+    put_raw(static_cast<std::uint32_t>(workers_.size()));
+    for (const auto* worker : workers_) {
+        put_raw(static_cast<std::uint32_t>(worker->get_id()));
+        put_raw(static_cast<std::int64_t>(worker->get_processing_time()));
+        put_raw(static_cast<std::uint8_t>(worker->get_queue_type() == PackageQueueType::LIFO ? 1 : 0));
+        put_receivers(worker->receiver_preferences_);
+    }
+    put_raw(static_cast<std::uint32_t>(storehouses_.size()));
+    for (const auto* store : storehouses_) {
+        put_raw(static_cast<std::uint32_t>(store->get_id()));
+    }
+}
+
+void ReportWriter::binary_turn(Time t) {
+    auto put_packages = [this](const IPackageStockpile* packages) {
+        if (packages == nullptr) {
+            put_raw(std::uint32_t{0});
+            return;
+        }
+        put_raw(static_cast<std::uint32_t>(packages->size()));
+        for (const auto& package : *packages) {
+            put_raw(static_cast<std::uint32_t>(package.get_id()));
+        }
+    };
+    auto package_id = [](const std::optional<Package>& package) {
+        return static_cast<std::uint32_t>(package.has_value() ? package->get_id() : 0);
+    };
+
+    put('T');
+    put_raw(static_cast<std::int64_t>(t));
+    put_raw(static_cast<std::uint32_t>(workers_.size()));
+    for (const auto* worker : workers_) {
+        const auto& buffer = worker->get_processing_buffer();
+        put_raw(static_cast<std::uint32_t>(worker->get_id()));
+        put_raw(package_id(buffer));
+        put_raw(static_cast<std::int64_t>(
+            buffer.has_value() ? t - worker->get_package_processing_start_time() + 1 : 0));
+        put_raw(package_id(worker->get_sending_buffer()));
+        put_packages(worker->get_queue());
     }
+    put_raw(static_cast<std::uint32_t>(storehouses_.size()));
+    for (const auto* store : storehouses_) {
+        const auto& stock = store->get_stock();
+        put_raw(static_cast<std::uint32_t>(store->get_id()));
+        put_raw(package_total(&stock));
+        put_packages(&stock);
+    }
+}
+
+// =========================
+// STRUCTURE / TURN REPORT
+// =========================
+
+void generate_structure_report(const Factory& f, std::ostream& os) {
+    ReportWriter writer(os);
+    writer.write_structure(f);
+}
+
+void generate_simulation_turn_report(
+    const Factory& f,
+    std::ostream& os,
+    Time t
+) {
+    ReportWriter writer(os);
+    writer.write_turn(f, t);
 }
@@ -1,11 +1,98 @@
 #ifndef REPORTS_HXX
 #define REPORTS_HXX
 
+#include <cstdint>
 #include <iosfwd>
+#include <string>
+#include <vector>
 
 #include "factory.hxx"
 #include "types.hxx"
 
+enum class ReportFormat {
+    TEXT,    // human-readable, as generate_*_report()
+    CSV,     // one row per node
+    JSONL,   // one JSON object per report
+    BINARY   // compact records, see ReportWriter
+};
+
+// Generator raportów z buforowaniem.
+//
+// Reports are formatted into a reusable buffer which is written to the
+// stream only when it fills up (or on flush()); nothing is flushed per line.
+// The buffer is reserved at the first report, sized by the node count and
+// capped at buffer_size, so a one-shot writer allocates about what its
+// report needs.
+// The ID-sorted order of nodes is cached and rebuilt only when the factory
+// or its topology version changes - keep one writer across turns to reuse
+// it (generate_*_report() below build a new writer, and sort, every call).
+//
+// BINARY layout (host byte order; package IDs are >= 1, 0 means "none"):
+//   structure: u8 'S', u32 ramp count, per ramp {u32 id, i64 interval,
+//              u32 n, n * (u8 kind, u32 id)}, u32 worker count, per worker
+//              {u32 id, i64 processing time, u8 queue type, u32 n,
+//              n * (u8 kind, u32 id)}, u32 storehouse count, count * u32 id
+//              (kind: 0 = worker, 1 = storehouse; queue type: 0 = FIFO, 1 = LIFO)
+//   turn:      u8 'T', i64 turn, u32 worker count, per worker {u32 id,
+//              u32 processing package, i64 pt, u32 sending package, u32 n,
+//              n * u32 queued package}, u32 storehouse count, per storehouse
+//              {u32 id, u64 total, u32 n, n * u32 stored package}
+class ReportWriter {
+public:
+    explicit ReportWriter(std::ostream& os, ReportFormat format = ReportFormat::TEXT,
+                          std::size_t buffer_size = 1 << 16);
+
+    ReportWriter(const ReportWriter&) = delete;
+    ReportWriter& operator=(const ReportWriter&) = delete;
+
+    // Writes out the buffer (the stream itself is not flushed).
+    ~ReportWriter();
+
+    void write_structure(const Factory& f);
+    void write_turn(const Factory& f, Time t);
+
+    void flush();
+
+    ReportFormat get_format() const { return format_; }
+
+private:
+    std::ostream& os_;
+    ReportFormat format_;
+    std::size_t buffer_size_;
+    std::string buffer_;
+    bool turn_header_written_ = false;
+
+    // Kolejność węzłów (posortowane po ID).
+    const Factory* cached_factory_ = nullptr;
+    std::uint64_t cached_version_ = 0;
+    std::vector<const Ramp*> ramps_;
+    std::vector<const Worker*> workers_;
+    std::vector<const Storehouse*> storehouses_;
+
+    void update_order(const Factory& f);
+    void reserve_buffer();
+    void commit();
+    void write_buffer();
+
+    void text_structure();
+    void text_turn(Time t);
+    void csv_structure();
+    void csv_turn(Time t);
+    void jsonl_structure();
+    void jsonl_turn(Time t);
+    void binary_structure();
+    void binary_turn(Time t);
+
+    void put(char c) { buffer_.push_back(c); }
+    void put(const char* s) { buffer_.append(s); }
+    void put(const std::string& s) { buffer_.append(s); }
+    void put_number(std::int64_t value);
+    template <typename T>
+    void put_raw(T value);
+};
+
+// Jednorazowe raporty tekstowe; for reports in every turn keep a
+// ReportWriter instead.
 void generate_structure_report(const Factory& f, std::ostream& os);
 
 void generate_simulation_turn_report(
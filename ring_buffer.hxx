@@ -0,0 +1,173 @@
+#pragma once
+#ifndef RING_BUFFER_HXX
+#define RING_BUFFER_HXX
+
+#include <compare>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <utility>
+
+// Growable circular buffer used as package storage (FIFO and LIFO queues).
+//
+// Elements live in one contiguous block whose capacity is a power of two;
+// the block doubles when full and is never shrunk, so a queue which has
+// reached its working size pushes and pops without allocating. The block
+// comes from a std::pmr::memory_resource (the default resource unless one
+// is given); a moved buffer keeps its resource.
+template <typename T>
+class RingBuffer {
+public:
+    class const_iterator {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+
+        const_iterator() = default;
+
+        reference operator*() const { return (*buffer_)[pos_]; }
+        pointer operator->() const { return &(*buffer_)[pos_]; }
+        reference operator[](difference_type n) const { return (*buffer_)[pos_ + n]; }
+
+        const_iterator& operator++() { ++pos_; return *this; }
+        const_iterator operator++(int) { auto tmp = *this; ++pos_; return tmp; }
+        const_iterator& operator--() { --pos_; return *this; }
+        const_iterator operator--(int) { auto tmp = *this; --pos_; return tmp; }
+
+        const_iterator& operator+=(difference_type n) { pos_ += n; return *this; }
+        const_iterator& operator-=(difference_type n) { pos_ -= n; return *this; }
+        friend const_iterator operator+(const_iterator it, difference_type n) { return it += n; }
+        friend const_iterator operator+(difference_type n, const_iterator it) { return it += n; }
+        friend const_iterator operator-(const_iterator it, difference_type n) { return it -= n; }
+        friend difference_type operator-(const const_iterator& a, const const_iterator& b) {
+            return static_cast<difference_type>(a.pos_) - static_cast<difference_type>(b.pos_);
+        }
+
+        friend bool operator==(const const_iterator& a, const const_iterator& b) { return a.pos_ == b.pos_; }
+        friend auto operator<=>(const const_iterator& a, const const_iterator& b) { return a.pos_ <=> b.pos_; }
+
+    private:
+        friend class RingBuffer;
+
+        const_iterator(const RingBuffer* buffer, std::size_t pos) : buffer_(buffer), pos_(pos) {}
+
+        const RingBuffer* buffer_ = nullptr;
+        std::size_t pos_ = 0;
+    };
+
+    RingBuffer() = default;
+    explicit RingBuffer(std::pmr::memory_resource* resource) : resource_(resource) {}
+
+    RingBuffer(RingBuffer&& other) noexcept
+        : resource_(other.resource_),
+          data_(std::exchange(other.data_, nullptr)),
+          capacity_(std::exchange(other.capacity_, 0)),
+          head_(std::exchange(other.head_, 0)),
+          size_(std::exchange(other.size_, 0)) {}
+
+    RingBuffer& operator=(RingBuffer&& other) noexcept {
+        if (this != &other) {
+            clear();
+            deallocate();
+            resource_ = other.resource_;
+            data_ = std::exchange(other.data_, nullptr);
+            capacity_ = std::exchange(other.capacity_, 0);
+            head_ = std::exchange(other.head_, 0);
+            size_ = std::exchange(other.size_, 0);
+        }
+        return *this;
+    }
+
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
+
+    ~RingBuffer() {
+        clear();
+        deallocate();
+    }
+
+    void push_back(T&& value) {
+        if (size_ == capacity_) {
+            grow();
+        }
+        std::construct_at(slot(size_), std::move(value));
+        ++size_;
+    }
+
+    T& front() { return *slot(0); }
+    T& back() { return *slot(size_ - 1); }
+    const T& front() const { return *slot(0); }
+    const T& back() const { return *slot(size_ - 1); }
+
+    void pop_front() {
+        std::destroy_at(slot(0));
+        head_ = (head_ + 1) & (capacity_ - 1);
+        --size_;
+    }
+
+    void pop_back() {
+        std::destroy_at(slot(size_ - 1));
+        --size_;
+    }
+
+    const T& operator[](std::size_t i) const { return *slot(i); }
+    T& operator[](std::size_t i) { return *slot(i); }
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, size_); }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    std::size_t capacity() const { return capacity_; }
+    std::pmr::memory_resource* resource() const { return resource_; }
+
+    void clear() {
+        while (size_ > 0) {
+            pop_back();
+        }
+        head_ = 0;
+    }
+
+    void reserve(std::size_t n) {
+        while (capacity_ < n) {
+            grow();
+        }
+    }
+
+private:
+    std::pmr::memory_resource* resource_ = std::pmr::get_default_resource();
+    T* data_ = nullptr;
+    std::size_t capacity_ = 0;
+    std::size_t head_ = 0;
+    std::size_t size_ = 0;
+
+    T* slot(std::size_t i) const { return data_ + ((head_ + i) & (capacity_ - 1)); }
+
+    void grow() {
+        const std::size_t new_capacity = capacity_ == 0 ? 16 : capacity_ * 2;
+        T* new_data = static_cast<T*>(resource_->allocate(new_capacity * sizeof(T), alignof(T)));
+        for (std::size_t i = 0; i < size_; ++i) {
+            std::construct_at(new_data + i, std::move(*slot(i)));
+            std::destroy_at(slot(i));
+        }
+        deallocate();
+        data_ = new_data;
+        capacity_ = new_capacity;
+        head_ = 0;
+    }
+
+    void deallocate() {
+        if (data_ != nullptr) {
+            resource_->deallocate(data_, capacity_ * sizeof(T), alignof(T));
+            data_ = nullptr;
+        }
+    }
+};
+
+#endif // RING_BUFFER_HXX
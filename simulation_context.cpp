@@ -0,0 +1,32 @@
+#include "simulation_context.hxx"
+
+namespace {
+
+thread_local SimulationContext* active_context = nullptr;
+
+} // unnamed namespace
+
+SimulationContext::SimulationContext() : rng_(std::random_device{}()) {}
+
+void SimulationContext::seed(std::uint64_t seed) {
+    std::seed_seq seq{static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32)};
+    rng_.seed(seq);
+}
+
+SimulationContext& SimulationContext::current() {
+    return active_context != nullptr ? *active_context : default_context();
+}
+
+SimulationContext& SimulationContext::default_context() {
+    static SimulationContext context;
+    return context;
+}
+
+SimulationContext::Scope::Scope(SimulationContext& context)
+    : previous_(active_context) {
+    active_context = &context;
+}
+
+SimulationContext::Scope::~Scope() {
+    active_context = previous_;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#ifndef SIMULATION_CONTEXT_HXX
+#define SIMULATION_CONTEXT_HXX
+
+#include "id_pool.hxx"
+#include "types.hxx"
+#include <cstdint>
+#include <random>
+
+class ITraceSink;
+
+// State shared by all nodes of one simulation: the package ID pool and the
+// random number generator behind default_probability_generator().
+//
+// Every Factory owns its own context, so independent simulations (also on
+// different threads) never share IDs or random streams. Packages created with
+// Package() and the default probability generator use the context active on
+// the current thread (see Scope); when none is active the process-wide
+// default context is used.
+class SimulationContext {
+public:
+    // The generator is seeded from std::random_device.
+    SimulationContext();
+
+    SimulationContext(const SimulationContext&) = delete;
+    SimulationContext& operator=(const SimulationContext&) = delete;
+
+    IdPool& id_pool() { return id_pool_; }
+    const IdPool& id_pool() const { return id_pool_; }
+
+    std::mt19937& rng() { return rng_; }
+    const std::mt19937& rng() const { return rng_; }
+    // Restarts the random stream from the given seed.
+    void seed(std::uint64_t seed);
+
+    // Turn currently being simulated (0 outside of a simulation); used by
+    // counter-based probability generators.
+    Time current_turn() const { return current_turn_; }
+    void set_current_turn(Time t) { current_turn_ = t; }
+
+    // Sink receiving the event trace (nullptr = tracing off). Not owned.
+    ITraceSink* trace() const { return trace_; }
+    void set_trace(ITraceSink* sink) { trace_ = sink; }
+
+    // Context active on the calling thread.
+    static SimulationContext& current();
+    static SimulationContext& default_context();
+
+    // Makes a context current for the lifetime of the Scope object.
+    class Scope {
+    public:
+        explicit Scope(SimulationContext& context);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        SimulationContext* previous_;
+    };
+
+private:
+    IdPool id_pool_;
+    std::mt19937 rng_;
+    Time current_turn_ = 0;
+    ITraceSink* trace_ = nullptr;
+};
+
+#endif // SIMULATION_CONTEXT_HXX
@@ -0,0 +1,861 @@
+#include "simulation_image.hxx"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#include "counter_rng.hxx"
+#include "factory.hxx"
+#include "helpers.hxx"
+#include "nodes.hxx"
+#include "simulation_context.hxx"
+#include "thread_pool.hxx"
+
+namespace {
+
+// Removes all packages from a queue, returning them in storage order
+// (the order in which the queue iterates them).
+std::vector<Package> drain_queue(IPackageQueue& q) {
+    std::vector<Package> packages;
+    packages.reserve(q.size());
+    while (!q.empty()) {
+        packages.push_back(q.pop());
+    }
+    if (q.get_queue_type() == PackageQueueType::LIFO) {
+        std::reverse(packages.begin(), packages.end());
+    }
+    return packages;
+}
+
+} // unnamed namespace
+
+SimulationImage::SimulationImage(Factory& factory, unsigned threads) : factory_(factory) {
+    auto& ramps = factory.ramps_;
+    auto& workers = factory.workers_;
+    auto& stores = factory.storehouses_;
+
+    ramp_count_ = ramps.size();
+    const std::size_t sender_count = ramps.size() + workers.size();
+
+    delivery_interval_.reserve(ramps.size());
+    batch_size_.reserve(ramps.size());
+    for (const auto& r : ramps) {
+        delivery_interval_.push_back(r.get_delivery_interval());
+        batch_size_.push_back(r.get_batch_size());
+    }
+    ramp_batch_.resize(ramps.size());
+
+    processing_duration_.reserve(workers.size());
+    lifo_.reserve(workers.size());
+    for (const auto& w : workers) {
+        processing_duration_.push_back(w.get_processing_duration());
+        lifo_.push_back(w.get_queue_type() == PackageQueueType::LIFO);
+    }
+    start_time_.resize(workers.size());
+    last_work_turn_.resize(workers.size(), 0);
+    queue_.resize(workers.size());
+    processing_buffer_.resize(workers.size());
+
+    for (auto& s : stores) {
+        storehouses_.push_back(&s);
+        aggregates_.push_back(dynamic_cast<AggregateStockpile*>(s.d_.get()));
+    }
+
+    // Receivers are resolved to typed indices through the collections' ID index.
+    auto resolve = [&](IPackageReceiver* receiver) {
+        if (receiver->get_receiver_type() == ReceiverType::WORKER) {
+            auto it = workers.find_by_id(receiver->get_id());
+            if (it != workers.end() && static_cast<IPackageReceiver*>(&*it) == receiver) {
+                return ReceiverRef{ReceiverKind::WORKER, static_cast<std::uint32_t>(it - workers.begin())};
+            }
+        } else {
+            auto it = stores.find_by_id(receiver->get_id());
+            if (it != stores.end() && static_cast<IPackageReceiver*>(&*it) == receiver) {
+                return ReceiverRef{ReceiverKind::STOREHOUSE, static_cast<std::uint32_t>(it - stores.begin())};
+            }
+        }
+        throw std::logic_error("Receiver does not belong to the factory");
+    };
+
+    preferences_.reserve(sender_count);
+    sender_id_.reserve(sender_count);
+    for (auto& r : ramps) {
+        preferences_.push_back(&r.receiver_preferences_);
+        sender_id_.push_back(r.get_id());
+    }
+    for (auto& w : workers) {
+        preferences_.push_back(&w.receiver_preferences_);
+        sender_id_.push_back(w.get_id());
+    }
+
+    link_offset_.reserve(sender_count + 1);
+    link_offset_.push_back(0);
+    for (const auto* prefs : preferences_) {
+        for (const auto& [receiver, _] : prefs->get_preferences()) {
+            link_target_.push_back(resolve(receiver));
+        }
+        link_offset_.push_back(static_cast<std::uint32_t>(link_target_.size()));
+    }
+
+    sending_buffer_.resize(sender_count);
+    ramp_delivered_.resize(ramps.size());
+    sender_metrics_.resize(sender_count);
+    worker_metrics_.resize(workers.size());
+#ifdef NETSIM_PACKAGE_METADATA
+    wait_times_.resize(workers.size());
+#endif
+
+    if (threads > 1) {
+        pool_ = std::make_unique<ThreadPool>(threads);
+        partitions_ = pool_->size();
+        choice_.resize(sender_count);
+        outbox_.resize(partitions_ * partitions_);
+        store_outbox_.resize(partitions_);
+        dropped_.resize(partitions_);
+    }
+
+    trace_ = factory.get_context().trace();
+    if (trace_ && pool_) {
+        trace_buffer_.resize(partitions_);
+    }
+
+    load();
+}
+
+SimulationImage::~SimulationImage() {
+    if (loaded_) {
+        store();
+    }
+}
+
+void SimulationImage::load() {
+    std::size_t s = 0;
+    for (auto& r : factory_.ramps_) {
+        ramp_delivered_[s] = r.delivered_;
+        sender_metrics_[s] = r.sender_metrics_;
+        std::swap(ramp_batch_[s].packages, r.batch_);
+        sending_buffer_[s++] = std::exchange(r.bufor_, std::nullopt);
+    }
+
+    std::size_t w = 0;
+    for (auto& worker : factory_.workers_) {
+        worker_metrics_[w] = worker.metrics_;
+#ifdef NETSIM_PACKAGE_METADATA
+        wait_times_[w] = std::move(worker.wait_times_);
+#endif
+        sender_metrics_[s] = worker.sender_metrics_;
+        start_time_[w] = worker.t_;
+        processing_buffer_[w] = std::exchange(worker.bufor_, std::nullopt);
+        sending_buffer_[s++] = std::exchange(worker.PackageSender::bufor_, std::nullopt);
+
+        queue_[w].clear();
+        for (auto& p : drain_queue(*worker.q_)) {
+            queue_[w].push_back(std::move(p));
+        }
+        ++w;
+    }
+    loaded_ = true;
+}
+
+void SimulationImage::store() {
+    std::size_t s = 0;
+    for (auto& r : factory_.ramps_) {
+        r.delivered_ = ramp_delivered_[s];
+        r.sender_metrics_ = sender_metrics_[s];
+        std::swap(ramp_batch_[s].packages, r.batch_);
+        r.bufor_ = std::exchange(sending_buffer_[s++], std::nullopt);
+    }
+
+    std::size_t w = 0;
+    for (auto& worker : factory_.workers_) {
+        worker.metrics_ = worker_metrics_[w];
+#ifdef NETSIM_PACKAGE_METADATA
+        worker.wait_times_ = std::move(wait_times_[w]);
+#endif
+        worker.sender_metrics_ = sender_metrics_[s];
+        worker.t_ = start_time_[w];
+        worker.bufor_ = std::exchange(processing_buffer_[w], std::nullopt);
+        worker.PackageSender::bufor_ = std::exchange(sending_buffer_[s++], std::nullopt);
+
+        auto& q = queue_[w];
+        while (!q.empty()) {
+            worker.q_->push(std::move(q.front()));
+            q.pop_front();
+        }
+        ++w;
+    }
+    loaded_ = false;
+}
+
+void SimulationImage::emit(std::size_t part, TraceEvent event, TraceNode node_kind, ElementID node,
+                           const Package& package) {
+    const TraceRecord record = make_trace_record(
+        factory_.get_context().current_turn(), package.get_id(), node, event, node_kind);
+    if (pool_) {
+        trace_buffer_[part].push_back(record);
+    } else {
+        trace_->record(record);
+    }
+}
+
+void SimulationImage::emit_send(std::size_t part, std::size_t s) {
+    emit(part, TraceEvent::SEND, s < ramp_count_ ? TraceNode::RAMP : TraceNode::WORKER,
+         sender_id_[s], *sending_buffer_[s]);
+}
+
+void SimulationImage::flush_trace() {
+    for (auto& records : trace_buffer_) {
+        for (const auto& record : records) {
+            trace_->record(record);
+        }
+        records.clear();
+    }
+}
+
+void SimulationImage::deliver_goods(std::size_t r) {
+    sending_buffer_[r].emplace();
+    if (trace_) {
+        emit(0, TraceEvent::DELIVERY, TraceNode::RAMP, sender_id_[r], *sending_buffer_[r]);
+    }
+    auto& rest = ramp_batch_[r].packages;
+    for (std::size_t k = 1; k < batch_size_[r]; ++k) {
+        rest.emplace_back();
+        if (trace_) {
+            emit(0, TraceEvent::DELIVERY, TraceNode::RAMP, sender_id_[r], rest.back());
+        }
+    }
+    ramp_delivered_[r] += batch_size_[r];
+}
+
+// Counter draws only in the multithreaded send phase, like single packages.
+void SimulationImage::draw_batch(std::size_t r, Time t) {
+    RampBatch& batch = ramp_batch_[r];
+    const std::size_t n = 1 + batch.packages.size();
+    batch.choices.clear();
+    for (std::size_t k = 0; k < n; ++k) {
+        batch.choices.push_back(pool_ && counter_seed_
+            ? preferences_[r]->index_for(counter_probability(*counter_seed_, true, sender_id_[r], t,
+                                                             static_cast<std::uint32_t>(k)))
+            : preferences_[r]->choose_index());
+    }
+}
+
+// route(i, package) gets every package of the batch in delivery order;
+// i == npos means the package has no receiver.
+template <typename Route>
+void SimulationImage::send_batch(std::size_t r, std::size_t part, Route&& route) {
+    RampBatch& batch = ramp_batch_[r];
+    auto package_at = [&](std::size_t k) -> Package& {
+        return k == 0 ? *sending_buffer_[r] : batch.packages[k - 1];
+    };
+
+    if (trace_) {
+        for (std::size_t k = 0; k < batch.choices.size(); ++k) {
+            emit(part, TraceEvent::SEND, TraceNode::RAMP, sender_id_[r], package_at(k));
+        }
+    }
+    group_batch(batch.choices, batch.order);
+    for (std::uint32_t k : batch.order) {
+        const std::size_t i = batch.choices[k];
+        ++(i == ReceiverPreferences::npos ? sender_metrics_[r].dropped : sender_metrics_[r].sent);
+        route(i, std::move(package_at(k)));
+    }
+    sending_buffer_[r].reset();
+    batch.packages.clear();
+}
+
+void SimulationImage::deliver(ReceiverRef target, Package&& package, std::size_t part) {
+    if (target.kind == ReceiverKind::WORKER) {
+        if (trace_) {
+            emit(part, TraceEvent::QUEUE_PUSH, TraceNode::WORKER, sender_id_[ramp_count_ + target.index], package);
+        }
+        const Time t = factory_.get_context().current_turn();
+#ifdef NETSIM_PACKAGE_METADATA
+        package.arrived(t);
+#endif
+        auto& q = queue_[target.index];
+        q.push_back(std::move(package));
+        worker_metrics_[target.index].package_received(t, q.size());
+    } else {
+        storehouses_[target.index]->Storehouse::receive_package(std::move(package));
+    }
+}
+
+void SimulationImage::work(std::size_t w, Time t, std::size_t part) {
+    auto& q = queue_[w];
+    auto& buffer = processing_buffer_[w];
+    const ElementID id = sender_id_[ramp_count_ + w];
+
+    auto take_next = [&]() {
+        if (lifo_[w]) {
+            buffer.emplace(std::move(q.back()));
+            q.pop_back();
+        } else {
+            buffer.emplace(std::move(q.front()));
+            q.pop_front();
+        }
+        start_time_[w] = t;
+#ifdef NETSIM_PACKAGE_METADATA
+        wait_times_[w].record(static_cast<std::uint64_t>(buffer->dequeued(t)));
+#endif
+        if (trace_) {
+            emit(part, TraceEvent::PROCESSING_START, TraceNode::WORKER, id, *buffer);
+        }
+    };
+
+    if (!buffer && !q.empty()) {
+        take_next();
+        worker_metrics_[w].turn_worked(t, true, true, q.size(), false);
+    } else if (buffer && t - start_time_[w] + 1 == processing_duration_[w]) {
+        if (trace_) {
+            emit(part, TraceEvent::PROCESSING_FINISH, TraceNode::WORKER, id, *buffer);
+        }
+        sending_buffer_[ramp_count_ + w] = std::move(buffer);
+        buffer.reset();
+
+        if (!q.empty()) {
+            take_next();
+        }
+        worker_metrics_[w].turn_worked(t, true, buffer.has_value(), q.size(), true);
+    }
+}
+
+void SimulationImage::run_turn(Time t) {
+    factory_.get_context().set_current_turn(t);
+    if (pool_) {
+        run_turn_parallel(t);
+        return;
+    }
+
+    // Dostawy
+    for (std::size_t r = 0; r < ramp_count_; ++r) {
+        if ((t - 1) % delivery_interval_[r] == 0) {
+            deliver_goods(r);
+        }
+    }
+
+    // Przekazywanie paczek
+    for (std::size_t s = 0; s < sending_buffer_.size(); ++s) {
+        auto& buffer = sending_buffer_[s];
+        if (!buffer) {
+            continue;
+        }
+        if (has_batch(s)) {
+            draw_batch(s, t);
+            send_batch(s, 0, [&](std::size_t i, Package&& package) {
+                if (i != ReceiverPreferences::npos) {
+                    deliver(link_target_[link_offset_[s] + i], std::move(package));
+                }
+            });
+            continue;
+        }
+        if (trace_) {
+            emit_send(0, s);
+        }
+        const std::size_t i = preferences_[s]->choose_index();
+        if (i != ReceiverPreferences::npos) {
+            deliver(link_target_[link_offset_[s] + i], std::move(*buffer));
+            ++sender_metrics_[s].sent;
+        } else {
+            ++sender_metrics_[s].dropped;
+        }
+        buffer.reset();
+    }
+
+    // Przetwarzanie
+    for (std::size_t w = 0; w < queue_.size(); ++w) {
+        work(w, t);
+    }
+}
+
+std::size_t SimulationImage::worker_partition(std::uint32_t w) const {
+    return static_cast<std::size_t>(w) * partitions_ / queue_.size();
+}
+
+void SimulationImage::run_turn_parallel(Time t) {
+    const std::size_t senders = sending_buffer_.size();
+    const std::size_t workers = queue_.size();
+
+    // Dostawy (serial: new IDs come from the pool)
+    for (std::size_t r = 0; r < ramp_count_; ++r) {
+        if ((t - 1) % delivery_interval_[r] == 0) {
+            deliver_goods(r);
+        }
+    }
+    if (trace_) {
+        flush_trace();
+    }
+
+    // Losowanie odbiorców (serial: generators are shared and stateful);
+    // packages without a receiver are dropped here as well. Counter-based
+    // draws are made in the send phase instead.
+    if (!counter_seed_) {
+        for (std::size_t s = 0; s < senders; ++s) {
+            if (!sending_buffer_[s]) {
+                continue;
+            }
+            if (has_batch(s)) {
+                draw_batch(s, t);
+                continue;
+            }
+            choice_[s] = preferences_[s]->choose_index();
+            if (choice_[s] == ReceiverPreferences::npos) {
+                if (trace_) {
+                    emit_send(0, s);
+                }
+                sending_buffer_[s].reset();
+                ++sender_metrics_[s].dropped;
+            }
+        }
+    }
+
+    // Wysyłka: each partition stages the packages of its sender range.
+    pool_->run(partitions_, [&](std::size_t p) {
+        const std::size_t begin = p * senders / partitions_;
+        const std::size_t end = (p + 1) * senders / partitions_;
+        for (std::size_t s = begin; s < end; ++s) {
+            auto& buffer = sending_buffer_[s];
+            if (!buffer) {
+                continue;
+            }
+            if (has_batch(s)) {
+                if (counter_seed_) {
+                    draw_batch(s, t);
+                }
+                send_batch(s, p, [&](std::size_t i, Package&& package) {
+                    if (i == ReceiverPreferences::npos) {
+                        dropped_[p].push_back(std::move(package));
+                        return;
+                    }
+                    const ReceiverRef target = link_target_[link_offset_[s] + i];
+                    auto& box = (target.kind == ReceiverKind::WORKER)
+                        ? outbox_[p * partitions_ + worker_partition(target.index)]
+                        : store_outbox_[p];
+                    box.push_back(StagedPackage{target, std::move(package)});
+                });
+                continue;
+            }
+            if (trace_) {
+                emit_send(p, s);
+            }
+            if (counter_seed_) {
+                choice_[s] = preferences_[s]->index_for(
+                    counter_probability(*counter_seed_, s < ramp_count_, sender_id_[s], t));
+                if (choice_[s] == ReceiverPreferences::npos) {
+                    dropped_[p].push_back(std::move(*buffer));
+                    buffer.reset();
+                    ++sender_metrics_[s].dropped;
+                    continue;
+                }
+            }
+            const ReceiverRef target = link_target_[link_offset_[s] + choice_[s]];
+            auto& box = (target.kind == ReceiverKind::WORKER)
+                ? outbox_[p * partitions_ + worker_partition(target.index)]
+                : store_outbox_[p];
+            box.push_back(StagedPackage{target, std::move(*buffer)});
+            buffer.reset();
+            ++sender_metrics_[s].sent;
+        }
+    });
+
+    for (auto& packages : dropped_) {
+        packages.clear();
+    }
+    if (trace_) {
+        flush_trace();
+    }
+
+    // Zatwierdzenie: each worker partition takes its outboxes in sender order.
+    pool_->run(partitions_, [&](std::size_t p) {
+        for (std::size_t sp = 0; sp < partitions_; ++sp) {
+            auto& box = outbox_[sp * partitions_ + p];
+            for (auto& staged : box) {
+                deliver(staged.target, std::move(staged.package), p);
+            }
+            box.clear();
+        }
+    });
+    if (trace_) {
+        flush_trace();
+    }
+    for (auto& box : store_outbox_) {
+        for (auto& staged : box) {
+            deliver(staged.target, std::move(staged.package));
+        }
+        box.clear();
+    }
+
+    // Przetwarzanie
+    pool_->run(partitions_, [&](std::size_t p) {
+        const std::size_t begin = p * workers / partitions_;
+        const std::size_t end = (p + 1) * workers / partitions_;
+        for (std::size_t w = begin; w < end; ++w) {
+            work(w, t, p);
+        }
+    });
+    if (trace_) {
+        flush_trace();
+    }
+}
+
+void SimulationImage::schedule_events(Time first_turn) {
+    events_ = {};
+    pending_senders_.clear();
+    current_turn_ = first_turn - 1;
+
+    for (std::size_t r = 0; r < ramp_count_; ++r) {
+        // Deliveries happen in turns 1 + k * di.
+        const TimeOffset di = delivery_interval_[r];
+        const Time k = (first_turn - 1 + di - 1) / di;
+        events_.push(Event{1 + k * di, static_cast<std::uint32_t>(r)});
+    }
+
+    for (std::size_t w = 0; w < queue_.size(); ++w) {
+        const auto sender = static_cast<std::uint32_t>(ramp_count_ + w);
+        if (!processing_buffer_[w]) {
+            if (!queue_[w].empty()) {
+                events_.push(Event{first_turn, sender});
+            }
+        } else {
+            // A completion turn which has already passed never comes again.
+            const Time done = start_time_[w] + processing_duration_[w] - 1;
+            if (done >= first_turn) {
+                events_.push(Event{done, sender});
+            }
+        }
+    }
+
+    for (std::size_t s = 0; s < sending_buffer_.size(); ++s) {
+        if (sending_buffer_[s]) {
+            pending_senders_.push_back(static_cast<std::uint32_t>(s));
+        }
+    }
+}
+
+Time SimulationImage::next_event_turn() const {
+    if (!pending_senders_.empty()) {
+        return current_turn_ + 1;
+    }
+    if (!events_.empty()) {
+        return events_.top().turn;
+    }
+    return std::numeric_limits<Time>::max();
+}
+
+void SimulationImage::run_event_turn(Time t) {
+    factory_.get_context().set_current_turn(t);
+    current_turn_ = t;
+    due_workers_.clear();
+
+    // Dostawy (ramps pop in index order, so IDs are assigned as in run_turn)
+    // and workers scheduled for this turn.
+    while (!events_.empty() && events_.top().turn == t) {
+        const std::uint32_t s = events_.top().sender;
+        events_.pop();
+        if (s < ramp_count_) {
+            deliver_goods(s);
+            pending_senders_.push_back(s);
+            events_.push(Event{t + delivery_interval_[s], s});
+        } else {
+            due_workers_.push_back(static_cast<std::uint32_t>(s - ramp_count_));
+        }
+    }
+
+    // Przekazywanie paczek - in sender order, like the full scan.
+    std::sort(pending_senders_.begin(), pending_senders_.end());
+    for (std::uint32_t s : pending_senders_) {
+        auto& buffer = sending_buffer_[s];
+        if (has_batch(s)) {
+            draw_batch(s, t);
+            send_batch(s, 0, [&](std::size_t i, Package&& package) {
+                if (i == ReceiverPreferences::npos) {
+                    return;
+                }
+                const ReceiverRef target = link_target_[link_offset_[s] + i];
+                if (target.kind == ReceiverKind::WORKER) {
+                    due_workers_.push_back(target.index);
+                }
+                deliver(target, std::move(package));
+            });
+            continue;
+        }
+        if (trace_) {
+            emit_send(0, s);
+        }
+        const std::size_t i = preferences_[s]->choose_index();
+        if (i != ReceiverPreferences::npos) {
+            const ReceiverRef target = link_target_[link_offset_[s] + i];
+            if (target.kind == ReceiverKind::WORKER) {
+                due_workers_.push_back(target.index);
+            }
+            deliver(target, std::move(*buffer));
+            ++sender_metrics_[s].sent;
+        } else {
+            ++sender_metrics_[s].dropped;
+        }
+        buffer.reset();
+    }
+    pending_senders_.clear();
+
+    // Przetwarzanie - workers are independent of each other in this phase;
+    // with tracing on they go in index order so that records match run_turn().
+    if (trace_) {
+        std::sort(due_workers_.begin(), due_workers_.end());
+    }
+    for (std::uint32_t w : due_workers_) {
+        if (last_work_turn_[w] == t) {
+            continue;
+        }
+        last_work_turn_[w] = t;
+
+        work(w, t);
+
+        const auto sender = static_cast<std::uint32_t>(ramp_count_ + w);
+        if (sending_buffer_[sender]) {
+            pending_senders_.push_back(sender);
+        }
+        if (processing_buffer_[w] && start_time_[w] == t) {
+            const Time done = t + processing_duration_[w] - 1;
+            if (done > t) {
+                events_.push(Event{done, sender});
+            }
+        }
+    }
+}
+
+bool SimulationImage::can_fast_forward() const {
+#ifdef NETSIM_PACKAGE_METADATA
+    return false;
+#else
+    if (trace_) {
+        return false;
+    }
+    for (std::size_t s = 0; s + 1 < link_offset_.size(); ++s) {
+        if (link_offset_[s + 1] - link_offset_[s] > 1) {
+            return false;
+        }
+    }
+    return std::none_of(aggregates_.begin(), aggregates_.end(),
+                        [](const AggregateStockpile* stock) { return stock == nullptr; });
+#endif
+}
+
+// Variable-length parts are preceded by their length, so equal encodings
+// mean equal states. Without package_ids only the lengths, phases and buffer
+// occupancy are encoded (the signature, O(nodes)). Worker metrics must be
+// settled up to t.
+void SimulationImage::encode_state(Time t, std::vector<std::uint64_t>& state, bool package_ids) const {
+    auto put_package = [&state, package_ids](const std::optional<Package>& package) {
+        state.push_back(!package ? 0 : package_ids ? static_cast<std::uint64_t>(package->get_id()) : 1);
+    };
+    auto put_packages = [&state, package_ids](const auto& packages) {
+        state.push_back(packages.size());
+        if (package_ids) {
+            for (const auto& package : packages) {
+                state.push_back(static_cast<std::uint64_t>(package.get_id()));
+            }
+        }
+    };
+
+    state.clear();
+    for (std::size_t r = 0; r < ramp_count_; ++r) {
+        state.push_back(static_cast<std::uint64_t>(t % delivery_interval_[r]));
+        put_packages(ramp_batch_[r].packages);
+    }
+    for (const auto& package : sending_buffer_) {
+        put_package(package);
+    }
+    for (std::size_t w = 0; w < queue_.size(); ++w) {
+        put_packages(queue_[w]);
+        put_package(processing_buffer_[w]);
+        state.push_back(processing_buffer_[w] ? static_cast<std::uint64_t>(t - start_time_[w]) : 0);
+        state.push_back(worker_metrics_[w].processing());
+        state.push_back(worker_metrics_[w].queue_length());
+    }
+    for (const AggregateStockpile* stock : aggregates_) {
+        state.push_back(stock->delivered_ > 0 ? static_cast<std::uint64_t>(t - stock->last_arrival_) + 1 : 0);
+        put_packages(stock->recent_);
+    }
+}
+
+std::size_t SimulationImage::queued_packages() const {
+    std::size_t queued = 0;
+    for (const auto& queue : queue_) {
+        queued += queue.size();
+    }
+    return queued;
+}
+
+// cycle_signature_ and cycle_state_ must hold the encoding of turn t.
+void SimulationImage::save_cycle_checkpoint(Time t) {
+    cycle_saved_.turn = t;
+    std::swap(cycle_saved_.signature, cycle_signature_);
+    std::swap(cycle_saved_.state, cycle_state_);
+    cycle_saved_.queued = queued_packages();
+    cycle_saved_.ramp_delivered = ramp_delivered_;
+    cycle_saved_.sender_metrics = sender_metrics_;
+    cycle_saved_.worker_metrics = worker_metrics_;
+    cycle_saved_.arrivals.clear();
+    cycle_saved_.histograms.clear();
+    for (std::size_t h = 0; h < storehouses_.size(); ++h) {
+        cycle_saved_.arrivals.push_back(storehouses_[h]->arrivals_);
+        cycle_saved_.histograms.push_back(aggregates_[h]->histogram_);
+    }
+}
+
+// Counters grow by cycles times their growth since the saved turn; absolute
+// turns (worker start, last arrival, metrics) move by cycles * period.
+void SimulationImage::skip_periods(std::uint64_t cycles, TimeOffset period) {
+    const auto shift = static_cast<Time>(cycles) * period;
+    auto grow = [cycles](std::uint64_t& now, std::uint64_t then) { now += cycles * (now - then); };
+
+    for (std::size_t r = 0; r < ramp_count_; ++r) {
+        grow(ramp_delivered_[r], cycle_saved_.ramp_delivered[r]);
+    }
+    for (std::size_t s = 0; s < sender_metrics_.size(); ++s) {
+        grow(sender_metrics_[s].sent, cycle_saved_.sender_metrics[s].sent);
+        grow(sender_metrics_[s].dropped, cycle_saved_.sender_metrics[s].dropped);
+    }
+    for (std::size_t w = 0; w < queue_.size(); ++w) {
+        worker_metrics_[w].extrapolate(cycle_saved_.worker_metrics[w], cycles, period);
+        if (processing_buffer_[w]) {
+            start_time_[w] += shift;
+        }
+    }
+    for (std::size_t h = 0; h < storehouses_.size(); ++h) {
+        AggregateStockpile& stock = *aggregates_[h];
+        const std::uint64_t arrivals = storehouses_[h]->arrivals_ - cycle_saved_.arrivals[h];
+        storehouses_[h]->arrivals_ += cycles * arrivals;
+        stock.delivered_ += cycles * arrivals;
+        for (std::size_t k = 0; k < AggregateStockpile::histogram_buckets; ++k) {
+            grow(stock.histogram_[k], cycle_saved_.histograms[h][k]);
+        }
+        if (stock.delivered_ > 0) {
+            stock.last_arrival_ += shift;
+        }
+    }
+}
+
+Time SimulationImage::fast_forward(Time t, Time horizon) {
+    if (cycle_abandoned_) {
+        return t;
+    }
+    for (auto& metrics : worker_metrics_) {
+        metrics.settle(t);
+    }
+    encode_state(t, cycle_signature_, false);
+
+    bool recurred = false;
+    if (cycle_power_ > 0 && cycle_signature_ == cycle_saved_.signature) {
+        encode_state(t, cycle_state_, true);
+        recurred = cycle_state_ == cycle_saved_.state;
+    }
+    if (recurred) {
+        const TimeOffset period = t - cycle_saved_.turn;
+        const auto cycles = static_cast<std::uint64_t>((horizon - t) / period);
+        if (cycles == 0) {
+            return t;
+        }
+        skip_periods(cycles, period);
+        // The state after the jump recurs after another period (if a report
+        // turn comes in between, the next horizon may allow more jumps).
+        const Time now = t + static_cast<Time>(cycles) * period;
+        save_cycle_checkpoint(now);
+        cycle_power_ = period;
+        cycle_growth_ = 0;
+        return now;
+    }
+
+    if (cycle_power_ == 0 || t - cycle_saved_.turn == cycle_power_) {
+        // Kolejki rosnące przy każdym zapisie nie wrócą do zapisanego stanu.
+        cycle_growth_ = (cycle_power_ > 0 && queued_packages() > cycle_saved_.queued) ? cycle_growth_ + 1 : 0;
+        if (cycle_growth_ == cycle_growth_limit) {
+            cycle_abandoned_ = true;
+            cycle_saved_ = CycleCheckpoint{};
+            return t;
+        }
+        encode_state(t, cycle_state_, true);
+        save_cycle_checkpoint(t);
+        // The power stops doubling before it would overflow TimeOffset.
+        if (cycle_power_ == 0) {
+            cycle_power_ = 1;
+        } else if (cycle_power_ <= std::numeric_limits<TimeOffset>::max() / 2) {
+            cycle_power_ *= 2;
+        }
+    }
+    return t;
+}
+
+void simulate_compiled(
+    Factory& factory,
+    TimeOffset duration,
+    std::function<void(Factory&, Time)> report_function,
+    const ImageSimulationOptions& options
+) {
+    if (!factory.is_consistent()) {
+        throw std::logic_error("Factory network is inconsistent");
+    }
+
+    SimulationContext::Scope scope(factory.get_context());
+    if (options.seed) {
+        use_counter_probability_generators(factory, *options.seed);
+        factory.get_context().seed(*options.seed);
+    }
+    SimulationImage image(factory, options.event_driven ? 1 : options.threads);
+    if (options.seed) {
+        image.set_counter_seed(*options.seed);
+    }
+
+    auto report = [&](Time t) {
+        if (!options.report_turn || options.report_turn(t)) {
+            image.store();
+            report_function(factory, t);
+            image.load();
+        }
+    };
+
+    if (!options.event_driven) {
+        const bool fast_forward = options.fast_forward && options.report_turn && options.next_report_turn
+                                  && image.can_fast_forward();
+        for (Time t = options.first_turn; t <= duration; ++t) {
+            image.run_turn(t);
+            report(t);
+            if (fast_forward && t < duration) {
+                // Skipped turns end before the next report turn.
+                const Time next = options.next_report_turn(t + 1);
+                t = image.fast_forward(t, next <= duration ? next - 1 : Time{duration});
+            }
+        }
+        return;
+    }
+
+    image.schedule_events(options.first_turn);
+    Time t = options.first_turn;
+    while (t <= duration) {
+        const Time next = std::min<Time>(image.next_event_turn(), Time{duration} + 1);
+
+        // Turns without events: the state does not change, only reports are due.
+        if (options.report_turn && options.next_report_turn) {
+            while (t < next) {
+                t = options.next_report_turn(t);
+                if (t >= next) {
+                    break;
+                }
+                report(t);
+                ++t;
+            }
+            t = next;
+        } else {
+            for (; t < next; ++t) {
+                report(t);
+            }
+        }
+
+        if (t > duration) {
+            break;
+        }
+        image.run_event_turn(t);
+        report(t);
+        ++t;
+    }
+}
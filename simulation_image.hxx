@@ -0,0 +1,299 @@
+#pragma once
+#ifndef SIMULATION_IMAGE_HXX
+#define SIMULATION_IMAGE_HXX
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <queue>
+#include <vector>
+
+#include "types.hxx"
+#include "package.hxx"
+#include "metrics.hxx"
+#include "storage_types.hxx"
+#include "trace.hxx"
+
+class Factory;
+class ReceiverPreferences;
+class Storehouse;
+class ThreadPool;
+
+// Skompilowany ("zamrożony") obraz fabryki do szybkiej symulacji.
+//
+// The image keeps the runtime state of a validated Factory in flat arrays:
+// senders are numbered ramps first, then workers (both in factory order),
+// links form a CSR adjacency list and receivers are typed indices instead of
+// IPackageReceiver pointers. Storehouses are sinks, so arriving packages go
+// straight to the factory's Storehouse objects. A ramp's batch is routed
+// in the order of PackageSender::send_package() (group_batch()).
+//
+// Constructing the image takes the packages out of the factory's workers
+// (queues, processing and sending buffers); store() puts the current state
+// back, load() takes it out again.
+//
+// With threads > 1 run_turn() splits every phase across a ThreadPool:
+// workers work on disjoint ranges, senders stage their packages in per-thread
+// outboxes (one per worker partition) and a commit phase moves them into
+// the workers, each partition taking the outboxes in sender order. Packages
+// for storehouses are committed serially afterwards, also in sender order
+// (a stockpile may destroy packages or read the simulation context).
+// Receiver queues thus get exactly the serial order, whatever the number of
+// threads.
+//
+// When the factory's context has a trace sink, the image records the same
+// events as simulate(). In multithreaded mode records of a phase are
+// collected per partition and written after the phase, so within a turn
+// QUEUE_PUSH records are grouped by worker partition.
+// Random draws stay serial because probability generators are stateful,
+// unless a counter seed is set (set_counter_seed()): each sender's draw is
+// then a pure function of (seed, sender, turn) and is computed in the
+// parallel send phase. Dropped packages are always released serially since
+// the ID pool is not thread-safe.
+class SimulationImage {
+public:
+    explicit SimulationImage(Factory& factory, unsigned threads = 1);
+
+    SimulationImage(const SimulationImage&) = delete;
+    SimulationImage& operator=(const SimulationImage&) = delete;
+
+    ~SimulationImage();
+
+    // One turn: deliveries, package passing, work - same order as simulate().
+    void run_turn(Time t);
+
+    // Tryb zdarzeniowy (discrete-event).
+    //
+    // Only turns in which something can happen are executed: ramp deliveries,
+    // sends of filled sending buffers (the turn after they are filled) and
+    // workers which complete a package or receive one while idle. Within such
+    // a turn only the affected nodes are touched, in the same order as in
+    // run_turn(), so the resulting state is identical.
+
+    // Builds the event queue from the current state; first_turn is the next
+    // turn to be simulated.
+    void schedule_events(Time first_turn);
+    // Turn of the next event (the maximum Time value when there is none).
+    Time next_event_turn() const;
+    // Executes the turn returned by next_event_turn().
+    void run_event_turn(Time t);
+
+    void store();
+    void load();
+
+    // Wykrywanie cyklu (full-scan mode).
+    //
+    // With deterministic routing every turn's result depends only on the
+    // state after the previous turn: the packages (by ID, in order) of all
+    // queues and buffers, worker phases relative to their start turn, ramp
+    // delivery phases and the last arrivals of the storehouses. Package IDs
+    // are part of it since the ID pool hands out the lowest free ID, i.e.
+    // its behaviour is fixed by the set of live packages. Once that state
+    // recurs after P turns, every later period of P turns repeats the same
+    // steps and adds the same amounts to the counters, so whole periods can
+    // be skipped by extrapolating the counters.
+    //
+    // Possible when every sender has at most one receiver (draws of the
+    // probability generators, assumed to lie in [0, 1], do not change the
+    // route; the generators are not advanced for skipped turns), every
+    // storehouse keeps an AggregateStockpile (a package queue grows without
+    // bound and never repeats), and neither tracing nor package metadata
+    // (absolute turns in every package) is on.
+    bool can_fast_forward() const;
+
+    // Called after every turn t, starting with the first one. Compares the
+    // state with one saved state (Brent's cycle detection: the saved state is
+    // replaced after 1, 2, 4, ... turns, so a cycle of length P starting
+    // after turn m is found within O(m + P) turns, keeping one copy of the
+    // state). When the state recurs, skips as many whole periods as fit up to
+    // the horizon and returns the turn the image is then at (the next turn
+    // to run is the returned one + 1); otherwise returns t.
+    //
+    // Each turn costs O(nodes): package IDs are compared only when queue
+    // lengths and phases match the saved state. Detection stops for good
+    // once the queues have grown at cycle_growth_limit saves in a row.
+    Time fast_forward(Time t, Time horizon);
+
+    // False once fast_forward() has stopped looking for a cycle.
+    bool is_detecting_cycles() const { return !cycle_abandoned_; }
+
+    // Routing with counter_probability(seed, ...), i.e. the numbers drawn by
+    // counter_probability_generator(seed, ...) installed in the senders.
+    void set_counter_seed(std::uint64_t seed) { counter_seed_ = seed; }
+
+private:
+    enum class ReceiverKind : std::uint8_t {
+        WORKER,
+        STOREHOUSE
+    };
+
+    struct ReceiverRef {
+        ReceiverKind kind;
+        std::uint32_t index;
+    };
+
+    Factory& factory_;
+    bool loaded_ = false;
+
+    // Ramps: senders [0, ramp_count_).
+    std::size_t ramp_count_ = 0;
+    std::vector<TimeOffset> delivery_interval_;
+    std::vector<std::size_t> batch_size_;
+
+    // Packages 2..n of a ramp's sending buffer, with their receivers.
+    struct RampBatch {
+        std::vector<Package> packages;
+        std::vector<std::size_t> choices;
+        std::vector<std::uint32_t> order;
+    };
+    std::vector<RampBatch> ramp_batch_;
+
+    // Workers: senders [ramp_count_, ramp_count_ + worker count).
+    std::vector<TimeOffset> processing_duration_;
+    std::vector<Time> start_time_;
+    std::vector<std::uint8_t> lifo_;
+    std::vector<PackageBuffer> queue_;
+    std::vector<std::optional<Package>> processing_buffer_;
+
+    // All senders.
+    std::vector<ReceiverPreferences*> preferences_;
+    std::vector<ElementID> sender_id_;
+    std::optional<std::uint64_t> counter_seed_;
+    std::vector<std::optional<Package>> sending_buffer_;
+    std::vector<std::uint32_t> link_offset_;
+    std::vector<ReceiverRef> link_target_;
+
+    std::vector<Storehouse*> storehouses_;
+
+    // Liczniki węzłów (taken out and put back with the packages).
+    std::vector<std::uint64_t> ramp_delivered_;
+    std::vector<SenderMetrics> sender_metrics_;
+    std::vector<WorkerMetrics> worker_metrics_;
+#ifdef NETSIM_PACKAGE_METADATA
+    std::vector<LatencyHistogram> wait_times_;
+#endif
+
+    // Wykrywanie cyklu: encoded state of the current turn and the saved one
+    // with the counters as of that turn.
+    struct CycleCheckpoint {
+        Time turn = 0;
+        std::vector<std::uint64_t> signature;
+        std::vector<std::uint64_t> state;
+        std::size_t queued = 0;
+        std::vector<std::uint64_t> ramp_delivered;
+        std::vector<SenderMetrics> sender_metrics;
+        std::vector<WorkerMetrics> worker_metrics;
+        std::vector<std::uint64_t> arrivals;
+        std::vector<AggregateStockpile::Histogram> histograms;
+    };
+
+    std::vector<AggregateStockpile*> aggregates_;   // per storehouse, or nullptr
+    std::vector<std::uint64_t> cycle_signature_;
+    std::vector<std::uint64_t> cycle_state_;
+    CycleCheckpoint cycle_saved_;
+    TimeOffset cycle_power_ = 0;                    // 0 = nothing saved yet
+    unsigned cycle_growth_ = 0;                     // saves in a row with longer queues
+    bool cycle_abandoned_ = false;
+
+    static constexpr unsigned cycle_growth_limit = 8;
+
+    void encode_state(Time t, std::vector<std::uint64_t>& state, bool package_ids) const;
+    std::size_t queued_packages() const;
+    void save_cycle_checkpoint(Time t);
+    void skip_periods(std::uint64_t cycles, TimeOffset period);
+
+    // Event queue: (turn, sender). A ramp's event is its next delivery,
+    // a worker's event means do_work() must run for it in that turn.
+    struct Event {
+        Time turn;
+        std::uint32_t sender;
+
+        bool operator>(const Event& other) const {
+            return turn != other.turn ? turn > other.turn : sender > other.sender;
+        }
+    };
+
+    std::priority_queue<Event, std::vector<Event>, std::greater<>> events_;
+    std::vector<std::uint32_t> pending_senders_;
+    std::vector<std::uint32_t> due_workers_;
+    std::vector<Time> last_work_turn_;
+    Time current_turn_ = 0;
+
+    // Wielowątkowość
+    struct StagedPackage {
+        ReceiverRef target;
+        Package package;
+    };
+
+    std::unique_ptr<ThreadPool> pool_;
+    std::size_t partitions_ = 1;
+    std::vector<std::size_t> choice_;
+    std::vector<std::vector<StagedPackage>> outbox_;   // [sender partition][worker partition]
+    std::vector<std::vector<StagedPackage>> store_outbox_;   // [sender partition]
+    std::vector<std::vector<Package>> dropped_;        // [sender partition]
+
+    // Ślad zdarzeń
+    ITraceSink* trace_ = nullptr;
+    std::vector<std::vector<TraceRecord>> trace_buffer_;   // [partition]
+
+    void emit(std::size_t part, TraceEvent event, TraceNode node_kind, ElementID node,
+              const Package& package);
+    void emit_send(std::size_t part, std::size_t s);
+    void flush_trace();
+
+    void deliver_goods(std::size_t r);
+    bool has_batch(std::size_t s) const { return s < ramp_count_ && !ramp_batch_[s].packages.empty(); }
+    void draw_batch(std::size_t r, Time t);
+    template <typename Route>
+    void send_batch(std::size_t r, std::size_t part, Route&& route);
+    void deliver(ReceiverRef target, Package&& package, std::size_t part = 0);
+    void work(std::size_t w, Time t, std::size_t part = 0);
+    void run_turn_parallel(Time t);
+    std::size_t worker_partition(std::uint32_t w) const;
+};
+
+// Ustawienia symulacji na skompilowanym obrazie.
+struct ImageSimulationOptions {
+    // Turns for which report_function is called; the factory is synchronized
+    // with the image only for those turns. Empty = every turn.
+    std::function<bool(Time)> report_turn;
+
+    // Run in discrete-event mode, skipping turns in which nothing happens.
+    bool event_driven = false;
+
+    // Threads used within a turn (full-scan mode only; results do not depend
+    // on the value).
+    unsigned threads = 1;
+
+    // Event-driven mode: smallest report turn >= t (e.g.
+    // IntervalReportNotifier::next_report_turn). When given, idle stretches
+    // are skipped without asking report_turn about every turn.
+    std::function<Time(Time)> next_report_turn;
+
+    // Reproducible routing as in simulate(..., seed): counter-based
+    // generators are installed in the factory's senders. Also lets the
+    // multithreaded mode draw receivers in parallel.
+    std::optional<std::uint64_t> seed;
+
+    // First simulated turn; turns first_turn .. duration are run (e.g. to
+    // resume after a checkpoint taken after turn first_turn - 1).
+    Time first_turn = 1;
+
+    // Full-scan mode: detect a periodic steady state and skip whole periods
+    // (SimulationImage::fast_forward()); the results are those of a full run.
+    // Takes effect only when the factory allows it
+    // (SimulationImage::can_fast_forward()) and report_turn together with
+    // next_report_turn are given - no report turn is skipped.
+    bool fast_forward = false;
+};
+
+// Same semantics and turn reports as simulate(), executed on a SimulationImage.
+void simulate_compiled(
+    Factory& factory,
+    TimeOffset duration,
+    std::function<void(Factory&, Time)> report_function,
+    const ImageSimulationOptions& options = {}
+);
+
+#endif // SIMULATION_IMAGE_HXX
@@ -1,11 +1,29 @@
 #include "storage_types.hxx"
+#include "simulation_context.hxx"
+
+#include <algorithm>
+#include <bit>
 #include <stdexcept>
 
-PackageQueue::PackageQueue(PackageQueueType type)
-    : type_(type) {}
+PackageQueuePtr make_package_queue(PackageQueueType type, std::pmr::memory_resource* resource) {
+    if (type == PackageQueueType::LIFO) {
+        return make_stockpile<LifoPackageQueue>(resource, resource);
+    }
+    return make_stockpile<FifoPackageQueue>(resource, resource);
+}
+
+PackageQueue::PackageQueue(PackageQueueType type, std::pmr::memory_resource* resource)
+    : type_(type), packages_(resource) {}
 
 void PackageQueue::push(Package&& package) {
-    packages_.emplace_back(std::move(package));
+    packages_.push_back(std::move(package));
+}
+
+void PackageQueue::push_batch(std::span<Package> packages) {
+    packages_.reserve(packages_.size() + packages.size());
+    for (Package& package : packages) {
+        packages_.push_back(std::move(package));
+    }
 }
 
 Package PackageQueue::pop() {
@@ -13,17 +31,7 @@ Package PackageQueue::pop() {
         throw std::logic_error("Queue is empty");
     }
 
-    Package pkg = (type_ == PackageQueueType::FIFO)
-        ? std::move(packages_.front())
-        : std::move(packages_.back());
-
-    if (type_ == PackageQueueType::FIFO) {
-        packages_.pop_front();
-    } else {
-        packages_.pop_back();
-    }
-
-    return pkg;
+    return type_ == PackageQueueType::FIFO ? Fifo::take(packages_) : Lifo::take(packages_);
 }
 
 IPackageStockpile::const_iterator PackageQueue::begin() const {
@@ -53,3 +61,78 @@ bool PackageQueue::empty() const {
 PackageQueueType PackageQueue::get_queue_type() const {
     return type_;
 }
+
+// ===== AggregateStockpile =====
+
+AggregateStockpile::AggregateStockpile(std::size_t keep_last, std::pmr::memory_resource* resource)
+    : keep_last_(keep_last), recent_(resource) {}
+
+void AggregateStockpile::push(Package&& package) {
+    const Time now = SimulationContext::current().current_turn();
+    if (delivered_ == 0) {
+        first_arrival_ = now;
+    } else {
+        const auto gap = static_cast<std::uint64_t>(now - last_arrival_);
+        ++histogram_[std::bit_width(gap)];
+    }
+    last_arrival_ = now;
+    ++delivered_;
+
+    if (keep_last_ == 0) {
+        return;
+    }
+    if (recent_.size() == keep_last_) {
+        recent_.pop_front();
+    }
+    recent_.push_back(std::move(package));
+}
+
+// Wszystkie paczki partii przychodzą w tej samej turze: one gap from the
+// previous delivery, then gaps of 0.
+void AggregateStockpile::push_batch(std::span<Package> packages) {
+    if (packages.empty()) {
+        return;
+    }
+    const Time now = SimulationContext::current().current_turn();
+    if (delivered_ == 0) {
+        first_arrival_ = now;
+    } else {
+        ++histogram_[std::bit_width(static_cast<std::uint64_t>(now - last_arrival_))];
+    }
+    histogram_[0] += packages.size() - 1;
+    last_arrival_ = now;
+    delivered_ += packages.size();
+
+    // Packages which would be dropped at once stay with the caller.
+    const std::size_t kept = std::min(keep_last_, packages.size());
+    for (Package& package : packages.last(kept)) {
+        if (recent_.size() == keep_last_) {
+            recent_.pop_front();
+        }
+        recent_.push_back(std::move(package));
+    }
+}
+
+IPackageStockpile::const_iterator AggregateStockpile::begin() const {
+    return recent_.begin();
+}
+
+IPackageStockpile::const_iterator AggregateStockpile::end() const {
+    return recent_.end();
+}
+
+IPackageStockpile::const_iterator AggregateStockpile::cbegin() const {
+    return recent_.cbegin();
+}
+
+IPackageStockpile::const_iterator AggregateStockpile::cend() const {
+    return recent_.cend();
+}
+
+std::size_t AggregateStockpile::size() const {
+    return recent_.size();
+}
+
+bool AggregateStockpile::empty() const {
+    return recent_.empty();
+}
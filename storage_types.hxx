@@ -4,13 +4,31 @@
 
 #include "types.hxx"
 #include "package.hxx"
-#include <list>
+#include "ring_buffer.hxx"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <span>
+#include <stdexcept>
+#include <utility>
+
+// Contiguous package storage shared by all stockpile implementations.
+using PackageBuffer = RingBuffer<Package>;
 
 class IPackageStockpile {
 public:
-    using const_iterator = std::list<Package>::const_iterator;
+    using const_iterator = PackageBuffer::const_iterator;
 
     virtual void push(Package&& package) = 0;
+    // Packages arriving together (moved from, in order); same effect as push()
+    // for each of them.
+    virtual void push_batch(std::span<Package> packages) {
+        for (Package& package : packages) {
+            push(std::move(package));
+        }
+    }
 
     virtual const_iterator begin() const = 0;
     virtual const_iterator end() const = 0;
@@ -31,11 +49,140 @@ public:
     virtual ~IPackageQueue() = default;
 };
 
-class PackageQueue : public IPackageQueue {
+// Deleter magazynów paczek tworzonych w zasobie pamięci (make_stockpile()).
+//
+// Converts from std::default_delete, so std::make_unique<Queue>(...) can be
+// passed wherever a PackageQueuePtr or PackageStockpilePtr is expected; such
+// objects are deleted with delete.
+template <typename T>
+class ResourceDelete {
+public:
+    ResourceDelete() = default;
+    explicit ResourceDelete(std::pmr::memory_resource* resource, std::size_t size, std::size_t alignment)
+        : resource_(resource), size_(size), alignment_(alignment) {}
+
+    template <typename U>
+    ResourceDelete(std::default_delete<U>) noexcept {}
+
+    template <typename U>
+    ResourceDelete(const ResourceDelete<U>& other) noexcept
+        : resource_(other.resource_), size_(other.size_), alignment_(other.alignment_) {}
+
+    void operator()(T* p) const {
+        if (resource_ == nullptr) {
+            delete p;
+            return;
+        }
+        void* block = dynamic_cast<void*>(p);
+        std::destroy_at(p);
+        resource_->deallocate(block, size_, alignment_);
+    }
+
+private:
+    template <typename U>
+    friend class ResourceDelete;
+
+    std::pmr::memory_resource* resource_ = nullptr;
+    std::size_t size_ = 0;
+    std::size_t alignment_ = 0;
+};
+
+using PackageStockpilePtr = std::unique_ptr<IPackageStockpile, ResourceDelete<IPackageStockpile>>;
+using PackageQueuePtr = std::unique_ptr<IPackageQueue, ResourceDelete<IPackageQueue>>;
+
+// Stockpile object allocated from the resource.
+template <typename T, typename... Args>
+std::unique_ptr<T, ResourceDelete<T>> make_stockpile(std::pmr::memory_resource* resource, Args&&... args) {
+    void* block = resource->allocate(sizeof(T), alignof(T));
+    try {
+        T* p = std::construct_at(static_cast<T*>(block), std::forward<Args>(args)...);
+        return std::unique_ptr<T, ResourceDelete<T>>(p, ResourceDelete<T>(resource, sizeof(T), alignof(T)));
+    } catch (...) {
+        resource->deallocate(block, sizeof(T), alignof(T));
+        throw;
+    }
+}
+
+// Porządek kolejki (policy of BasicPackageQueue).
+struct Fifo {
+    static constexpr PackageQueueType type = PackageQueueType::FIFO;
+
+    static Package take(PackageBuffer& packages) {
+        Package package = std::move(packages.front());
+        packages.pop_front();
+        return package;
+    }
+};
+
+struct Lifo {
+    static constexpr PackageQueueType type = PackageQueueType::LIFO;
+
+    static Package take(PackageBuffer& packages) {
+        Package package = std::move(packages.back());
+        packages.pop_back();
+        return package;
+    }
+};
+
+// Kolejka o porządku ustalonym w czasie kompilacji.
+//
+// The class is final and defined inline, so calls made through a
+// BasicPackageQueue pointer or reference (Worker does so) bypass the vtable
+// and inline; IPackageQueue stays the interface for everything else.
+template <typename Order>
+class BasicPackageQueue final : public IPackageQueue {
+public:
+    BasicPackageQueue() = default;
+    // Package storage is allocated from the resource.
+    explicit BasicPackageQueue(std::pmr::memory_resource* resource) : packages_(resource) {}
+
+    void push(Package&& package) override { packages_.push_back(std::move(package)); }
+
+    void push_batch(std::span<Package> packages) override {
+        packages_.reserve(packages_.size() + packages.size());
+        for (Package& package : packages) {
+            packages_.push_back(std::move(package));
+        }
+    }
+
+    Package pop() override {
+        if (packages_.empty()) {
+            throw std::logic_error("Queue is empty");
+        }
+        return Order::take(packages_);
+    }
+
+    const_iterator begin() const override { return packages_.begin(); }
+    const_iterator end() const override { return packages_.end(); }
+    const_iterator cbegin() const override { return packages_.cbegin(); }
+    const_iterator cend() const override { return packages_.cend(); }
+
+    std::size_t size() const override { return packages_.size(); }
+    bool empty() const override { return packages_.empty(); }
+
+    PackageQueueType get_queue_type() const override { return Order::type; }
+
+private:
+    PackageBuffer packages_;
+};
+
+using FifoPackageQueue = BasicPackageQueue<Fifo>;
+using LifoPackageQueue = BasicPackageQueue<Lifo>;
+
+// Specialized queue for a type chosen at run time; the queue object and its
+// package storage come from the resource.
+PackageQueuePtr make_package_queue(
+    PackageQueueType type, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+// Kolejka z typem wybieranym w czasie wykonania (kept for compatibility;
+// every operation checks the type).
+class PackageQueue final : public IPackageQueue {
 public:
-    explicit PackageQueue(PackageQueueType type);
+    explicit PackageQueue(PackageQueueType type,
+                          std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 
     void push(Package&& package) override;
+    void push_batch(std::span<Package> packages) override;
     Package pop() override;
 
     const_iterator begin() const override;
@@ -50,7 +197,55 @@ public:
 
 private:
     PackageQueueType type_;
-    std::list<Package> packages_;
+    PackageBuffer packages_;
+};
+
+// Magazyn agregujący (stała pamięć).
+//
+// Instead of keeping every delivered package, only counters, a histogram of
+// inter-arrival times and optionally the last keep_last packages are kept;
+// older packages are destroyed (their IDs return to the pool). Iteration
+// and size() cover the kept packages only; delivered() counts all deliveries.
+// Arrival times are taken from the active simulation context.
+class AggregateStockpile : public IPackageStockpile {
+public:
+    // Bucket k counts gaps g with std::bit_width(g) == k:
+    // 0, 1, 2-3, 4-7, ...
+    static constexpr std::size_t histogram_buckets = 65;
+    using Histogram = std::array<std::uint64_t, histogram_buckets>;
+
+    explicit AggregateStockpile(std::size_t keep_last = 0,
+                                std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    void push(Package&& package) override;
+    void push_batch(std::span<Package> packages) override;
+
+    const_iterator begin() const override;
+    const_iterator end() const override;
+    const_iterator cbegin() const override;
+    const_iterator cend() const override;
+
+    std::size_t size() const override;
+    bool empty() const override;
+
+    std::size_t keep_last() const { return keep_last_; }
+    std::uint64_t delivered() const { return delivered_; }
+    // Turns of the first and the last delivery (0 before any delivery).
+    Time first_arrival() const { return first_arrival_; }
+    Time last_arrival() const { return last_arrival_; }
+    // Gaps between consecutive deliveries, in turns.
+    const Histogram& interarrival_histogram() const { return histogram_; }
+
+private:
+    friend class SimulationImage;
+    friend class CheckpointCodec;
+
+    std::size_t keep_last_;
+    std::uint64_t delivered_ = 0;
+    Time first_arrival_ = 0;
+    Time last_arrival_ = 0;
+    Histogram histogram_{};
+    PackageBuffer recent_;
 };
 
 #endif // STORAGE_TYPES_HXX
@@ -0,0 +1,253 @@
+#include "sweep.hxx"
+
+#include <algorithm>
+#include <charconv>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+
+#include "factory.hxx"
+#include "factory_memory.hxx"
+#include "helpers.hxx"
+#include "simulation_image.hxx"
+#include "thread_pool.hxx"
+
+namespace {
+
+const char* parameter_name(SweepParameter parameter) {
+    switch (parameter) {
+        case SweepParameter::PROCESSING_TIME:   return "processing_time";
+        case SweepParameter::DELIVERY_INTERVAL: return "delivery_interval";
+        case SweepParameter::QUEUE_TYPE:        return "queue_type";
+    }
+    return "";
+}
+
+void validate_axis(const Factory& base, const SweepAxis& axis) {
+    if (axis.values.empty()) {
+        throw std::invalid_argument("Sweep axis has no values");
+    }
+    for (std::int64_t value : axis.values) {
+        const bool valid = axis.parameter == SweepParameter::QUEUE_TYPE
+            ? value == static_cast<std::int64_t>(PackageQueueType::FIFO)
+              || value == static_cast<std::int64_t>(PackageQueueType::LIFO)
+            : value > 0 && value <= std::numeric_limits<TimeOffset>::max();
+        if (!valid) {
+            throw std::invalid_argument("Invalid sweep value");
+        }
+    }
+    for (ElementID id : axis.nodes) {
+        const bool found = axis.parameter == SweepParameter::DELIVERY_INTERVAL
+            ? base.get_ramps().get_by_id(id) != nullptr
+            : base.get_workers().get_by_id(id) != nullptr;
+        if (!found) {
+            throw std::invalid_argument("Unknown sweep node");
+        }
+    }
+}
+
+// Sets one axis value in the copy (before it is simulated).
+void apply(Factory& factory, const SweepAxis& axis, std::int64_t value) {
+    std::vector<ElementID> targets = axis.nodes;
+    if (targets.empty()) {
+        if (axis.parameter == SweepParameter::DELIVERY_INTERVAL) {
+            for (const auto& ramp : factory.get_ramps()) {
+                targets.push_back(ramp.get_id());
+            }
+        } else {
+            for (const auto& worker : factory.get_workers()) {
+                targets.push_back(worker.get_id());
+            }
+        }
+    }
+
+    for (ElementID id : targets) {
+        switch (axis.parameter) {
+            case SweepParameter::DELIVERY_INTERVAL:
+                factory.find_ramp_by_id(id)->set_delivery_interval(static_cast<TimeOffset>(value));
+                break;
+            case SweepParameter::PROCESSING_TIME:
+                factory.find_worker_by_id(id)->set_processing_duration(static_cast<TimeOffset>(value));
+                break;
+            case SweepParameter::QUEUE_TYPE: {
+                Worker& worker = *factory.find_worker_by_id(id);
+                const auto type = static_cast<PackageQueueType>(value);
+                if (worker.get_queue_type() != type) {
+                    worker.set_queue(make_package_queue(type, factory.get_resources().packages));
+                }
+                break;
+            }
+        }
+    }
+}
+
+// Areny wątków: a run takes a free arena and gives it back afterwards.
+class ArenaPool {
+public:
+    FactoryArena* acquire() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (free_.empty()) {
+            arenas_.push_back(std::make_unique<FactoryArena>());
+            return arenas_.back().get();
+        }
+        FactoryArena* arena = free_.back();
+        free_.pop_back();
+        return arena;
+    }
+
+    void release(FactoryArena* arena) {
+        arena->release();
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_.push_back(arena);
+    }
+
+private:
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<FactoryArena>> arenas_;
+    std::vector<FactoryArena*> free_;
+};
+
+} // unnamed namespace
+
+std::size_t sweep_size(const std::vector<SweepAxis>& grid) {
+    std::size_t size = 1;
+    for (const auto& axis : grid) {
+        size *= axis.values.size();
+    }
+    return size;
+}
+
+std::vector<std::int64_t> sweep_point(const std::vector<SweepAxis>& grid, std::size_t point) {
+    std::vector<std::int64_t> values(grid.size());
+    for (std::size_t a = grid.size(); a-- > 0;) {
+        const std::size_t n = grid[a].values.size();
+        values[a] = grid[a].values[point % n];
+        point /= n;
+    }
+    return values;
+}
+
+void run_sweep(
+    const Factory& base,
+    const std::vector<SweepAxis>& grid,
+    const SweepOptions& options,
+    const std::function<void(const SweepResult&)>& on_result
+) {
+    for (const auto& axis : grid) {
+        validate_axis(base, axis);
+    }
+    if (!base.is_consistent()) {
+        throw std::logic_error("Factory network is inconsistent");
+    }
+
+    ImageSimulationOptions simulation;
+    simulation.report_turn = [](Time) { return false; };
+    simulation.event_driven = options.event_driven;
+    simulation.seed = options.seed;
+
+    ArenaPool arenas;
+    std::mutex result_mutex;
+    ThreadPool pool(options.threads);
+    pool.run(sweep_size(grid), [&](std::size_t point) {
+        SweepResult result;
+        result.point = point;
+        result.values = sweep_point(grid, point);
+
+        FactoryArena* arena = arenas.acquire();
+        {
+            Factory run = copy_factory_structure(base, arena->resources());
+            for (std::size_t a = 0; a < grid.size(); ++a) {
+                apply(run, grid[a], result.values[a]);
+            }
+            simulate_compiled(run, options.duration, [](Factory&, Time) {}, simulation);
+            result.metrics = snapshot_metrics(run, options.duration);
+        }
+        arenas.release(arena);
+
+        std::lock_guard<std::mutex> lock(result_mutex);
+        on_result(result);
+    });
+}
+
+std::vector<SweepResult> collect_sweep(
+    const Factory& base,
+    const std::vector<SweepAxis>& grid,
+    const SweepOptions& options
+) {
+    std::vector<SweepResult> results(sweep_size(grid));
+    run_sweep(base, grid, options, [&results](const SweepResult& result) {
+        results[result.point] = result;
+    });
+    return results;
+}
+
+SweepTableWriter::SweepTableWriter(std::ostream& os, const std::vector<SweepAxis>& grid)
+    : os_(os), grid_(grid) {
+    row_ = "point";
+    for (const auto& axis : grid_) {
+        row_ += ',';
+        row_ += parameter_name(axis.parameter);
+        for (ElementID id : axis.nodes) {
+            row_ += ':';
+            row_ += std::to_string(id);
+        }
+    }
+    row_ += ",delivered,arrivals,dropped,processed,utilization,mean_queue_length,max_queue_length\n";
+    os_ << row_ << std::flush;
+}
+
+void SweepTableWriter::write(const SweepResult& result) {
+    auto put_number = [this](auto value) {
+        char digits[32];
+        auto r = std::to_chars(digits, digits + sizeof(digits), value);
+        row_.append(digits, r.ptr);
+    };
+
+    const MetricsSnapshot& m = result.metrics;
+    std::uint64_t delivered = 0, arrivals = 0, dropped = 0, processed = 0;
+    std::size_t max_queue_length = 0;
+    double utilization = 0.0, mean_queue_length = 0.0;
+    for (const auto& ramp : m.ramps) {
+        delivered += ramp.delivered;
+        dropped += ramp.dropped;
+    }
+    for (const auto& worker : m.workers) {
+        dropped += worker.dropped;
+        processed += worker.processed;
+        utilization += worker.utilization;
+        mean_queue_length += worker.mean_queue_length;
+        max_queue_length = std::max(max_queue_length, worker.max_queue_length);
+    }
+    for (const auto& storehouse : m.storehouses) {
+        arrivals += storehouse.arrivals;
+    }
+    if (!m.workers.empty()) {
+        utilization /= static_cast<double>(m.workers.size());
+        mean_queue_length /= static_cast<double>(m.workers.size());
+    }
+
+    row_.clear();
+    put_number(result.point);
+    for (std::size_t a = 0; a < grid_.size(); ++a) {
+        row_ += ',';
+        if (grid_[a].parameter == SweepParameter::QUEUE_TYPE) {
+            row_ += static_cast<PackageQueueType>(result.values[a]) == PackageQueueType::LIFO ? "LIFO" : "FIFO";
+        } else {
+            put_number(result.values[a]);
+        }
+    }
+    for (std::uint64_t value : {delivered, arrivals, dropped, processed}) {
+        row_ += ',';
+        put_number(value);
+    }
+    row_ += ',';
+    put_number(utilization);
+    row_ += ',';
+    put_number(mean_queue_length);
+    row_ += ',';
+    put_number(max_queue_length);
+    row_ += '\n';
+    os_ << row_ << std::flush;
+}
@@ -0,0 +1,99 @@
+#pragma once
+#ifndef SWEEP_HXX
+#define SWEEP_HXX
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "metrics.hxx"
+#include "types.hxx"
+
+class Factory;
+
+// Parametr przeglądu (nazwy jak w pliku struktury fabryki).
+enum class SweepParameter {
+    PROCESSING_TIME,     // workers; values in [1, max TimeOffset]
+    DELIVERY_INTERVAL,   // ramps; values in [1, max TimeOffset]
+    QUEUE_TYPE           // workers; values: static_cast<std::int64_t>(PackageQueueType)
+};
+
+// Oś siatki parametrów: the parameter takes each of `values` in turn, for
+// the listed nodes or for every node of its kind when `nodes` is empty.
+struct SweepAxis {
+    SweepParameter parameter;
+    std::vector<std::int64_t> values;
+    std::vector<ElementID> nodes;
+};
+
+struct SweepOptions {
+    TimeOffset duration = 100;
+    // Counter seed shared by all points (common random numbers: points
+    // differ only in their parameters), see ImageSimulationOptions::seed.
+    std::uint64_t seed = 1;
+    // Runs executed at once (0 = all hardware threads).
+    unsigned threads = 0;
+    bool event_driven = false;
+};
+
+struct SweepResult {
+    std::size_t point;                  // position in the grid, see sweep_point()
+    std::vector<std::int64_t> values;   // one value per axis
+    MetricsSnapshot metrics;            // after options.duration turns
+};
+
+// Number of grid points (product of the axis sizes).
+std::size_t sweep_size(const std::vector<SweepAxis>& grid);
+
+// Parameter tuple of a point; points are numbered row-major, the last axis
+// changing fastest.
+std::vector<std::int64_t> sweep_point(const std::vector<SweepAxis>& grid, std::size_t point);
+
+// Przegląd parametrów na jednej topologii.
+//
+// The base factory is validated once and only read afterwards: every run
+// copies its structure (copy_factory_structure) into a per-thread
+// FactoryArena, sets the point's parameters and simulates the copy with
+// simulate_compiled(), so no text is parsed and the copy's consistency check
+// is the O(1) fast path. Runs are handed out to a ThreadPool one at a time;
+// results are passed to on_result as runs finish (calls are serialized,
+// order depends on scheduling, the values do not). The axes are validated
+// before anything runs (std::invalid_argument); an inconsistent base network
+// throws std::logic_error.
+void run_sweep(
+    const Factory& base,
+    const std::vector<SweepAxis>& grid,
+    const SweepOptions& options,
+    const std::function<void(const SweepResult&)>& on_result
+);
+
+// Wyniki w kolejności siatki (convenience wrapper around run_sweep()).
+std::vector<SweepResult> collect_sweep(
+    const Factory& base,
+    const std::vector<SweepAxis>& grid,
+    const SweepOptions& options
+);
+
+// Tabela wyników w CSV, wiersz po wierszu.
+//
+// Columns: point, one per axis (named after the parameter, with ":id"
+// suffixes for restricted axes; queue types as FIFO/LIFO), then totals of
+// the metrics: delivered, sent to storehouses, dropped, processed, mean
+// worker utilization, mean and maximum queue length. Every row is flushed,
+// so the table can be read while the sweep is running.
+class SweepTableWriter {
+public:
+    SweepTableWriter(std::ostream& os, const std::vector<SweepAxis>& grid);
+
+    void write(const SweepResult& result);
+
+private:
+    std::ostream& os_;
+    std::vector<SweepAxis> grid_;
+    std::string row_;
+};
+
+#endif // SWEEP_HXX
@@ -1,6 +1,31 @@
 #include <gtest/gtest.h>
 #include "package.hxx"
 #include "storage_types.hxx"
+#include "id_pool.hxx"
+#include "simulation_context.hxx"
+#include "factory.hxx"
+#include "helpers.hxx"
+#include "reports.hxx"
+#include "simulation_image.hxx"
+#include "replications.hxx"
+#include "counter_rng.hxx"
+#include "trace.hxx"
+#include "factory_parser.hxx"
+#include "factory_binary.hxx"
+#include "checkpoint.hxx"
+#include "topology_generators.hxx"
+#include "metrics.hxx"
+#include "sweep.hxx"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <memory_resource>
+#include <sstream>
+#include <tuple>
 
 TEST(PackageTest, IsAssignedIdLowest) {
     // przydzielanie ID o jeden większych -- utworzenie dwóch obiektów pod rząd
@@ -37,6 +62,83 @@ TEST(PackageTest, IsAssignmentOperatorCorrect) {
     EXPECT_EQ(p2.get_id(), 1);
 }
 
+TEST(PackageTest, AreContextIdPoolsIndependent) {
+    SimulationContext first;
+    SimulationContext second;
+
+    SimulationContext::Scope first_scope(first);
+    Package p1;
+    {
+        SimulationContext::Scope second_scope(second);
+        Package p2;
+        EXPECT_EQ(p2.get_id(), 1);
+    }
+    Package p3;
+
+    EXPECT_EQ(p1.get_id(), 1);
+    EXPECT_EQ(p3.get_id(), 2);
+}
+
+TEST(PackageTest, IsFactoryMoveAssignedWithPackages) {
+    // paczki starych węzłów zwalniają ID do puli starego kontekstu
+
+    auto make_factory = [] {
+        Factory factory;
+        factory.add_ramp(Ramp(1, 1));
+        factory.add_storehouse(Storehouse(1));
+        factory.find_ramp_by_id(1)->add_receiver(&*factory.find_storehouse_by_id(1));
+        return factory;
+    };
+
+    Factory factory = make_factory();
+    simulate(factory, 10, [](Factory&, Time) {});
+    factory = Factory();
+    EXPECT_EQ(factory.ramp_cbegin(), factory.ramp_cend());
+
+    factory = make_factory();
+    simulate(factory, 10, [](Factory&, Time) {});
+    Factory other = make_factory();
+    simulate(other, 5, [](Factory&, Time) {});
+    factory = std::move(other);
+    EXPECT_EQ(factory.get_context().id_pool().size(), factory.find_storehouse_by_id(1)->get_stock().size());
+}
+
+TEST(IdPoolTest, IsLowestFreeIdReturned) {
+    // więcej ID niż mieści się w jednym słowie bitmapy
+
+    IdPool pool;
+    for (ElementID id = 1; id <= 200; ++id) {
+        EXPECT_EQ(pool.acquire(), id);
+    }
+
+    pool.release(70);
+    pool.release(5);
+
+    EXPECT_EQ(pool.acquire(), 5);
+    EXPECT_EQ(pool.acquire(), 70);
+    EXPECT_EQ(pool.acquire(), 201);
+    EXPECT_EQ(pool.size(), 201u);
+}
+
+TEST(IdPoolTest, IsReservedIdSkipped) {
+    IdPool pool;
+    pool.reserve(1);
+    pool.reserve(3);
+
+    EXPECT_EQ(pool.acquire(), 2);
+    EXPECT_EQ(pool.acquire(), 4);
+}
+
+TEST(IdPoolTest, IsInvalidReservationRejected) {
+    IdPool pool;
+    pool.reserve(3);
+
+    EXPECT_THROW(pool.reserve(3), std::invalid_argument);
+    EXPECT_THROW(pool.reserve(0), std::invalid_argument);
+    EXPECT_THROW(pool.reserve(IdPool::max_reserved_id + 1), std::invalid_argument);
+    EXPECT_EQ(pool.size(), 1u);
+}
+
 TEST(PackageQueueTest, IsFifoCorrect) {
     PackageQueue q(PackageQueueType::FIFO);
     q.push(Package(1));
@@ -60,3 +162,1369 @@ TEST(PackageQueueTest, IsLifoCorrect) {
     p = q.pop();
     EXPECT_EQ(p.get_id(), 1);
 }
+
+TEST(PackageQueueTest, IsOrderKeptAfterWrapAround) {
+    // bufor kołowy: naprzemienne push/pop przesuwa początek kolejki, potem rośnie pojemność
+
+    PackageQueue q(PackageQueueType::FIFO);
+    for (ElementID id = 1; id <= 10; ++id) {
+        q.push(Package(id));
+    }
+    for (ElementID id = 1; id <= 8; ++id) {
+        EXPECT_EQ(q.pop().get_id(), id);
+    }
+    for (ElementID id = 11; id <= 40; ++id) {
+        q.push(Package(id));
+    }
+
+    ElementID expected = 9;
+    for (const auto& p : q) {
+        EXPECT_EQ(p.get_id(), expected++);
+    }
+    EXPECT_EQ(expected, 41);
+    EXPECT_EQ(q.size(), 32u);
+}
+
+TEST(PackageQueueTest, AreSpecializedQueuesCreated) {
+    // kolejki z porządkiem w czasie kompilacji zachowują się jak PackageQueue
+
+    PackageQueuePtr fifo = make_package_queue(PackageQueueType::FIFO);
+    PackageQueuePtr lifo = make_package_queue(PackageQueueType::LIFO);
+    ASSERT_NE(dynamic_cast<FifoPackageQueue*>(fifo.get()), nullptr);
+    ASSERT_NE(dynamic_cast<LifoPackageQueue*>(lifo.get()), nullptr);
+    EXPECT_EQ(fifo->get_queue_type(), PackageQueueType::FIFO);
+    EXPECT_EQ(lifo->get_queue_type(), PackageQueueType::LIFO);
+
+    std::vector<Package> batch;
+    for (ElementID id = 1; id <= 3; ++id) {
+        fifo->push(Package(id));
+        batch.emplace_back(Package(id + 10));
+    }
+    lifo->push_batch(batch);
+
+    EXPECT_EQ(fifo->pop().get_id(), 1);
+    EXPECT_EQ(lifo->pop().get_id(), 13);
+    EXPECT_EQ(lifo->pop().get_id(), 12);
+    EXPECT_EQ(fifo->size(), 2u);
+    EXPECT_EQ(lifo->size(), 1u);
+
+    LifoPackageQueue empty;
+    EXPECT_THROW(empty.pop(), std::logic_error);
+}
+
+TEST(AggregateStockpileTest, AreOnlyCountersAndLastPackagesKept) {
+    SimulationContext context;
+    SimulationContext::Scope scope(context);
+
+    AggregateStockpile stock(2);
+    for (Time t : {3, 3, 4, 8}) {
+        context.set_current_turn(t);
+        stock.push(Package());
+    }
+
+    EXPECT_EQ(stock.delivered(), 4u);
+    EXPECT_EQ(stock.size(), 2u);
+    EXPECT_EQ(stock.end() - stock.begin(), 2);
+    EXPECT_EQ(stock.first_arrival(), 3);
+    EXPECT_EQ(stock.last_arrival(), 8);
+    // odstępy: 0, 1, 4
+    EXPECT_EQ(stock.interarrival_histogram()[0], 1u);
+    EXPECT_EQ(stock.interarrival_histogram()[1], 1u);
+    EXPECT_EQ(stock.interarrival_histogram()[3], 1u);
+    // starsze paczki zostały zniszczone – ich ID wracają do puli
+    EXPECT_EQ(context.id_pool().size(), 2u);
+}
+
+TEST(NodeCollectionTest, AreAddressesStable) {
+    // wskaźniki do węzłów (np. w ReceiverPreferences) przeżywają dodawanie i usuwanie innych węzłów
+
+    NodeCollection<Storehouse> stores;
+    stores.add(Storehouse(1));
+    const Storehouse* first = &(*stores.find_by_id(1));
+
+    for (ElementID id = 2; id <= 1000; ++id) {
+        stores.add(Storehouse(id));
+    }
+    stores.remove_by_id(500);
+    stores.add(Storehouse(1001));
+
+    EXPECT_EQ(&(*stores.find_by_id(1)), first);
+    EXPECT_EQ(stores.find_by_id(500), stores.end());
+    EXPECT_EQ(stores.find_by_id(501)->get_id(), 501);
+    EXPECT_EQ(stores.get_by_id(1001)->get_id(), 1001);
+    EXPECT_EQ(stores.size(), 1000u);
+}
+
+TEST(NodeCollectionTest, IsInsertionOrderKept) {
+    NodeCollection<Storehouse> stores;
+    for (ElementID id : {5, 3, 9, 1}) {
+        stores.add(Storehouse(id));
+    }
+    stores.remove_by_id(3);
+
+    std::vector<ElementID> ids;
+    for (const auto& s : stores) {
+        ids.push_back(s.get_id());
+    }
+    EXPECT_EQ(ids, (std::vector<ElementID>{5, 9, 1}));
+}
+
+TEST(ReceiverPreferencesTest, IsChoiceByCumulativeProbability) {
+    // wybór odbiorcy w kolejności dodania, niezależnie od adresów w pamięci
+
+    double p = 0.0;
+    ReceiverPreferences prefs([&p]() { return p; });
+    Storehouse s1(1), s2(2), s3(3);
+    prefs.add_receiver(&s3);
+    prefs.add_receiver(&s1);
+    prefs.add_receiver(&s2);
+
+    p = 0.2;
+    EXPECT_EQ(prefs.choose_receiver(), &s3);
+    p = 1.0 / 3.0;
+    EXPECT_EQ(prefs.choose_receiver(), &s3);
+    p = 0.5;
+    EXPECT_EQ(prefs.choose_receiver(), &s1);
+    p = 1.0;
+    EXPECT_EQ(prefs.choose_receiver(), &s2);
+    p = 1.5;
+    EXPECT_EQ(prefs.choose_receiver(), nullptr);
+}
+
+TEST(ReceiverPreferencesTest, AreWeightsNormalized) {
+    double p = 0.0;
+    ReceiverPreferences prefs([&p]() { return p; });
+    Storehouse s1(1), s2(2);
+    prefs.add_receiver(&s1, 3.0);
+    prefs.add_receiver(&s2, 1.0);
+
+    EXPECT_DOUBLE_EQ(prefs.get_preferences()[0].second, 0.75);
+    EXPECT_DOUBLE_EQ(prefs.get_preferences()[1].second, 0.25);
+
+    p = 0.75;
+    EXPECT_EQ(prefs.choose_receiver(), &s1);
+    p = 0.76;
+    EXPECT_EQ(prefs.choose_receiver(), &s2);
+
+    prefs.remove_receiver(&s1);
+    EXPECT_DOUBLE_EQ(prefs.get_preferences()[0].second, 1.0);
+    p = 0.1;
+    EXPECT_EQ(prefs.choose_receiver(), &s2);
+}
+
+TEST(ReceiverPreferencesTest, AreReceiversAddedInBulk) {
+    ReceiverPreferences prefs([]() { return 1.0; });
+    Storehouse s1(1), s2(2), s3(3);
+    prefs.add_receiver(&s2, 2.0);
+
+    // zły parametr – nic nie zostaje dodane
+    const ReceiverPreferences::receiver_weight_t invalid[] = {{&s1, 1.0}, {&s3, 0.0}};
+    EXPECT_THROW(prefs.add_receivers(invalid), std::invalid_argument);
+    EXPECT_EQ(prefs.size(), 1u);
+
+    // duplikaty (już obecne i powtórzone w liście) są pomijane
+    const ReceiverPreferences::receiver_weight_t receivers[] = {{&s1, 1.0}, {&s2, 5.0}, {&s3, 1.0}, {&s1, 7.0}};
+    prefs.add_receivers(receivers);
+    ASSERT_EQ(prefs.size(), 3u);
+    EXPECT_EQ(prefs.get_preferences()[1].first, &s1);
+    EXPECT_EQ(prefs.get_preferences()[2].first, &s3);
+    EXPECT_EQ(prefs.weight(0), 2.0);
+    EXPECT_EQ(prefs.weight(1), 1.0);
+    EXPECT_DOUBLE_EQ(prefs.get_preferences()[0].second, 0.5);
+    EXPECT_EQ(prefs.choose_receiver(), &s3);
+}
+
+TEST(ReceiverPreferencesTest, AreWeightsRoundTripped) {
+    // wagi zapisane z pełną precyzją – routing po wczytaniu bez zmian
+
+    Factory factory;
+    factory.add_ramp(Ramp(1, 1));
+    factory.add_storehouse(Storehouse(1));
+    factory.add_storehouse(Storehouse(2));
+    Ramp& ramp = *factory.find_ramp_by_id(1);
+    ramp.add_receiver(&*factory.find_storehouse_by_id(1), 1.0 / 3.0);
+    ramp.add_receiver(&*factory.find_storehouse_by_id(2), 0.1 + 0.2);
+
+    std::stringstream ss;
+    save_factory_structure(factory, ss);
+    Factory loaded = load_factory_structure(ss);
+    const auto& prefs = loaded.find_ramp_by_id(1)->receiver_preferences_;
+    EXPECT_EQ(prefs.get_weight(&*loaded.find_storehouse_by_id(1)), 1.0 / 3.0);
+    EXPECT_EQ(prefs.get_weight(&*loaded.find_storehouse_by_id(2)), 0.1 + 0.2);
+}
+
+TEST(ReceiverPreferencesTest, AreHandlesTyped) {
+    ReceiverPreferences prefs;
+    Storehouse s(1);
+    Worker w(1, 1, make_package_queue(PackageQueueType::FIFO));
+    IPackageReceiver* receiver = &s;
+    prefs.add_receiver(&w);
+    prefs.add_receiver(receiver);
+
+    ASSERT_TRUE(std::holds_alternative<Worker*>(prefs.handle(0)));
+    EXPECT_EQ(std::get<Worker*>(prefs.handle(0)), &w);
+    ASSERT_TRUE(std::holds_alternative<Storehouse*>(prefs.handle(1)));
+    EXPECT_EQ(std::get<Storehouse*>(prefs.handle(1)), &s);
+
+    prefs.remove_receiver(&w);
+    ASSERT_EQ(prefs.size(), 1u);
+    EXPECT_TRUE(std::holds_alternative<Storehouse*>(prefs.handle(0)));
+}
+
+namespace {
+
+// Sieć testowa: rampa -> 2 robotników (FIFO, LIFO) -> magazyn; generator deterministyczny.
+Factory make_test_factory(const FactoryResources& resources = {}) {
+    static const char* structure =
+        "LOADING_RAMP id=1 delivery-interval=1\n"
+        "LOADING_RAMP id=2 delivery-interval=3\n"
+        "WORKER id=1 processing-time=2 queue-type=FIFO\n"
+        "WORKER id=2 processing-time=3 queue-type=LIFO\n"
+        "STOREHOUSE id=1\n"
+        "LINK src=ramp-1 dest=worker-1\n"
+        "LINK src=ramp-1 dest=worker-2\n"
+        "LINK src=ramp-2 dest=worker-2\n"
+        "LINK src=worker-1 dest=worker-2\n"
+        "LINK src=worker-1 dest=store-1\n"
+        "LINK src=worker-2 dest=store-1\n";
+
+    auto pg = [n = 0]() mutable { return ((n++ * 7) % 10) / 10.0; };
+    ProbabilityGenerator saved = probability_generator;
+    probability_generator = pg;
+    std::istringstream is(structure);
+    Factory factory = load_factory_structure(is, resources);
+    probability_generator = saved;
+    return factory;
+}
+
+std::string run_with_reports(
+    void (*sim)(Factory&, TimeOffset, std::function<void(Factory&, Time)>),
+    TimeOffset duration
+) {
+    Factory factory = make_test_factory();
+    std::ostringstream os;
+    sim(factory, duration, [&os](Factory& f, Time t) { generate_simulation_turn_report(f, os, t); });
+    return os.str();
+}
+
+} // unnamed namespace
+
+TEST(SimulationImageTest, AreTurnReportsIdentical) {
+    auto compiled = [](Factory& f, TimeOffset d, std::function<void(Factory&, Time)> r) {
+        simulate_compiled(f, d, std::move(r));
+    };
+    EXPECT_EQ(run_with_reports(simulate, 25), run_with_reports(compiled, 25));
+}
+
+TEST(SimulationImageTest, IsEventDrivenModeIdentical) {
+    auto event_driven = [](Factory& f, TimeOffset d, std::function<void(Factory&, Time)> r) {
+        ImageSimulationOptions options;
+        options.event_driven = true;
+        simulate_compiled(f, d, std::move(r), options);
+    };
+    EXPECT_EQ(run_with_reports(simulate, 40), run_with_reports(event_driven, 40));
+}
+
+TEST(SimulationImageTest, IsMultiThreadedTurnIdentical) {
+    // kolejność w kolejkach odbiorców nie zależy od liczby wątków
+
+    auto parallel = [](Factory& f, TimeOffset d, std::function<void(Factory&, Time)> r) {
+        ImageSimulationOptions options;
+        options.threads = 4;
+        simulate_compiled(f, d, std::move(r), options);
+    };
+    EXPECT_EQ(run_with_reports(simulate, 40), run_with_reports(parallel, 40));
+}
+
+namespace {
+
+// Zasób liczący przydziały (bytes still allocated must drop to 0).
+class CountingResource : public std::pmr::memory_resource {
+public:
+    std::size_t allocations = 0;
+    std::size_t outstanding = 0;
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+        ++allocations;
+        outstanding += bytes;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override {
+        outstanding -= bytes;
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+};
+
+} // unnamed namespace
+
+TEST(FactoryMemoryTest, IsFactoryBuiltOnResources) {
+    // fabryka na własnych zasobach daje te same raporty i oddaje całą pamięć
+
+    CountingResource topology, packages;
+    std::ostringstream expected, actual;
+    {
+        Factory factory = make_test_factory();
+        simulate(factory, 30, [&expected](Factory& f, Time t) { generate_simulation_turn_report(f, expected, t); });
+    }
+    {
+        Factory factory = make_test_factory({&topology, &packages});
+        EXPECT_EQ(factory.get_resources().topology, &topology);
+        simulate(factory, 30, [&actual](Factory& f, Time t) { generate_simulation_turn_report(f, actual, t); });
+
+        Factory copy = copy_factory_structure(factory, {&topology, &packages});
+        EXPECT_TRUE(copy.is_consistent());
+    }
+    EXPECT_EQ(expected.str(), actual.str());
+    EXPECT_GT(topology.allocations, 0u);
+    EXPECT_GT(packages.allocations, 0u);
+    EXPECT_EQ(topology.outstanding, 0u);
+    EXPECT_EQ(packages.outstanding, 0u);
+}
+
+TEST(FactoryMemoryTest, IsArenaReusable) {
+    FactoryArena arena;
+    for (int i = 0; i < 3; ++i) {
+        {
+            Factory factory = make_test_factory(arena.resources());
+            simulate(factory, 20, [](Factory&, Time) {});
+            EXPECT_TRUE(factory.is_consistent());
+            EXPECT_GT(factory.find_storehouse_by_id(1)->get_arrival_count(), 0u);
+        }
+        arena.release();
+    }
+}
+
+TEST(AggregateStockpileTest, IsStockTypeLoadedAndSaved) {
+    std::istringstream is(
+        "LOADING_RAMP id=1 delivery-interval=1\n"
+        "STOREHOUSE id=1 stock=aggregate keep-last=3\n"
+        "STOREHOUSE id=2\n"
+        "LINK src=ramp-1 dest=store-1\n");
+    Factory factory = load_factory_structure(is);
+
+    const auto* aggregate = dynamic_cast<const AggregateStockpile*>(
+        &factory.find_storehouse_by_id(1)->get_stock());
+    ASSERT_NE(aggregate, nullptr);
+    EXPECT_EQ(aggregate->keep_last(), 3u);
+
+    std::ostringstream os;
+    save_factory_structure(factory, os);
+    EXPECT_NE(os.str().find("STOREHOUSE id=1 stock=aggregate keep-last=3\n"), std::string::npos);
+    EXPECT_NE(os.str().find("STOREHOUSE id=2\n"), std::string::npos);
+
+    std::ostringstream report;
+    simulate(factory, 5, [&report](Factory& f, Time t) {
+        if (t == 5) generate_simulation_turn_report(f, report, t);
+    });
+    // ID 1 wróciło do puli po usunięciu najstarszej paczki
+    EXPECT_NE(report.str().find("Stock: #3, #4, #1 (5 total)"), std::string::npos);
+}
+
+TEST(FactoryParserTest, IsStructureParsedInPlace) {
+    Factory factory = parse_factory_structure(
+        "; komentarz\r\n"
+        "LOADING_RAMP id=1 delivery-interval=3\r\n"
+        "\n"
+        "  WORKER\tid=2 processing-time=4 queue-type=LIFO\n"
+        "STOREHOUSE id=5\n"
+        "LINK src=ramp-1 dest=worker-2 weight=2.5\n"
+        "LINK src=worker-2 dest=store-5");
+
+    ASSERT_NE(factory.find_ramp_by_id(1), factory.ramp_cend());
+    EXPECT_EQ(factory.find_ramp_by_id(1)->get_delivery_interval(), 3);
+    const auto worker = factory.find_worker_by_id(2);
+    ASSERT_NE(worker, factory.worker_cend());
+    EXPECT_EQ(worker->get_queue_type(), PackageQueueType::LIFO);
+    EXPECT_DOUBLE_EQ(factory.find_ramp_by_id(1)->receiver_preferences_.get_weight(&*worker), 2.5);
+    EXPECT_EQ(worker->receiver_preferences_.size(), 1u);
+    EXPECT_TRUE(factory.is_consistent());
+}
+
+TEST(FactoryParserTest, AreErrorPositionsReported) {
+    auto error_position = [](const char* text) {
+        try {
+            parse_factory_structure(text);
+        } catch (const FactoryParseError& e) {
+            return std::make_pair(e.line(), e.column());
+        }
+        return std::make_pair(std::size_t{0}, std::size_t{0});
+    };
+
+    EXPECT_EQ(error_position("LOADING_RAMP id=1 delivery-interval=x1\n"), std::make_pair(std::size_t{1}, std::size_t{37}));
+    EXPECT_EQ(error_position("WORKER id=1 processing-time=1\n  ROBOT id=2\n"), std::make_pair(std::size_t{2}, std::size_t{3}));
+    EXPECT_EQ(error_position("STOREHOUSE id=1\nLINK src=ramp-1 dest=store-1\n"), std::make_pair(std::size_t{2}, std::size_t{10}));
+    EXPECT_EQ(error_position("STOREHOUSE id=1\nSTOREHOUSE id=1\n"), std::make_pair(std::size_t{2}, std::size_t{1}));
+    EXPECT_EQ(error_position("LOADING_RAMP id=1 delivery-interval=0\n"), std::make_pair(std::size_t{1}, std::size_t{37}));
+    EXPECT_EQ(error_position("WORKER id=1 processing-time=-2\n"), std::make_pair(std::size_t{1}, std::size_t{29}));
+    // nieznane klucze są pomijane, bez limitu liczby par
+    EXPECT_EQ(error_position("WORKER id=1 processing-time=2 a=1 b=2 c=3 d=4 e=5 f=6 g=7 h=8 queue-type=LIFO\n"),
+              std::make_pair(std::size_t{0}, std::size_t{0}));
+    EXPECT_EQ(error_position("LOADING_RAMP id=1 delivery-interval=1 batch-size=0\n"), std::make_pair(std::size_t{1}, std::size_t{50}));
+    // wcześniejszy interfejs – błąd nadal jest std::logic_error
+    std::istringstream is("WORKER id=1\n");
+    EXPECT_THROW(load_factory_structure(is), std::logic_error);
+}
+
+TEST(FactoryParserTest, IsFileLoaded) {
+    const std::string path = ::testing::TempDir() + "netsim_parser_test.txt";
+    {
+        std::ofstream os(path);
+        save_factory_structure(make_test_factory(), os);
+    }
+    Factory factory = load_factory_structure_file(path);
+    std::ostringstream saved;
+    save_factory_structure(factory, saved);
+    std::ostringstream expected;
+    save_factory_structure(make_test_factory(), expected);
+    EXPECT_EQ(saved.str(), expected.str());
+    std::remove(path.c_str());
+}
+
+TEST(FactoryBinaryTest, IsStructureRoundTripped) {
+    Factory factory = parse_factory_structure(
+        "LOADING_RAMP id=4 delivery-interval=2 batch-size=3\n"
+        "WORKER id=7 processing-time=3 queue-type=LIFO\n"
+        "WORKER id=1 processing-time=1\n"
+        "STOREHOUSE id=2 stock=aggregate keep-last=5\n"
+        "LINK src=ramp-4 dest=worker-7 weight=0.25\n"
+        "LINK src=ramp-4 dest=worker-1\n"
+        "LINK src=worker-7 dest=store-2\n"
+        "LINK src=worker-1 dest=store-2\n");
+
+    std::ostringstream binary;
+    save_factory_binary(factory, binary);
+    ASSERT_TRUE(is_factory_binary(binary.str()));
+    Factory loaded = load_factory_binary(binary.str());
+
+    std::ostringstream expected, actual;
+    save_factory_structure(factory, expected);
+    save_factory_structure(loaded, actual);
+    EXPECT_EQ(actual.str(), expected.str());
+
+    // wersja 1: słowo batch_size było zarezerwowane (0) – jedna paczka na dostawę
+    std::string v1 = binary.str();
+    FactoryBinaryHeader header;
+    std::memcpy(&header, v1.data(), sizeof(header));
+    header.version = 1;
+    const std::uint32_t reserved = 0;
+    std::memcpy(v1.data() + sizeof(header) + offsetof(BinaryRamp, batch_size), &reserved, sizeof(reserved));
+    header.checksum = fnv1a_checksum(std::string_view(v1).substr(sizeof(header)));
+    std::memcpy(v1.data(), &header, sizeof(header));
+    EXPECT_EQ(load_factory_binary(v1).find_ramp_by_id(4)->get_batch_size(), 1u);
+
+    // od wersji 2 partia 0 jest błędem
+    header.version = 2;
+    std::memcpy(v1.data(), &header, sizeof(header));
+    EXPECT_THROW(load_factory_binary(v1), std::runtime_error);
+}
+
+TEST(FactoryBinaryTest, IsCorruptionDetected) {
+    std::ostringstream os;
+    save_factory_binary(make_test_factory(), os);
+    std::string bytes = os.str();
+
+    bytes[bytes.size() - 9] ^= 0x01;
+    EXPECT_THROW(load_factory_binary(bytes), std::runtime_error);
+    EXPECT_THROW(load_factory_binary(std::string_view(bytes).substr(0, 60)), std::runtime_error);
+    EXPECT_THROW(load_factory_binary("LOADING_RAMP id=1 delivery-interval=1\n"), std::runtime_error);
+}
+
+TEST(FactoryBinaryTest, AreInvalidNodesRejected) {
+    std::string bytes;
+    append_factory_binary(parse_factory_structure(
+        "LOADING_RAMP id=1 delivery-interval=2\n"
+        "LOADING_RAMP id=2 delivery-interval=3\n"
+        "WORKER id=1 processing-time=1\n"
+        "WORKER id=2 processing-time=2\n"
+        "STOREHOUSE id=1\n"
+        "STOREHOUSE id=2\n"), bytes);
+    ASSERT_NO_THROW(load_factory_binary(bytes));
+
+    // podmienia pole rekordu i przelicza sumę kontrolną
+    auto patched = [&bytes](std::size_t offset, auto value) {
+        std::string copy = bytes;
+        std::memcpy(copy.data() + sizeof(FactoryBinaryHeader) + offset, &value, sizeof(value));
+        FactoryBinaryHeader header;
+        std::memcpy(&header, copy.data(), sizeof(header));
+        header.checksum = fnv1a_checksum(std::string_view(copy).substr(sizeof(header)));
+        std::memcpy(copy.data(), &header, sizeof(header));
+        return copy;
+    };
+    constexpr std::size_t workers = 2 * sizeof(BinaryRamp);
+    constexpr std::size_t stores = workers + 2 * sizeof(BinaryWorker);
+
+    std::vector<std::int64_t> invalid_offsets{0, -3};
+    if constexpr (sizeof(TimeOffset) < sizeof(std::int64_t)) {
+        invalid_offsets.push_back(std::int64_t{std::numeric_limits<TimeOffset>::max()} + 1);
+    }
+    for (std::int64_t value : invalid_offsets) {
+        EXPECT_THROW(load_factory_binary(patched(offsetof(BinaryRamp, delivery_interval), value)),
+                     std::runtime_error);
+        EXPECT_THROW(load_factory_binary(patched(workers + offsetof(BinaryWorker, processing_time), value)),
+                     std::runtime_error);
+    }
+
+    // powtórzone ID węzła
+    const std::int32_t id = 1;
+    EXPECT_THROW(load_factory_binary(patched(sizeof(BinaryRamp) + offsetof(BinaryRamp, id), id)),
+                 std::runtime_error);
+    EXPECT_THROW(load_factory_binary(patched(workers + sizeof(BinaryWorker) + offsetof(BinaryWorker, id), id)),
+                 std::runtime_error);
+    EXPECT_THROW(load_factory_binary(patched(stores + sizeof(BinaryStorehouse) + offsetof(BinaryStorehouse, id), id)),
+                 std::runtime_error);
+}
+
+TEST(CounterRngTest, IsPhiloxKnownAnswerCorrect) {
+    // wektory kontrolne Random123 (philox4x32, 10 rund)
+    using Block = std::array<std::uint32_t, 4>;
+    EXPECT_EQ(philox4x32({0, 0, 0, 0}, {0, 0}),
+              (Block{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}));
+    EXPECT_EQ(philox4x32({0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}, {0xa4093822, 0x299f31d0}),
+              (Block{0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}));
+}
+
+TEST(CounterRngTest, IsDrawRecomputable) {
+    ProbabilityGenerator pg = counter_probability_generator(7, ElementType::WORKER, 3);
+    SimulationContext context;
+    SimulationContext::Scope scope(context);
+
+    context.set_current_turn(5);
+    const double first = pg();
+    const double second = pg();
+    EXPECT_EQ(first, counter_probability(7, false, 3, 5, 0));
+    EXPECT_EQ(second, counter_probability(7, false, 3, 5, 1));
+    EXPECT_NE(first, counter_probability(7, true, 3, 5, 0));
+
+    context.set_current_turn(6);
+    EXPECT_EQ(pg(), counter_probability(7, false, 3, 6, 0));
+}
+
+TEST(SimulationImageTest, IsSeededRunReproducible) {
+    // z tym samym ziarnem: ten sam przebieg w simulate() i w trybie wielowątkowym
+
+    auto seeded = [](Factory& f, TimeOffset d, std::function<void(Factory&, Time)> r) {
+        simulate(f, d, std::move(r), 2024);
+    };
+    auto parallel = [](Factory& f, TimeOffset d, std::function<void(Factory&, Time)> r) {
+        ImageSimulationOptions options;
+        options.threads = 4;
+        options.seed = 2024;
+        simulate_compiled(f, d, std::move(r), options);
+    };
+    const std::string expected = run_with_reports(seeded, 40);
+    EXPECT_EQ(expected, run_with_reports(seeded, 40));
+    EXPECT_EQ(expected, run_with_reports(parallel, 40));
+    EXPECT_NE(expected, run_with_reports(simulate, 40));
+}
+
+namespace {
+
+// Sieć okresowa: każdy nadawca ma jednego odbiorcę, magazyny tylko liczą.
+Factory make_periodic_factory() {
+    std::istringstream is(
+        "LOADING_RAMP id=1 delivery-interval=4 batch-size=2\n"
+        "LOADING_RAMP id=2 delivery-interval=3\n"
+        "WORKER id=1 processing-time=2 queue-type=FIFO\n"
+        "WORKER id=2 processing-time=2 queue-type=LIFO\n"
+        "STOREHOUSE id=1 stock=aggregate keep-last=2\n"
+        "STOREHOUSE id=2 stock=aggregate\n"
+        "LINK src=ramp-1 dest=worker-1\n"
+        "LINK src=ramp-2 dest=store-2\n"
+        "LINK src=worker-1 dest=worker-2\n"
+        "LINK src=worker-2 dest=store-1\n");
+    return load_factory_structure(is);
+}
+
+} // unnamed namespace
+
+TEST(SimulationImageTest, IsFastForwardRunIdentical) {
+    constexpr TimeOffset duration = 5000;
+    const IntervalReportNotifier notifier(1000);
+
+    auto run = [&](bool fast_forward) {
+        Factory factory = make_periodic_factory();
+        std::ostringstream os;
+        ImageSimulationOptions options;
+        options.report_turn = [&](Time t) { return notifier.should_generate_report(t); };
+        options.next_report_turn = [&](Time t) { return notifier.next_report_turn(t); };
+        options.fast_forward = fast_forward;
+        simulate_compiled(factory, duration, [&os](Factory& f, Time t) {
+            generate_simulation_turn_report(f, os, t);
+            os << f.get_storehouses().begin()->get_arrival_count() << "\n";
+        }, options);
+        return std::make_pair(os.str(), snapshot_metrics(factory, duration));
+    };
+    EXPECT_EQ(run(false), run(true));
+}
+
+#ifndef NETSIM_PACKAGE_METADATA
+// Z metadanymi paczek (absolute turns) stan nie powtarza się.
+TEST(SimulationImageTest, AreWholePeriodsSkipped) {
+    constexpr Time horizon = 1000000;
+
+    Factory factory = make_periodic_factory();
+    Factory reference = make_periodic_factory();
+    simulate_compiled(reference, horizon + 3, [](Factory&, Time) {});
+    {
+        SimulationContext::Scope scope(factory.get_context());
+        SimulationImage image(factory);
+        ASSERT_TRUE(image.can_fast_forward());
+
+        Time t = 0;
+        Time skipped = 0;
+        while (t < horizon + 3) {
+            image.run_turn(++t);
+            const Time next = image.fast_forward(t, horizon);
+            skipped += next - t;
+            t = next;
+        }
+        EXPECT_GT(skipped, horizon - 100);
+    }
+    EXPECT_EQ(snapshot_metrics(factory, horizon + 3), snapshot_metrics(reference, horizon + 3));
+
+    // Dwóch odbiorców albo magazyn z kolejką paczek: stan nie jest okresowy.
+    Factory routed = make_test_factory();
+    SimulationContext::Scope scope(routed.get_context());
+    EXPECT_FALSE(SimulationImage(routed).can_fast_forward());
+}
+
+// Kolejka rośnie bez końca: wykrywanie cyklu poddaje się po kilku zapisach,
+// potem fast_forward() wraca od razu i przebieg pozostaje liniowy.
+TEST(SimulationImageTest, IsCycleDetectionAbandonedForGrowingQueues) {
+    std::istringstream is(
+        "LOADING_RAMP id=1 delivery-interval=1\n"
+        "WORKER id=1 processing-time=5 queue-type=FIFO\n"
+        "STOREHOUSE id=1 stock=aggregate\n"
+        "LINK src=ramp-1 dest=worker-1\n"
+        "LINK src=worker-1 dest=store-1\n");
+    Factory factory = load_factory_structure(is);
+    SimulationContext::Scope scope(factory.get_context());
+    SimulationImage image(factory);
+    ASSERT_TRUE(image.can_fast_forward());
+
+    constexpr Time horizon = 40000;
+    for (Time t = 1; t <= horizon; ++t) {
+        image.run_turn(t);
+        ASSERT_EQ(image.fast_forward(t, horizon), t);
+        if (t == 1024) {
+            EXPECT_FALSE(image.is_detecting_cycles());
+        }
+    }
+}
+#endif
+
+namespace {
+
+std::vector<TraceRecord> run_with_trace(const ImageSimulationOptions* options, TimeOffset duration) {
+    Factory factory = make_test_factory();
+    TraceLog log;
+    factory.get_context().set_trace(&log);
+    if (options == nullptr) {
+        simulate(factory, duration, [](Factory&, Time) {});
+    } else {
+        simulate_compiled(factory, duration, [](Factory&, Time) {}, *options);
+    }
+    return log.records();
+}
+
+} // unnamed namespace
+
+TEST(TraceTest, AreEngineTracesIdentical) {
+    const auto expected = run_with_trace(nullptr, 30);
+    ASSERT_FALSE(expected.empty());
+    EXPECT_EQ(expected.front().event, TraceEvent::DELIVERY);
+
+    ImageSimulationOptions compiled;
+    EXPECT_EQ(run_with_trace(&compiled, 30), expected);
+
+    ImageSimulationOptions event_driven;
+    event_driven.event_driven = true;
+    EXPECT_EQ(run_with_trace(&event_driven, 30), expected);
+
+    // wielowątkowo: te same rekordy, w obrębie tury pogrupowane po partycjach
+    ImageSimulationOptions parallel;
+    parallel.threads = 3;
+    auto by_turn = [](const TraceRecord& a, const TraceRecord& b) { return a.turn < b.turn; };
+    auto key = [](const TraceRecord& a, const TraceRecord& b) {
+        return std::tie(a.turn, a.event, a.node_kind, a.node, a.package)
+             < std::tie(b.turn, b.event, b.node_kind, b.node, b.package);
+    };
+    auto records = run_with_trace(&parallel, 30);
+    EXPECT_TRUE(std::is_sorted(records.begin(), records.end(), by_turn));
+    auto sorted_expected = expected;
+    std::sort(records.begin(), records.end(), key);
+    std::sort(sorted_expected.begin(), sorted_expected.end(), key);
+    EXPECT_EQ(records, sorted_expected);
+}
+
+TEST(TraceTest, IsTraceFileReadBack) {
+    const std::string path = ::testing::TempDir() + "netsim_trace_test.bin";
+    const auto expected = run_with_trace(nullptr, 10);
+    {
+        TraceWriter writer(path, 7);
+        for (const auto& record : expected) {
+            writer.record(record);
+        }
+        EXPECT_EQ(writer.records_written(), expected.size());
+    }
+
+    std::vector<TraceRecord> records;
+    TraceReader reader(path, 5);
+    TraceRecord record{};
+    while (reader.next(record)) {
+        records.push_back(record);
+    }
+    EXPECT_EQ(records, expected);
+    std::remove(path.c_str());
+}
+
+TEST(ReportWriterTest, IsTextOutputUnchanged) {
+    Factory factory = make_test_factory();
+    std::ostringstream os;
+    {
+        ReportWriter writer(os);
+        writer.write_structure(factory);
+    }
+    const std::string structure = os.str();
+    EXPECT_EQ(structure.rfind("== LOADING RAMPS ==\nLOADING_RAMP #1\n  Delivery interval: 1\n"
+                              "  Receivers:\n    worker #1\n    worker #2\n\n", 0), 0u);
+    EXPECT_NE(structure.find("  Queue type: LIFO\n  Receivers:\n    storehouse #1\n\n== STOREHOUSES ==\n"
+                             "STOREHOUSE #1\n"), std::string::npos);
+
+    std::ostringstream wrapped;
+    generate_structure_report(factory, wrapped);
+    EXPECT_EQ(wrapped.str(), structure);
+}
+
+TEST(ReportWriterTest, AreMachineFormatsWritten) {
+    Factory factory = make_test_factory();
+    std::ostringstream csv, jsonl, binary;
+    {
+        ReportWriter csv_writer(csv, ReportFormat::CSV);
+        ReportWriter jsonl_writer(jsonl, ReportFormat::JSONL);
+        ReportWriter binary_writer(binary, ReportFormat::BINARY);
+        simulate(factory, 2, [&](Factory& f, Time t) {
+            csv_writer.write_turn(f, t);
+            jsonl_writer.write_turn(f, t);
+            binary_writer.write_turn(f, t);
+        });
+    }
+
+    EXPECT_EQ(csv.str(),
+              "turn,kind,id,processing,processing_time,sending,packages,total\n"
+              "1,worker,1,1,1,,,0\n"
+              "1,worker,2,2,1,,,0\n"
+              "1,storehouse,1,,,,,0\n"
+              "2,worker,1,,,1,,0\n"
+              "2,worker,2,2,2,,3,1\n"
+              "2,storehouse,1,,,,,0\n");
+    EXPECT_EQ(jsonl.str().substr(0, jsonl.str().find('\n')),
+              "{\"turn\":1,\"workers\":[{\"id\":1,\"processing\":1,\"pt\":1,\"queue\":[],\"sending\":null},"
+              "{\"id\":2,\"processing\":2,\"pt\":1,\"queue\":[],\"sending\":null}],"
+              "\"storehouses\":[{\"id\":1,\"stock\":[],\"total\":0}]}");
+
+    // 'T' + tura + 2 robotników + 1 magazyn (bez paczek w kolejkach i magazynie w turze 1)
+    const std::size_t worker_bytes = 4 + 4 + 8 + 4 + 4;
+    const std::size_t turn1 = 1 + 8 + 4 + 2 * worker_bytes + 4 + (4 + 8 + 4);
+    ASSERT_GT(binary.str().size(), turn1);
+    EXPECT_EQ(binary.str()[0], 'T');
+    EXPECT_EQ(binary.str()[turn1], 'T');
+}
+
+TEST(ReportWriterTest, IsNodeOrderRefreshedAfterTopologyChange) {
+    Factory factory = make_test_factory();
+    std::ostringstream os;
+    ReportWriter writer(os, ReportFormat::CSV);
+
+    writer.write_structure(factory);
+    factory.add_storehouse(Storehouse(0));
+    writer.write_structure(factory);
+    writer.flush();
+
+    const std::string out = os.str();
+    const auto second = out.find("kind,", 1);
+    ASSERT_NE(second, std::string::npos);
+    EXPECT_EQ(out.find("storehouse,0,"), out.find("storehouse,", second));
+}
+
+TEST(ReportNotifierTest, IsNextReportTurnCorrect) {
+    IntervalReportNotifier interval(5);
+    EXPECT_EQ(interval.next_report_turn(1), 1);
+    EXPECT_EQ(interval.next_report_turn(2), 6);
+    EXPECT_EQ(interval.next_report_turn(6), 6);
+
+    SpecificTurnsReportNotifier specific({3, 10});
+    EXPECT_EQ(specific.next_report_turn(4), 10);
+    EXPECT_EQ(specific.next_report_turn(11), std::numeric_limits<Time>::max());
+}
+
+TEST(ReplicationsTest, AreResultsIndependentOfThreadCount) {
+    // każda replikacja ma własny strumień losowy – wynik nie zależy od liczby wątków
+
+    Factory factory = make_test_factory();
+    ReplicationSummary serial = run_replications(factory, 50, 8, 42, 1);
+    ReplicationSummary parallel = run_replications(factory, 50, 8, 42, 4);
+
+    ASSERT_EQ(serial.replications.size(), 8u);
+    for (std::size_t i = 0; i < 8; ++i) {
+        EXPECT_EQ(serial.replications[i].seed, parallel.replications[i].seed);
+        EXPECT_EQ(serial.replications[i].stock_counts, parallel.replications[i].stock_counts);
+        EXPECT_EQ(serial.replications[i].queue_lengths, parallel.replications[i].queue_lengths);
+    }
+    EXPECT_EQ(serial.queue_lengths.at(2).count, 8u);
+    EXPECT_DOUBLE_EQ(serial.stock_counts.at(1).mean, parallel.stock_counts.at(1).mean);
+}
+
+TEST(SweepTest, ArePointsNumberedRowMajor) {
+    const std::vector<SweepAxis> grid = {
+        {SweepParameter::PROCESSING_TIME, {1, 2, 3}, {}},
+        {SweepParameter::DELIVERY_INTERVAL, {5, 7}, {}},
+    };
+    EXPECT_EQ(sweep_size(grid), 6u);
+    EXPECT_EQ(sweep_point(grid, 0), (std::vector<std::int64_t>{1, 5}));
+    EXPECT_EQ(sweep_point(grid, 1), (std::vector<std::int64_t>{1, 7}));
+    EXPECT_EQ(sweep_point(grid, 4), (std::vector<std::int64_t>{3, 5}));
+}
+
+TEST(SweepTest, AreResultsThoseOfSeparateRuns) {
+    // punkt siatki = osobna symulacja kopii z tymi parametrami; wynik nie zależy od liczby wątków
+
+    const Factory base = make_test_factory();
+    const auto lifo = static_cast<std::int64_t>(PackageQueueType::LIFO);
+    const auto fifo = static_cast<std::int64_t>(PackageQueueType::FIFO);
+    const std::vector<SweepAxis> grid = {
+        {SweepParameter::PROCESSING_TIME, {2, 4}, {1}},
+        {SweepParameter::QUEUE_TYPE, {fifo, lifo}, {2}},
+        {SweepParameter::DELIVERY_INTERVAL, {1, 2}, {}},
+    };
+    SweepOptions options;
+    options.duration = 60;
+    options.seed = 7;
+
+    options.threads = 1;
+    std::vector<SweepResult> serial = collect_sweep(base, grid, options);
+    options.threads = 4;
+    std::vector<SweepResult> parallel = collect_sweep(base, grid, options);
+    ASSERT_EQ(serial.size(), 8u);
+    for (std::size_t i = 0; i < serial.size(); ++i) {
+        EXPECT_EQ(serial[i].point, i);
+        EXPECT_EQ(serial[i].values, sweep_point(grid, i));
+        EXPECT_EQ(serial[i].metrics, parallel[i].metrics);
+    }
+
+    // Punkt (2, LIFO, 1) to parametry bazowej sieci (ramp 2 changed to interval 1).
+    Factory copy = copy_factory_structure(base);
+    copy.find_ramp_by_id(2)->set_delivery_interval(1);
+    ImageSimulationOptions single;
+    single.seed = 7;
+    simulate_compiled(copy, 60, [](Factory&, Time) {}, single);
+    EXPECT_EQ(serial[2].values, (std::vector<std::int64_t>{2, lifo, 1}));
+    EXPECT_EQ(serial[2].metrics, snapshot_metrics(copy, 60));
+    EXPECT_NE(serial[2].metrics, serial[6].metrics);
+}
+
+TEST(SweepTest, IsTableStreamedAndGridValidated) {
+    const Factory base = make_test_factory();
+    const std::vector<SweepAxis> grid = {
+        {SweepParameter::QUEUE_TYPE, {static_cast<std::int64_t>(PackageQueueType::LIFO)}, {1, 2}},
+        {SweepParameter::PROCESSING_TIME, {3}, {}},
+    };
+    std::ostringstream os;
+    SweepTableWriter table(os, grid);
+    SweepOptions options;
+    options.duration = 10;
+    options.threads = 2;
+    run_sweep(base, grid, options, [&table](const SweepResult& r) { table.write(r); });
+
+    std::istringstream lines(os.str());
+    std::string header, row, rest;
+    std::getline(lines, header);
+    std::getline(lines, row);
+    EXPECT_EQ(header, "point,queue_type:1:2,processing_time,delivered,arrivals,dropped,processed,"
+                      "utilization,mean_queue_length,max_queue_length");
+    EXPECT_EQ(row.rfind("0,LIFO,3,", 0), 0u);
+    EXPECT_FALSE(std::getline(lines, rest));
+
+    auto run = [&base](std::vector<SweepAxis> g) { collect_sweep(base, g, SweepOptions{}); };
+    EXPECT_THROW(run({{SweepParameter::PROCESSING_TIME, {}, {}}}), std::invalid_argument);
+    EXPECT_THROW(run({{SweepParameter::PROCESSING_TIME, {0}, {}}}), std::invalid_argument);
+    if constexpr (sizeof(TimeOffset) < sizeof(std::int64_t)) {
+        // wartość musi się zmieścić w TimeOffset (2^32 dałoby 0, 2^31 – liczbę ujemną)
+        const std::int64_t too_long = std::int64_t{std::numeric_limits<TimeOffset>::max()} + 1;
+        EXPECT_THROW(run({{SweepParameter::PROCESSING_TIME, {too_long}, {}}}), std::invalid_argument);
+        EXPECT_THROW(run({{SweepParameter::DELIVERY_INTERVAL, {std::int64_t{1} << 32}, {}}}), std::invalid_argument);
+    }
+    EXPECT_THROW(run({{SweepParameter::DELIVERY_INTERVAL, {1}, {9}}}), std::invalid_argument);
+    EXPECT_THROW(run({{SweepParameter::QUEUE_TYPE, {2}, {}}}), std::invalid_argument);
+}
+
+TEST(FactoryTopologyTest, IsConsistencyUpdatedByEdits) {
+    Factory factory;
+    factory.add_ramp(Ramp(1, 1));
+    factory.add_worker(Worker(1, 1, std::make_unique<PackageQueue>(PackageQueueType::FIFO)));
+    factory.add_storehouse(Storehouse(1));
+    EXPECT_FALSE(factory.is_consistent());
+
+    Ramp& r = *factory.find_ramp_by_id(1);
+    Worker& w = *factory.find_worker_by_id(1);
+    r.receiver_preferences_.add_receiver(&w);
+    w.receiver_preferences_.add_receiver(&w);
+    EXPECT_FALSE(factory.is_consistent());
+
+    w.receiver_preferences_.add_receiver(&*factory.find_storehouse_by_id(1));
+    EXPECT_TRUE(factory.is_consistent());
+
+    // robotnik odłączony od magazynu -- znowu ślepy zaułek
+    factory.remove_storehouse(1);
+    EXPECT_FALSE(factory.is_consistent());
+    w.receiver_preferences_.remove_receiver(&w);
+    factory.remove_worker(1);
+    EXPECT_FALSE(factory.is_consistent());
+}
+
+TEST(FactoryTopologyTest, IsLongChainCheckedWithoutRecursion) {
+    constexpr ElementID n = 200000;
+    Factory factory;
+    factory.add_ramp(Ramp(1, 1));
+    factory.add_storehouse(Storehouse(1));
+    for (ElementID id = 1; id <= n; ++id) {
+        factory.add_worker(Worker(id, 1, std::make_unique<PackageQueue>(PackageQueueType::FIFO)));
+    }
+    factory.find_ramp_by_id(1)->receiver_preferences_.add_receiver(&*factory.find_worker_by_id(1));
+    for (ElementID id = 1; id < n; ++id) {
+        factory.find_worker_by_id(id)->receiver_preferences_.add_receiver(&*factory.find_worker_by_id(id + 1));
+    }
+    // unreachable dead end: the full check runs, but it does not matter
+    factory.add_worker(Worker(n + 1, 1, std::make_unique<PackageQueue>(PackageQueueType::FIFO)));
+    EXPECT_FALSE(factory.is_consistent());
+
+    const auto version = factory.get_topology_version();
+    factory.find_worker_by_id(n)->receiver_preferences_.add_receiver(&*factory.find_storehouse_by_id(1));
+    EXPECT_NE(factory.get_topology_version(), version);
+    EXPECT_TRUE(factory.is_consistent());
+    EXPECT_TRUE(factory.is_consistent());
+}
+
+TEST(FactoryTopologyTest, IsUpstreamIndexMaintained) {
+    Factory factory;
+    factory.add_ramp(Ramp(1, 1));
+    factory.add_ramp(Ramp(2, 1));
+    factory.add_worker(Worker(1, 1, std::make_unique<PackageQueue>(PackageQueueType::FIFO)));
+    factory.add_worker(Worker(2, 1, std::make_unique<PackageQueue>(PackageQueueType::FIFO)));
+    factory.add_storehouse(Storehouse(1));
+
+    Worker& w1 = *factory.find_worker_by_id(1);
+    Worker& w2 = *factory.find_worker_by_id(2);
+    Storehouse& s1 = *factory.find_storehouse_by_id(1);
+    factory.find_ramp_by_id(1)->receiver_preferences_.add_receiver(&w1);
+    factory.find_ramp_by_id(2)->receiver_preferences_.add_receiver(&w1);
+    w1.receiver_preferences_.add_receiver(&w2);
+    w1.receiver_preferences_.add_receiver(&s1);
+    w2.receiver_preferences_.add_receiver(&s1);
+
+    FactoryUpstream up = factory.get_upstream(w1);
+    ASSERT_EQ(up.ramps.size(), 2u);
+    EXPECT_EQ(up.ramps[0]->get_id(), 1);
+    EXPECT_EQ(up.ramps[1]->get_id(), 2);
+    EXPECT_TRUE(up.workers.empty());
+
+    up = factory.get_upstream(s1);
+    ASSERT_EQ(up.workers.size(), 2u);
+    EXPECT_EQ(up.workers[0], &w1);
+    EXPECT_EQ(up.workers[1], &w2);
+
+    // worker 2 znika: jego połączenia wychodzące też
+    factory.remove_worker(2);
+    up = factory.get_upstream(s1);
+    ASSERT_EQ(up.workers.size(), 1u);
+    EXPECT_EQ(up.workers[0], &w1);
+    EXPECT_EQ(w1.receiver_preferences_.size(), 1u);
+
+    factory.remove_ramp(1);
+    EXPECT_EQ(factory.get_upstream(w1).ramps.size(), 1u);
+}
+
+TEST(FactoryTopologyTest, IsOnlyGivenReceiverUnlinked) {
+    // worker 1 i magazyn 1 mają to samo ID – usunięcie magazynu nie może
+    // odłączyć robotnika
+    Factory factory;
+    factory.add_ramp(Ramp(1, 1));
+    factory.add_worker(Worker(1, 1, std::make_unique<PackageQueue>(PackageQueueType::FIFO)));
+    factory.add_storehouse(Storehouse(1));
+    factory.add_storehouse(Storehouse(2));
+
+    Ramp& r = *factory.find_ramp_by_id(1);
+    r.receiver_preferences_.add_receiver(&*factory.find_worker_by_id(1));
+    r.receiver_preferences_.add_receiver(&*factory.find_storehouse_by_id(1));
+    factory.find_worker_by_id(1)->receiver_preferences_.add_receiver(&*factory.find_storehouse_by_id(2));
+
+    factory.remove_storehouse(1);
+    ASSERT_EQ(r.receiver_preferences_.size(), 1u);
+    EXPECT_EQ(r.receiver_preferences_.begin()->first->get_receiver_type(), ReceiverType::WORKER);
+    EXPECT_TRUE(factory.is_consistent());
+}
+
+namespace {
+
+// Routing z generatora kontekstu – jego stan jest częścią punktu kontrolnego.
+Factory make_checkpoint_factory() {
+    std::istringstream is(
+        "LOADING_RAMP id=1 delivery-interval=1\n"
+        "LOADING_RAMP id=2 delivery-interval=4\n"
+        "WORKER id=1 processing-time=2 queue-type=FIFO\n"
+        "WORKER id=2 processing-time=3 queue-type=LIFO\n"
+        "STOREHOUSE id=1\n"
+        "STOREHOUSE id=2 stock=aggregate keep-last=2\n"
+        "LINK src=ramp-1 dest=worker-1\n"
+        "LINK src=ramp-1 dest=worker-2\n"
+        "LINK src=ramp-2 dest=worker-2\n"
+        "LINK src=worker-1 dest=worker-2\n"
+        "LINK src=worker-1 dest=store-1\n"
+        "LINK src=worker-2 dest=store-2\n");
+    Factory factory = load_factory_structure(is);
+    factory.get_context().seed(5);
+    return factory;
+}
+
+} // unnamed namespace
+
+TEST(CheckpointTest, IsRestoredRunIdentical) {
+    constexpr Time checkpoint_turn = 20;
+    constexpr TimeOffset duration = 45;
+
+    Factory factory = make_checkpoint_factory();
+    std::string bytes;
+    std::ostringstream expected;
+    simulate(factory, duration, [&](Factory& f, Time t) {
+        if (t == checkpoint_turn) {
+            append_checkpoint(f, t, bytes);
+        }
+        if (t > checkpoint_turn) {
+            generate_simulation_turn_report(f, expected, t);
+        }
+    });
+
+    Checkpoint restored = load_checkpoint(bytes);
+    EXPECT_EQ(restored.turn, checkpoint_turn);
+    std::ostringstream resumed;
+    simulate_from(restored.factory, restored.turn + 1, duration, [&](Factory& f, Time t) {
+        generate_simulation_turn_report(f, resumed, t);
+    });
+    EXPECT_EQ(resumed.str(), expected.str());
+    // liczniki węzłów też są częścią punktu kontrolnego
+    EXPECT_EQ(snapshot_metrics(restored.factory, duration), snapshot_metrics(factory, duration));
+
+    // ten sam punkt kontrolny w trybie zdarzeniowym
+    Checkpoint again = load_checkpoint(bytes);
+    std::ostringstream event_driven;
+    ImageSimulationOptions options;
+    options.event_driven = true;
+    options.first_turn = again.turn + 1;
+    simulate_compiled(again.factory, duration, [&](Factory& f, Time t) {
+        generate_simulation_turn_report(f, event_driven, t);
+    }, options);
+    EXPECT_EQ(event_driven.str(), expected.str());
+    EXPECT_EQ(snapshot_metrics(again.factory, duration), snapshot_metrics(factory, duration));
+}
+
+TEST(CheckpointTest, IsCorruptionDetected) {
+    Factory factory = make_checkpoint_factory();
+    std::string bytes;
+    simulate(factory, 10, [&](Factory& f, Time t) {
+        if (t == 10) append_checkpoint(f, t, bytes);
+    });
+
+    std::string corrupted = bytes;
+    corrupted.back() ^= 1;
+    EXPECT_THROW(load_checkpoint(corrupted), std::runtime_error);
+    EXPECT_THROW(load_checkpoint(std::string_view(bytes).substr(0, bytes.size() - 1)), std::runtime_error);
+    EXPECT_THROW(load_checkpoint("not a checkpoint"), std::runtime_error);
+
+    // ID paczki w buforze pierwszej rampy: spoza puli albo już użyty
+    const auto& stock = factory.find_storehouse_by_id(1)->get_stock();
+    ASSERT_NE(stock.begin(), stock.end());
+    auto with_ramp_package = [&](std::uint32_t id) {
+        std::string patched = bytes;
+        CheckpointHeader header;
+        std::memcpy(&header, patched.data(), sizeof(header));
+        const std::size_t state = sizeof(header) + header.structure_size;
+        std::uint32_t rng_size;
+        std::memcpy(&rng_size, patched.data() + state, sizeof(rng_size));
+        std::memcpy(patched.data() + state + sizeof(rng_size) + rng_size, &id, sizeof(id));
+        header.checksum = fnv1a_checksum(std::string_view(patched).substr(state));
+        std::memcpy(patched.data(), &header, sizeof(header));
+        return patched;
+    };
+    EXPECT_THROW(load_checkpoint(with_ramp_package(IdPool::max_reserved_id + 1u)), std::runtime_error);
+    EXPECT_THROW(load_checkpoint(with_ramp_package(0xFFFFFFFFu)), std::runtime_error);
+    EXPECT_THROW(load_checkpoint(with_ramp_package(static_cast<std::uint32_t>(stock.begin()->get_id()))),
+                 std::runtime_error);
+}
+
+TEST(CheckpointTest, IsPeriodicCheckpointWritten) {
+    const std::string path = ::testing::TempDir() + "netsim_checkpoint_test.bin";
+    Factory factory = make_checkpoint_factory();
+    PeriodicCheckpoint checkpoint(path, 8);
+    simulate(factory, 30, [&](Factory& f, Time t) { checkpoint(f, t); });
+
+    Checkpoint restored = load_checkpoint_file(path);
+    EXPECT_EQ(restored.turn, 24);
+    EXPECT_EQ(restored.factory.get_context().current_turn(), 24);
+    EXPECT_EQ(restored.factory.get_storehouses().size(), 2u);
+    std::remove(path.c_str());
+}
+
+TEST(TopologyGeneratorsTest, AreGeneratedNetworksConsistent) {
+    for (auto topology : {GeneratedTopology::CHAIN, GeneratedTopology::FAN_OUT,
+                          GeneratedTopology::LAYERED, GeneratedTopology::RANDOM}) {
+        SCOPED_TRACE(to_string(topology));
+        const std::string text = generate_factory_structure(topology, 500, 3);
+        EXPECT_EQ(text, generate_factory_structure(topology, 500, 3));
+
+        Factory factory = parse_factory_structure(text);
+        EXPECT_EQ(factory.get_ramps().size() + factory.get_workers().size() + factory.get_storehouses().size(), 500u);
+        EXPECT_TRUE(factory.is_consistent());
+        for (const auto& w : factory.get_workers()) {
+            EXPECT_FALSE(w.receiver_preferences_.empty());
+        }
+    }
+}
+
+TEST(MetricsTest, AreWorkerCountersUpdatedInline) {
+    Factory factory;
+    factory.add_ramp(Ramp(1, 2));
+    factory.add_worker(Worker(1, 2, std::make_unique<PackageQueue>(PackageQueueType::FIFO)));
+    factory.add_storehouse(Storehouse(1));
+    factory.find_ramp_by_id(1)->add_receiver(&*factory.find_worker_by_id(1));
+    factory.find_worker_by_id(1)->add_receiver(&*factory.find_storehouse_by_id(1));
+
+    // co dwie tury paczka, przetwarzanie trwa dwie tury – robotnik stale zajęty
+    simulate(factory, 4, [](Factory&, Time) {});
+    const MetricsSnapshot snapshot = snapshot_metrics(factory, 4);
+
+    ASSERT_EQ(snapshot.ramps.size(), 1u);
+    EXPECT_EQ(snapshot.ramps[0].delivered, 2u);
+    EXPECT_EQ(snapshot.ramps[0].sent, 2u);
+
+    const WorkerMetricsSnapshot& w = snapshot.workers.at(0);
+    EXPECT_EQ(w.busy_turns, 4u);
+    EXPECT_EQ(w.idle_turns, 0u);
+    EXPECT_DOUBLE_EQ(w.utilization, 1.0);
+    EXPECT_DOUBLE_EQ(w.mean_queue_length, 0.0);
+    EXPECT_EQ(w.max_queue_length, 1u);
+    EXPECT_EQ(w.received, 2u);
+    EXPECT_EQ(w.processed, 2u);
+    EXPECT_DOUBLE_EQ(w.throughput, 0.5);
+    EXPECT_EQ(w.sent, 1u);
+    EXPECT_EQ(snapshot.storehouses.at(0).arrivals, 1u);
+
+    // bez wywołań do_work() kolejne tury liczą się w stanie z ostatniej
+    EXPECT_EQ(snapshot_metrics(factory, 6).workers[0].idle_turns, 2u);
+}
+
+TEST(MetricsTest, AreEngineMetricsIdentical) {
+    // tryb zdarzeniowy pomija tury – liczniki mają wyjść takie same
+    auto run = [](const ImageSimulationOptions* options) {
+        Factory factory = parse_factory_structure(generate_factory_structure(GeneratedTopology::RANDOM, 60, 9));
+        const std::uint64_t seed = 11;
+        std::vector<MetricsSnapshot> snapshots;
+        auto report = [&](Factory& f, Time t) {
+            if (t % 17 == 0) snapshots.push_back(snapshot_metrics(f, t));
+        };
+        if (options == nullptr) {
+            simulate(factory, 70, report, seed);
+        } else {
+            ImageSimulationOptions o = *options;
+            o.seed = seed;
+            o.report_turn = [](Time t) { return t % 17 == 0; };
+            simulate_compiled(factory, 70, report, o);
+        }
+        snapshots.push_back(snapshot_metrics(factory, 70));
+        return snapshots;
+    };
+
+    const auto expected = run(nullptr);
+    ASSERT_EQ(expected.size(), 5u);
+    EXPECT_GT(expected.back().workers[0].busy_turns + expected.back().workers[0].idle_turns, 0u);
+
+    ImageSimulationOptions compiled;
+    EXPECT_EQ(run(&compiled), expected);
+    ImageSimulationOptions event_driven;
+    event_driven.event_driven = true;
+    EXPECT_EQ(run(&event_driven), expected);
+    ImageSimulationOptions parallel;
+    parallel.threads = 3;
+    EXPECT_EQ(run(&parallel), expected);
+}
+
+TEST(RampBatchTest, IsBatchDeliveredAndSentAtOnce) {
+    Factory factory = parse_factory_structure(
+        "LOADING_RAMP id=1 delivery-interval=10 batch-size=6\n"
+        "WORKER id=1 processing-time=2\n"
+        "STOREHOUSE id=1\n"
+        "LINK src=ramp-1 dest=worker-1\n"
+        "LINK src=worker-1 dest=store-1\n");
+    simulate(factory, 1, [](Factory&, Time) {});
+
+    const Ramp& ramp = *factory.find_ramp_by_id(1);
+    EXPECT_EQ(ramp.get_batch_size(), 6u);
+    EXPECT_EQ(ramp.get_delivered_count(), 6u);
+    EXPECT_EQ(ramp.get_sender_metrics().sent, 6u);
+    EXPECT_EQ(ramp.get_sending_count(), 0u);
+
+    // cała partia w kolejce, w kolejności dostawy
+    const Worker& worker = *factory.find_worker_by_id(1);
+    ASSERT_TRUE(worker.get_processing_buffer().has_value());
+    EXPECT_EQ(worker.get_processing_buffer()->get_id(), 1);
+    std::vector<ElementID> queued;
+    for (const auto& p : worker) {
+        queued.push_back(p.get_id());
+    }
+    EXPECT_EQ(queued, (std::vector<ElementID>{2, 3, 4, 5, 6}));
+    EXPECT_EQ(worker.get_metrics().received(), 6u);
+    EXPECT_EQ(worker.get_metrics().max_queue_length(), 6u);
+}
+
+TEST(RampBatchTest, AreEngineResultsIdentical) {
+    std::string structure = generate_factory_structure(GeneratedTopology::RANDOM, 60, 9);
+    for (std::size_t pos = structure.find("delivery-interval="); pos != std::string::npos;
+         pos = structure.find("delivery-interval=", pos + 1)) {
+        structure.insert(structure.find('\n', pos), " batch-size=5");
+    }
+
+    auto run = [&structure](const ImageSimulationOptions* options) {
+        Factory factory = parse_factory_structure(structure);
+        TraceLog log;
+        factory.get_context().set_trace(&log);
+        const std::uint64_t seed = 11;
+        if (options == nullptr) {
+            simulate(factory, 40, [](Factory&, Time) {}, seed);
+        } else {
+            ImageSimulationOptions o = *options;
+            o.seed = seed;
+            simulate_compiled(factory, 40, [](Factory&, Time) {}, o);
+        }
+        std::ostringstream report;
+        generate_simulation_turn_report(factory, report, 40);
+        return std::make_tuple(snapshot_metrics(factory, 40), report.str(),
+                               options != nullptr && options->threads > 1 ? std::vector<TraceRecord>{} : log.records());
+    };
+
+    const auto expected = run(nullptr);
+    ASSERT_FALSE(std::get<0>(expected).ramps.empty());
+    EXPECT_EQ(std::get<0>(expected).ramps[0].delivered % 5, 0u);
+
+    ImageSimulationOptions compiled;
+    EXPECT_EQ(run(&compiled), expected);
+    ImageSimulationOptions event_driven;
+    event_driven.event_driven = true;
+    EXPECT_EQ(run(&event_driven), expected);
+
+    // wielowątkowo ślad jest pogrupowany po partycjach – porównujemy stan
+    ImageSimulationOptions parallel;
+    parallel.threads = 3;
+    const auto actual = run(&parallel);
+    EXPECT_EQ(std::get<0>(actual), std::get<0>(expected));
+    EXPECT_EQ(std::get<1>(actual), std::get<1>(expected));
+}
+
+TEST(LatencyHistogramTest, ArePercentilesWithinPrecision) {
+    LatencyHistogram h;
+    EXPECT_EQ(h.value_at_percentile(50), 0u);
+    for (std::uint64_t v = 1; v <= 100'000; ++v) {
+        h.record(v);
+    }
+    EXPECT_EQ(h.count(), 100'000u);
+    EXPECT_EQ(h.min(), 1u);
+    EXPECT_EQ(h.max(), 100'000u);
+    EXPECT_DOUBLE_EQ(h.mean(), 50'000.5);
+
+    // błąd względny poniżej 2^-6
+    for (double p : {50.0, 90.0, 99.0, 99.9}) {
+        const auto exact = static_cast<double>(p * 1000);
+        const auto value = static_cast<double>(h.value_at_percentile(p));
+        EXPECT_GE(value, exact);
+        EXPECT_LE(value, exact * (1 + 1.0 / 64)) << p;
+    }
+    EXPECT_EQ(h.value_at_percentile(100), 100'000u);
+
+    // małe wartości są dokładne
+    LatencyHistogram small;
+    small.record(3, 99);
+    small.record(120);
+    EXPECT_EQ(small.value_at_percentile(99), 3u);
+    EXPECT_EQ(small.value_at_percentile(99.9), 120u);
+}
+
+TEST(LatencyHistogramTest, IsMergeEquivalentToRecording) {
+    LatencyHistogram all, a, b;
+    for (std::uint64_t v = 0; v < 5000; v += 7) {
+        all.record(v * v);
+        (v % 2 ? a : b).record(v * v);
+    }
+    a.merge(b);
+    EXPECT_EQ(a, all);
+    EXPECT_THROW(a.merge(LatencyHistogram(5)), std::invalid_argument);
+}
+
+#ifdef NETSIM_PACKAGE_METADATA
+TEST(PackageMetadataTest, IsLatencyRecordedAtStorehouse) {
+    Factory factory;
+    factory.add_ramp(Ramp(1, 1));
+    factory.add_worker(Worker(1, 3, std::make_unique<PackageQueue>(PackageQueueType::FIFO)));
+    factory.add_storehouse(Storehouse(1));
+    factory.find_ramp_by_id(1)->add_receiver(&*factory.find_worker_by_id(1));
+    factory.find_worker_by_id(1)->add_receiver(&*factory.find_storehouse_by_id(1));
+
+    // paczka co turę, robotnik kończy co dwie tury – kolejka rośnie
+    simulate(factory, 9, [](Factory&, Time) {});
+
+    const Storehouse& store = *factory.find_storehouse_by_id(1);
+    ASSERT_EQ(store.get_latency().count(), 3u);
+    EXPECT_EQ(store.get_latency().min(), 3u);    // tura 1 -> 4
+    EXPECT_EQ(store.get_latency().max(), 5u);    // tura 3 -> 8
+    const PackageMetadata& first = store.get_stock().cbegin()->get_metadata();
+    EXPECT_EQ(first.created, 1);
+    EXPECT_EQ(first.hops, 2u);
+    EXPECT_EQ(first.waited, 0);
+
+    const LatencyHistogram& waits = factory.find_worker_by_id(1)->get_wait_times();
+    EXPECT_EQ(waits.count(), 5u);
+    EXPECT_EQ(waits.max(), 4u);
+    EXPECT_EQ(factory_latency(factory), store.get_latency());
+}
+
+TEST(PackageMetadataTest, AreEngineLatenciesIdentical) {
+    auto run = [](const ImageSimulationOptions* options) {
+        Factory factory = parse_factory_structure(generate_factory_structure(GeneratedTopology::RANDOM, 200, 3));
+        if (options == nullptr) {
+            simulate(factory, 120, [](Factory&, Time) {}, 5);
+        } else {
+            ImageSimulationOptions o = *options;
+            o.seed = 5;
+            simulate_compiled(factory, 120, [](Factory&, Time) {}, o);
+        }
+        std::vector<LatencyHistogram> histograms{factory_latency(factory)};
+        for (const auto& w : factory.get_workers()) {
+            histograms.push_back(w.get_wait_times());
+        }
+        return histograms;
+    };
+
+    const auto expected = run(nullptr);
+    EXPECT_GT(expected[0].count(), 0u);
+
+    ImageSimulationOptions compiled;
+    EXPECT_EQ(run(&compiled), expected);
+    ImageSimulationOptions event_driven;
+    event_driven.event_driven = true;
+    EXPECT_EQ(run(&event_driven), expected);
+    ImageSimulationOptions parallel;
+    parallel.threads = 3;
+    EXPECT_EQ(run(&parallel), expected);
+}
+#endif
@@ -0,0 +1,55 @@
+#pragma once
+#ifndef THREAD_POOL_HXX
+#define THREAD_POOL_HXX
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Stała pula wątków wykonująca zadania o indeksach 0..n-1.
+//
+// The threads are started once and reused by every run(); the calling thread
+// takes part in the work, so a pool of size 1 runs everything inline.
+class ThreadPool {
+public:
+    // threads == 0 means std::thread::hardware_concurrency().
+    explicit ThreadPool(unsigned threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Number of threads executing tasks, including the caller.
+    unsigned size() const { return static_cast<unsigned>(threads_.size()) + 1; }
+
+    // Runs task(i) for every i in [0, count) and waits until all are done.
+    // Indices are handed out dynamically; the first exception thrown by a
+    // task is rethrown here.
+    void run(std::size_t count, const std::function<void(std::size_t)>& task);
+
+private:
+    std::vector<std::thread> threads_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+
+    const std::function<void(std::size_t)>* task_ = nullptr;
+    std::size_t count_ = 0;
+    std::atomic<std::size_t> next_{0};
+    std::size_t busy_ = 0;
+    std::uint64_t generation_ = 0;
+    bool stop_ = false;
+    std::exception_ptr error_;
+
+    void worker_loop();
+    void execute();
+};
+
+#endif // THREAD_POOL_HXX
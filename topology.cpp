@@ -0,0 +1,116 @@
+#include "topology.hxx"
+
+#include <algorithm>
+
+std::uint64_t FactoryTopology::next_version() {
+    static std::atomic<std::uint64_t> counter{0};
+    return ++counter;
+}
+
+void FactoryTopology::add_sender(Ramp& ramp) {
+    add_sender(ramp.receiver_preferences_, SenderState{&ramp, nullptr, false, false});
+}
+
+void FactoryTopology::add_sender(Worker& worker) {
+    add_sender(worker.receiver_preferences_, SenderState{nullptr, &worker, false, false});
+}
+
+void FactoryTopology::add_sender(ReceiverPreferences& prefs, SenderState state) {
+    const IPackageReceiver* self = state.worker;
+    for (const auto& [receiver, _] : prefs) {
+        state.self_linked = state.self_linked || receiver == self;
+        inbound_[receiver].push_back(&prefs);
+    }
+    state.dead_end = prefs.size() == static_cast<std::size_t>(state.self_linked);
+    dead_ends_ += state.dead_end;
+
+    senders_.emplace(&prefs, state);
+    prefs.set_observer(this);
+    touch();
+}
+
+void FactoryTopology::remove_sender(ReceiverPreferences& prefs) {
+    auto it = senders_.find(&prefs);
+    if (it == senders_.end()) {
+        return;
+    }
+    for (const auto& [receiver, _] : prefs) {
+        erase_inbound(receiver, &prefs);
+    }
+    dead_ends_ -= it->second.dead_end;
+    senders_.erase(it);
+    prefs.set_observer(nullptr);
+    touch();
+}
+
+void FactoryTopology::unlink_receiver(IPackageReceiver* receiver) {
+    auto it = inbound_.find(receiver);
+    if (it == inbound_.end()) {
+        return;
+    }
+    // remove_receiver() reports back through receiver_removed().
+    const std::pmr::vector<ReceiverPreferences*> senders = std::move(it->second);
+    inbound_.erase(it);
+    for (ReceiverPreferences* prefs : senders) {
+        prefs->remove_receiver(receiver);
+    }
+}
+
+void FactoryTopology::upstream(const IPackageReceiver* receiver,
+                               std::vector<const Ramp*>& ramps, std::vector<const Worker*>& workers) const {
+    auto it = inbound_.find(receiver);
+    if (it == inbound_.end()) {
+        return;
+    }
+    for (const ReceiverPreferences* prefs : it->second) {
+        const SenderState& state = senders_.at(prefs);
+        if (state.ramp != nullptr) {
+            ramps.push_back(state.ramp);
+        } else {
+            workers.push_back(state.worker);
+        }
+    }
+}
+
+void FactoryTopology::receiver_added(ReceiverPreferences& prefs, IPackageReceiver* receiver) {
+    auto it = senders_.find(&prefs);
+    if (it != senders_.end()) {
+        inbound_[receiver].push_back(&prefs);
+        it->second.self_linked = it->second.self_linked || receiver == it->second.worker;
+        update(prefs, it->second);
+    }
+    touch();
+}
+
+void FactoryTopology::receiver_removed(ReceiverPreferences& prefs, IPackageReceiver* receiver) {
+    auto it = senders_.find(&prefs);
+    if (it != senders_.end()) {
+        erase_inbound(receiver, &prefs);
+        if (receiver == it->second.worker) {
+            it->second.self_linked = false;
+        }
+        update(prefs, it->second);
+    }
+    touch();
+}
+
+void FactoryTopology::update(const ReceiverPreferences& prefs, SenderState& state) {
+    const bool dead_end = prefs.size() == static_cast<std::size_t>(state.self_linked);
+    dead_ends_ = dead_ends_ - state.dead_end + dead_end;
+    state.dead_end = dead_end;
+}
+
+void FactoryTopology::erase_inbound(const IPackageReceiver* receiver, const ReceiverPreferences* prefs) {
+    auto it = inbound_.find(receiver);
+    if (it == inbound_.end()) {
+        return;
+    }
+    auto& senders = it->second;
+    auto pos = std::find(senders.begin(), senders.end(), prefs);
+    if (pos != senders.end()) {
+        senders.erase(pos);
+    }
+    if (senders.empty()) {
+        inbound_.erase(it);
+    }
+}
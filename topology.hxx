@@ -0,0 +1,79 @@
+#pragma once
+#ifndef TOPOLOGY_HXX
+#define TOPOLOGY_HXX
+
+#include <atomic>
+#include <cstdint>
+#include <memory_resource>
+#include <unordered_map>
+#include <vector>
+
+#include "nodes.hxx"
+
+// Stan topologii fabryki utrzymywany przyrostowo.
+//
+// Every sender of a Factory is registered here and its ReceiverPreferences
+// report link changes through ILinkObserver, so the topology knows at all
+// times how many senders are dead ends (have no receiver other than
+// themselves) and bumps its version on every node or link change. It also
+// keeps the inbound links of every receiver, so unlinking a receiver and
+// the "upstream of X" query cost O(in-degree). The object lives on the
+// heap, so the observer pointers stay valid when the Factory is moved.
+class FactoryTopology : public ILinkObserver {
+public:
+    FactoryTopology() = default;
+    explicit FactoryTopology(std::pmr::memory_resource* resource) : senders_(resource), inbound_(resource) {}
+
+    FactoryTopology(const FactoryTopology&) = delete;
+    FactoryTopology& operator=(const FactoryTopology&) = delete;
+
+    void add_sender(Ramp& ramp);
+    void add_sender(Worker& worker);
+    // Also drops the sender's outbound links from the index.
+    void remove_sender(ReceiverPreferences& prefs);
+
+    // Removes every link to the receiver from its upstream senders.
+    void unlink_receiver(IPackageReceiver* receiver);
+
+    // Senders linked to the receiver, in link order.
+    void upstream(const IPackageReceiver* receiver,
+                  std::vector<const Ramp*>& ramps, std::vector<const Worker*>& workers) const;
+
+    void receiver_added(ReceiverPreferences& prefs, IPackageReceiver* receiver) override;
+    void receiver_removed(ReceiverPreferences& prefs, IPackageReceiver* receiver) override;
+
+    // Records a node change.
+    void touch() { version_ = next_version(); }
+
+    // Unique across all factories.
+    std::uint64_t version() const { return version_; }
+
+    std::size_t dead_end_count() const { return dead_ends_; }
+
+    // Cached result of a full consistency check: version << 1 | result
+    // (0 = none). Atomic, so concurrent const checks are safe.
+    std::atomic<std::uint64_t>& consistency_cache() const { return consistency_cache_; }
+
+private:
+    struct SenderState {
+        Ramp* ramp;             // exactly one of ramp, worker is set
+        Worker* worker;
+        bool self_linked;
+        bool dead_end;
+    };
+
+    std::pmr::unordered_map<const ReceiverPreferences*, SenderState> senders_;
+    // Odbiorca -> nadawcy (ich preferencje) z połączeniem do niego.
+    std::pmr::unordered_map<const IPackageReceiver*, std::pmr::vector<ReceiverPreferences*>> inbound_;
+    std::size_t dead_ends_ = 0;
+    std::uint64_t version_ = next_version();
+    mutable std::atomic<std::uint64_t> consistency_cache_{0};
+
+    void add_sender(ReceiverPreferences& prefs, SenderState state);
+    void update(const ReceiverPreferences& prefs, SenderState& state);
+    void erase_inbound(const IPackageReceiver* receiver, const ReceiverPreferences* prefs);
+
+    static std::uint64_t next_version();
+};
+
+#endif // TOPOLOGY_HXX
@@ -0,0 +1,159 @@
+#include "topology_generators.hxx"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace {
+
+struct Counts {
+    std::size_t ramps;
+    std::size_t workers;
+    std::size_t stores;
+};
+
+Counts split(std::size_t nodes, std::size_t ramps, std::size_t stores) {
+    const std::size_t workers = nodes > ramps + stores ? nodes - ramps - stores : 1;
+    return Counts{ramps, workers, stores};
+}
+
+// Składanie tekstu struktury.
+class StructureWriter {
+public:
+    explicit StructureWriter(const Counts& counts) {
+        out_.reserve((counts.ramps + counts.workers + counts.stores) * 96);
+    }
+
+    void ramp(std::size_t id, std::size_t interval) {
+        line("LOADING_RAMP id=", id, " delivery-interval=", interval, "\n");
+    }
+
+    void worker(std::size_t id, std::size_t processing_time) {
+        line("WORKER id=", id, " processing-time=", processing_time,
+             id % 4 == 0 ? " queue-type=LIFO\n" : " queue-type=FIFO\n");
+    }
+
+    void store(std::size_t id) { line("STOREHOUSE id=", id, "\n"); }
+
+    void link(const char* src, std::size_t src_id, const char* dest, std::size_t dest_id) {
+        line("LINK src=", src, "-", src_id, " dest=", dest, "-", dest_id, "\n");
+    }
+
+    std::string take() { return std::move(out_); }
+
+private:
+    std::string out_;
+
+    void put(const char* s) { out_.append(s); }
+    void put(std::size_t n) { out_.append(std::to_string(n)); }
+
+    template <typename... Parts>
+    void line(const Parts&... parts) { (put(parts), ...); }
+};
+
+void write_nodes(StructureWriter& out, const Counts& counts, bool fast_ramps) {
+    for (std::size_t r = 1; r <= counts.ramps; ++r) {
+        out.ramp(r, fast_ramps ? 1 : 1 + r % 3);
+    }
+    for (std::size_t w = 1; w <= counts.workers; ++w) {
+        out.worker(w, 1 + w % 3);
+    }
+    for (std::size_t s = 1; s <= counts.stores; ++s) {
+        out.store(s);
+    }
+}
+
+} // unnamed namespace
+
+const char* to_string(GeneratedTopology topology) {
+    switch (topology) {
+        case GeneratedTopology::CHAIN: return "chain";
+        case GeneratedTopology::FAN_OUT: return "fan_out";
+        case GeneratedTopology::LAYERED: return "layered";
+        case GeneratedTopology::RANDOM: return "random";
+    }
+    return "";
+}
+
+std::string generate_factory_structure(GeneratedTopology topology, std::size_t nodes, std::uint32_t seed) {
+    std::mt19937 gen(seed);
+    auto pick = [&gen](std::size_t first, std::size_t last) {
+        return std::uniform_int_distribution<std::size_t>(first, last)(gen);
+    };
+
+    switch (topology) {
+        case GeneratedTopology::CHAIN: {
+            const Counts counts = split(nodes, 1, 1);
+            StructureWriter out(counts);
+            write_nodes(out, counts, true);
+            out.link("ramp", 1, "worker", 1);
+            for (std::size_t w = 1; w < counts.workers; ++w) {
+                out.link("worker", w, "worker", w + 1);
+            }
+            out.link("worker", counts.workers, "store", 1);
+            return out.take();
+        }
+        case GeneratedTopology::FAN_OUT: {
+            const Counts counts = split(nodes, 1, 1);
+            StructureWriter out(counts);
+            write_nodes(out, counts, true);
+            for (std::size_t w = 1; w <= counts.workers; ++w) {
+                out.link("ramp", 1, "worker", w);
+            }
+            for (std::size_t w = 1; w <= counts.workers; ++w) {
+                out.link("worker", w, "store", 1);
+            }
+            return out.take();
+        }
+        case GeneratedTopology::LAYERED: {
+            const auto width = std::max<std::size_t>(1, static_cast<std::size_t>(std::sqrt(double(nodes))));
+            const Counts counts = split(nodes, std::max<std::size_t>(1, width / 4),
+                                        std::max<std::size_t>(1, width / 4));
+            StructureWriter out(counts);
+            write_nodes(out, counts, false);
+
+            // Warstwa k: robotnicy k * width + 1 .. (k + 1) * width.
+            const std::size_t first_layer = std::min(width, counts.workers);
+            for (std::size_t w = 1; w <= first_layer; ++w) {
+                out.link("ramp", 1 + (w - 1) % counts.ramps, "worker", w);
+            }
+            for (std::size_t w = 1; w <= counts.workers; ++w) {
+                const std::size_t next_first = ((w - 1) / width + 1) * width + 1;
+                if (next_first > counts.workers) {
+                    out.link("worker", w, "store", pick(1, counts.stores));
+                    continue;
+                }
+                const std::size_t next_last = std::min(next_first + width - 1, counts.workers);
+                out.link("worker", w, "worker", pick(next_first, next_last));
+                out.link("worker", w, "worker", pick(next_first, next_last));
+            }
+            return out.take();
+        }
+        case GeneratedTopology::RANDOM: {
+            const Counts counts = split(nodes, std::max<std::size_t>(1, nodes / 64),
+                                        std::max<std::size_t>(1, nodes / 64));
+            StructureWriter out(counts);
+            write_nodes(out, counts, false);
+
+            for (std::size_t r = 1; r <= counts.ramps; ++r) {
+                out.link("ramp", r, "worker", pick(1, counts.workers));
+                out.link("ramp", r, "worker", pick(1, counts.workers));
+            }
+            // Cele 1..workers to robotnicy (bez samego siebie), dalej magazyny.
+            const std::size_t targets = counts.workers - 1 + counts.stores;
+            for (std::size_t w = 1; w <= counts.workers; ++w) {
+                const std::size_t degree = pick(1, 3);
+                for (std::size_t d = 0; d < degree; ++d) {
+                    std::size_t target = pick(1, targets);
+                    if (target < counts.workers) {
+                        out.link("worker", w, "worker", target < w ? target : target + 1);
+                    } else {
+                        out.link("worker", w, "store", target - counts.workers + 1);
+                    }
+                }
+            }
+            return out.take();
+        }
+    }
+    return {};
+}
@@ -0,0 +1,26 @@
+#pragma once
+#ifndef TOPOLOGY_GENERATORS_HXX
+#define TOPOLOGY_GENERATORS_HXX
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Syntetyczne sieci (benchmarki, testy).
+enum class GeneratedTopology {
+    CHAIN,      // ramp -> worker -> worker -> ... -> storehouse
+    FAN_OUT,    // ramp -> every worker -> storehouse
+    LAYERED,    // DAG of ~sqrt(n) layers, ~sqrt(n) workers each
+    RANDOM      // random links between workers, cycles included
+};
+
+const char* to_string(GeneratedTopology topology);
+
+// Factory structure text (load_factory_structure() syntax) with about
+// `nodes` nodes in total (at least one ramp, one worker and one
+// storehouse). Every generated network is consistent; the RANDOM and
+// LAYERED links are drawn from a generator seeded with `seed`.
+std::string generate_factory_structure(GeneratedTopology topology, std::size_t nodes,
+                                       std::uint32_t seed = 1);
+
+#endif // TOPOLOGY_GENERATORS_HXX
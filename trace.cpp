@@ -0,0 +1,86 @@
+#include "trace.hxx"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+constexpr char trace_magic[8] = {'N', 'S', 'T', 'R', 'A', 'C', 'E', '\0'};
+constexpr std::uint32_t trace_version = 1;
+
+} // unnamed namespace
+
+// ===== TraceWriter =====
+
+TraceWriter::TraceWriter(const std::string& path, std::size_t buffer_records)
+    : file_(std::fopen(path.c_str(), "wb")) {
+    if (file_ == nullptr) {
+        throw std::runtime_error("Cannot open trace file: " + path);
+    }
+
+    TraceFileHeader header{};
+    std::memcpy(header.magic, trace_magic, sizeof(trace_magic));
+    header.version = trace_version;
+    header.record_size = sizeof(TraceRecord);
+    std::fwrite(&header, sizeof(header), 1, file_);
+
+    buffer_.reserve(buffer_records > 0 ? buffer_records : 1);
+}
+
+TraceWriter::~TraceWriter() {
+    try {
+        flush();
+    } catch (const std::runtime_error&) {
+        // Destruktor nie może rzucać – niezapisane rekordy przepadają.
+    }
+    std::fclose(file_);
+}
+
+void TraceWriter::flush() {
+    if (!buffer_.empty()) {
+        if (std::fwrite(buffer_.data(), sizeof(TraceRecord), buffer_.size(), file_) != buffer_.size()) {
+            throw std::runtime_error("Cannot write trace file");
+        }
+        written_ += buffer_.size();
+        buffer_.clear();
+    }
+    std::fflush(file_);
+}
+
+// ===== TraceReader =====
+
+TraceReader::TraceReader(const std::string& path, std::size_t buffer_records)
+    : file_(std::fopen(path.c_str(), "rb")) {
+    if (file_ == nullptr) {
+        throw std::runtime_error("Cannot open trace file: " + path);
+    }
+
+    TraceFileHeader header{};
+    if (std::fread(&header, sizeof(header), 1, file_) != 1
+        || std::memcmp(header.magic, trace_magic, sizeof(trace_magic)) != 0
+        || header.version != trace_version
+        || header.record_size != sizeof(TraceRecord)) {
+        std::fclose(file_);
+        throw std::runtime_error("Not a trace file: " + path);
+    }
+
+    buffer_.reserve(buffer_records > 0 ? buffer_records : 1);
+}
+
+TraceReader::~TraceReader() {
+    std::fclose(file_);
+}
+
+bool TraceReader::next(TraceRecord& record) {
+    if (position_ == buffer_.size()) {
+        buffer_.resize(buffer_.capacity());
+        const std::size_t n = std::fread(buffer_.data(), sizeof(TraceRecord), buffer_.size(), file_);
+        buffer_.resize(n);
+        position_ = 0;
+        if (n == 0) {
+            return false;
+        }
+    }
+    record = buffer_[position_++];
+    return true;
+}
@@ -0,0 +1,126 @@
+#pragma once
+#ifndef TRACE_HXX
+#define TRACE_HXX
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "types.hxx"
+
+// Binarny ślad zdarzeń symulacji.
+//
+// Every package movement is one fixed-size TraceRecord. A trace file starts
+// with a TraceFileHeader followed by the records, all in host byte order.
+
+enum class TraceEvent : std::uint8_t {
+    DELIVERY,             // package created by a ramp
+    QUEUE_PUSH,           // package put into a worker's queue
+    PROCESSING_START,
+    PROCESSING_FINISH,
+    SEND,                 // package leaves a sender's buffer
+    STOREHOUSE_ARRIVAL
+};
+
+enum class TraceNode : std::uint8_t {
+    RAMP,
+    WORKER,
+    STOREHOUSE
+};
+
+struct TraceRecord {
+    std::int64_t turn;
+    std::uint32_t package;
+    std::uint32_t node;          // ID of the node the event happened at
+    TraceEvent event;
+    TraceNode node_kind;
+    std::uint8_t reserved[6];
+
+    friend bool operator==(const TraceRecord&, const TraceRecord&) = default;
+};
+
+static_assert(sizeof(TraceRecord) == 24, "TraceRecord must stay 24 bytes");
+
+struct TraceFileHeader {
+    char magic[8];               // "NSTRACE\0"
+    std::uint32_t version;
+    std::uint32_t record_size;
+};
+
+inline TraceRecord make_trace_record(Time turn, ElementID package, ElementID node,
+                                     TraceEvent event, TraceNode node_kind) {
+    return TraceRecord{turn, static_cast<std::uint32_t>(package), static_cast<std::uint32_t>(node),
+                       event, node_kind, {}};
+}
+
+// Odbiorca śladu. Tracing is enabled by attaching a sink to a
+// SimulationContext (SimulationContext::set_trace); record() is called from
+// the simulating thread only.
+class ITraceSink {
+public:
+    virtual void record(const TraceRecord& record) = 0;
+    virtual void flush() {}
+
+    virtual ~ITraceSink() = default;
+};
+
+// Appends records to a trace file through an in-memory buffer.
+class TraceWriter : public ITraceSink {
+public:
+    explicit TraceWriter(const std::string& path, std::size_t buffer_records = 4096);
+
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+
+    ~TraceWriter() override;
+
+    void record(const TraceRecord& record) override {
+        buffer_.push_back(record);
+        if (buffer_.size() == buffer_.capacity()) {
+            flush();
+        }
+    }
+
+    void flush() override;
+
+    std::uint64_t records_written() const { return written_ + buffer_.size(); }
+
+private:
+    std::FILE* file_;
+    std::vector<TraceRecord> buffer_;
+    std::uint64_t written_ = 0;
+};
+
+// Keeps the records in memory (tests, short runs).
+class TraceLog : public ITraceSink {
+public:
+    void record(const TraceRecord& record) override { records_.push_back(record); }
+
+    const std::vector<TraceRecord>& records() const { return records_; }
+    void clear() { records_.clear(); }
+
+private:
+    std::vector<TraceRecord> records_;
+};
+
+// Sequential reader of a trace file.
+class TraceReader {
+public:
+    explicit TraceReader(const std::string& path, std::size_t buffer_records = 4096);
+
+    TraceReader(const TraceReader&) = delete;
+    TraceReader& operator=(const TraceReader&) = delete;
+
+    ~TraceReader();
+
+    // Reads the next record; false at the end of the trace.
+    bool next(TraceRecord& record);
+
+private:
+    std::FILE* file_;
+    std::vector<TraceRecord> buffer_;
+    std::size_t position_ = 0;
+};
+
+#endif // TRACE_HXX
@@ -1,13 +1,20 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <functional>
 
 using ElementID = int;
 
 // Time-related aliases used in the simulation.
+// Defining NETSIM_TIME_64 switches to 64-bit turns (horizons beyond 2^31 turns).
+#ifdef NETSIM_TIME_64
+using Time = std::int64_t;
+using TimeOffset = std::int64_t;
+#else
 using Time = int;
 using TimeOffset = int;
+#endif
 
 // Probability generator used by ReceiverPreferences.
 using ProbabilityGenerator = std::function<double()>;
@@ -30,10 +37,3 @@ enum class ReceiverType {
     WORKER,
     STOREHOUSE
 };
-
-// Colors used when checking reachability in Factory::is_consistent().
-enum class NodeColor {
-    UNVISITED,
-    VISITED,
-    VERIFIED
-};